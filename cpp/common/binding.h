@@ -17,16 +17,33 @@
  *    by invoking binding_getActualBinding.
  *    you can also check whether all logical processors had at most one thread
  *    mapped to them by invoking binding_isInjectiveMapping.
+ *
+ * Instead of writing the string by hand, binding_policyOrder lists the logical
+ * processors in the order a topology-aware policy fills them (thread i goes to
+ * entry i). The topology is read from /sys/devices/system/cpu:
+ *   COMPACT    all hardware threads of a core, then the next core of the
+ *              same socket (and NUMA node), then the next socket
+ *   SCATTER    one hardware thread per core, round robin over the sockets,
+ *              then the second hardware threads in the same order
+ *   SMT_LAST   one hardware thread per core, socket by socket, then the
+ *              second hardware threads in the same order
+ *   NUMA_FILL  every core of NUMA node 0 (one hardware thread each, then
+ *              their siblings), then NUMA node 1, and so on
  */
 
 #ifndef BINDING_H
 #define	BINDING_H
 
+#include <algorithm>
 #include <cassert>
+#include <cstdio>
+#include <dirent.h>
 #include <sched.h>
 #include <iostream>
 #include <stdlib.h>
 #include <string>
+#include <tuple>
+#include <vector>
 #include "plaf.h"
 
 // cpu sets for binding threads to cores
@@ -191,5 +208,91 @@ void binding_deinit() {
     }
 }
 
+enum class BindingPolicy {
+    NONE, COMPACT, SCATTER, SMT_LAST, NUMA_FILL
+};
+
+struct binding_cpu_topology {
+    int cpu;
+    int package;
+    int node;
+    int core;       // core_id (unique within the package)
+    int coreRank;   // index of the core among the cores of its package
+    int smt;        // index of the cpu among the hardware threads of its core
+};
+
+static int readTopologyInt(const std::string & path) {
+    int result = -1;
+    FILE * f = fopen(path.c_str(), "r");
+    if (f == NULL) return -1;
+    if (fscanf(f, "%d", &result) != 1) result = -1;
+    fclose(f);
+    return result;
+}
+
+// topology of the online logical processors with ids < numLogicalProcessors
+// (empty if /sys/devices/system/cpu is not available)
+std::vector<binding_cpu_topology> binding_readTopology() {
+    std::vector<binding_cpu_topology> cpus;
+    for (int cpu=0;cpu<numLogicalProcessors;++cpu) {
+        std::string dir = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        binding_cpu_topology t;
+        t.cpu = cpu;
+        t.package = readTopologyInt(dir + "/topology/physical_package_id");
+        t.core = readTopologyInt(dir + "/topology/core_id");
+        if (t.package < 0 || t.core < 0) continue; // offline or not present
+        t.node = 0;
+        DIR * d = opendir(dir.c_str());
+        if (d) {
+            while (struct dirent * e = readdir(d)) {
+                int node;
+                if (sscanf(e->d_name, "node%d", &node) == 1) t.node = node;
+            }
+            closedir(d);
+        }
+        cpus.push_back(t);
+    }
+    // number the cores of each package, and the hardware threads of each core
+    for (auto & t : cpus) {
+        t.coreRank = 0;
+        t.smt = 0;
+        std::vector<int> coresBefore;
+        for (auto & u : cpus) {
+            if (u.package != t.package) continue;
+            if (u.core < t.core && std::find(coresBefore.begin(), coresBefore.end(), u.core) == coresBefore.end()) {
+                coresBefore.push_back(u.core);
+            }
+            if (u.core == t.core && u.cpu < t.cpu) ++t.smt;
+        }
+        t.coreRank = coresBefore.size();
+    }
+    return cpus;
+}
+
+// logical processors in the order the policy fills them
+std::vector<int> binding_policyOrder(const BindingPolicy policy) {
+    std::vector<binding_cpu_topology> cpus = binding_readTopology();
+    if (cpus.empty()) {
+        std::cout<<"WARNING: could not read the cpu topology; binding threads to logical processors 0, 1, 2, ..."<<std::endl;
+        std::vector<int> order;
+        for (int i=0;i<numLogicalProcessors;++i) order.push_back(i);
+        return order;
+    }
+    auto key = [policy](const binding_cpu_topology & t) {
+        switch (policy) {
+            case BindingPolicy::SCATTER:   return std::make_tuple(t.smt, t.coreRank, t.package, t.node, t.cpu);
+            case BindingPolicy::SMT_LAST:  return std::make_tuple(t.smt, t.package, t.node, t.coreRank, t.cpu);
+            case BindingPolicy::NUMA_FILL: return std::make_tuple(t.node, t.smt, t.package, t.coreRank, t.cpu);
+            default:                       return std::make_tuple(t.package, t.node, t.coreRank, t.smt, t.cpu);
+        }
+    };
+    std::sort(cpus.begin(), cpus.end(), [&key](const binding_cpu_topology & a, const binding_cpu_topology & b) {
+        return key(a) < key(b);
+    });
+    std::vector<int> order;
+    for (auto & t : cpus) order.push_back(t.cpu);
+    return order;
+}
+
 #endif	/* BINDING_H */
 
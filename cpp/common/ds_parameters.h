@@ -0,0 +1,79 @@
+/*
+ * File:   ds_parameters.h
+ *
+ * Named run-time parameters for data structures.
+ *
+ * The benchmark fills the registry from the "dsParameters" object of the
+ * json file and from "-ds-param <name>=<value>" arguments, before the data
+ * structure is created. Adapters read the values they understand in their
+ * constructors and fall back to their compile-time defaults otherwise, e.g.:
+ *
+ *     int limit = ds_parameters::get<int>("catree.highContentionLimit", 1000);
+ *
+ * Names are prefixed with the data structure they belong to.
+ */
+
+#ifndef DS_PARAMETERS_H
+#define DS_PARAMETERS_H
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <iostream>
+#include "errors.h"
+
+namespace ds_parameters {
+
+    inline std::map<std::string, std::string> &all() {
+        static std::map<std::string, std::string> values;
+        return values;
+    }
+
+    inline void set(const std::string &name, const std::string &value) {
+        all()[name] = value;
+    }
+
+    /**
+     * parses "<name>=<value>"
+     */
+    inline void setFromString(const std::string &assignment) {
+        size_t pos = assignment.find('=');
+        if (pos == std::string::npos || pos == 0) {
+            setbench_error("expected <name>=<value> for a data structure parameter, got: " << assignment);
+        }
+        set(assignment.substr(0, pos), assignment.substr(pos + 1));
+    }
+
+    inline bool contains(const std::string &name) {
+        return all().count(name) > 0;
+    }
+
+    template<typename T>
+    T get(const std::string &name, const T &defaultValue) {
+        auto it = all().find(name);
+        if (it == all().end()) {
+            return defaultValue;
+        }
+        std::istringstream in(it->second);
+        T value;
+        in >> std::boolalpha >> value;
+        if (in.fail()) {
+            setbench_error("cannot parse data structure parameter " << name << "=" << it->second);
+        }
+        return value;
+    }
+
+    template<>
+    inline std::string get<std::string>(const std::string &name, const std::string &defaultValue) {
+        auto it = all().find(name);
+        return it == all().end() ? defaultValue : it->second;
+    }
+
+    inline void print() {
+        for (auto &entry: all()) {
+            std::cout << "ds_param_" << entry.first << "=" << entry.second << std::endl;
+        }
+    }
+}
+
+#endif /* DS_PARAMETERS_H */
@@ -12,15 +12,7 @@
 #include "dict.h"
 #include "dict_helpers.h"
 
-#ifdef KEY_DEPTH_TOTAL_STAT
-extern int64_t key_depth_total_sum__;
-extern int64_t key_depth_total_cnt__;
-#endif
-
-#ifdef KEY_DEPTH_STAT
-extern int64_t* key_depth_sum__;
-extern int64_t* key_depth_cnt__;
-#endif
+#include "key_stats.h"
 
 enum class ClearPolicy { kNone, kRoot, kRapid };
 
@@ -1129,6 +1129,20 @@ public:
         return sum;
     }
 
+    // largest value of the stat over all threads and indices
+    template<typename T>
+    T get_max(const gstats_stat_id id) {
+        T result = 0;
+        for (int tid = 0; tid < NUM_PROCESSES; ++tid) {
+            int size = thread_data[tid].size[id];
+            auto data = thread_data[tid].get_ptr<T>(id);
+            for (int ix = 0; ix < size; ++ix) {
+                if (data[ix] > result) result = data[ix];
+            }
+        }
+        return result;
+    }
+
     template<typename T>
     stat_metrics<T> *compute_stat_metrics(const gstats_stat_id id, gstats_enum_aggregation_granularity granularity) {
         switch (granularity) {
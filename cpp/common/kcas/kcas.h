@@ -95,6 +95,21 @@ namespace kcas {
         instance.add(caswordptr, oldVal, newVal, args...);
     }
 
+    #if defined KCAS_HTM
+    inline void setHtmPolicy(const kcas_htm_policy &policy) {
+        instance.setPolicy(policy);
+    }
+
+    inline const kcas_htm_policy &getHtmPolicy() {
+        return instance.getPolicy();
+    }
+
+    // outcome of the calling thread's last execute()
+    inline const kcas_execute_stats &lastExecuteStats() {
+        return kcas_last_execute;
+    }
+    #endif
+
     #if defined KCAS_VALIDATE || defined KCAS_VALIDATE_HTM
 
     inline bool validate()
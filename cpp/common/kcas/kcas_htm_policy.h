@@ -0,0 +1,69 @@
+/**
+ * Run-time policy of the HTM fast path of KCASHTM (kcas_reuse_htm_impl.h).
+ *
+ * execute() first tries to apply the whole KCAS in up to htmAttempts hardware
+ * transactions, and otherwise runs the descriptor-based lock-free algorithm
+ * (the same one KCASLockFree uses). With htmAttempts == 0, or if the CPU does
+ * not support RTM, every KCAS takes the lock-free path, so one binary covers
+ * both backends.
+ *
+ * In adaptive mode, a thread stops retrying a transaction that aborted for
+ * lack of capacity (unless the CPU hints that a retry may succeed), and after
+ * a KCAS fell back because all of its transactions aborted, the thread skips
+ * HTM for its next few KCAS operations. The number skipped doubles with every
+ * such fallback (up to maxSkip) and is reset by a committed transaction.
+ *
+ * The outcome of the last execute() of each thread is kept in
+ * kcas_last_execute, so data structures can attribute aborts and fallbacks to
+ * their own operations.
+ */
+
+#ifndef KCAS_HTM_POLICY_H
+#define KCAS_HTM_POLICY_H
+
+#include <cpuid.h>
+
+#ifndef KCAS_HTM_ATTEMPTS
+#define KCAS_HTM_ATTEMPTS 5
+#endif
+
+struct kcas_htm_policy {
+    int htmAttempts;    // transactions per KCAS before the lock-free path; 0 = lock-free only
+    bool adaptive;
+    int maxSkip;        // adaptive mode only
+
+    kcas_htm_policy()
+    : htmAttempts(KCAS_HTM_ATTEMPTS), adaptive(false), maxSkip(64) {}
+
+    static bool rtmSupported() {
+        unsigned int eax, ebx, ecx, edx;
+        if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return false;
+        return (ebx & (1 << 11)) != 0; // CPUID.07H:EBX.RTM
+    }
+};
+
+struct kcas_execute_stats {
+    int htmAttempts;        // transactions started
+    int abortsConflict;
+    int abortsCapacity;
+    int abortsDescriptor;   // another KCAS was in progress on one of the words
+    int abortsOther;
+    bool committedInHtm;
+    bool fellBack;          // finished on the lock-free path
+    bool skippedHtm;        // adaptive mode skipped the transactions
+
+    void reset() {
+        htmAttempts = abortsConflict = abortsCapacity = abortsDescriptor = abortsOther = 0;
+        committedInHtm = fellBack = skippedHtm = false;
+    }
+};
+
+struct kcas_htm_thread_state {
+    int skip;       // KCAS operations left that skip HTM
+    int backoff;    // skip length after the next fallback caused by aborts
+};
+
+thread_local kcas_execute_stats kcas_last_execute = {};
+thread_local kcas_htm_thread_state kcas_htm_state = {};
+
+#endif /* KCAS_HTM_POLICY_H */
@@ -5,6 +5,7 @@
 #include <immintrin.h>
 #include <sstream>
 #include <stdint.h>
+#include "kcas_htm_policy.h"
 
 
 using namespace std;
@@ -154,7 +155,6 @@ typedef intptr_t seqbits_t;
 #define KCAS_LEFTSHIFT 2
 #define HTM_READ_DESCRIPTOR 20
 #define HTM_BAD_OLD_VAL 30
-#define MAX_RETRIES 5
 
 #define KCAS_MAX_THREADS 500
 
@@ -268,12 +268,15 @@ class KCASHTM {
     kcasdesc_t<MAX_K> kcasDescriptors[LAST_TID + 1] __attribute__((aligned(64)));
     rdcssdesc_t rdcssDescriptors[LAST_TID + 1] __attribute__((aligned(64)));
     volatile char __padding_desc3[128];
+    kcas_htm_policy policy;
 
     /**
      * Function declarations
      */
   public:
     KCASHTM();
+    void setPolicy(const kcas_htm_policy &_policy);
+    const kcas_htm_policy &getPolicy();
     void writeInitPtr(casword_t volatile *addr, casword_t const newval);
     void writeInitVal(casword_t volatile *addr, casword_t const newval);
     casword_t readPtr(casword_t volatile *addr);
@@ -353,6 +356,7 @@ template <int MAX_K>
 KCASHTM<MAX_K>::KCASHTM() {
     DESC_INIT_ALL(kcasDescriptors, KCAS_SEQBITS_NEW);
     DESC_INIT_ALL(rdcssDescriptors, RDCSS_SEQBITS_NEW);
+    setPolicy(kcas_htm_policy());
 }
 
 template <int MAX_K>
@@ -444,6 +448,19 @@ static void kcasdesc_sort(kcasptr_t ptr) {
     }
 }
 
+template <int MAX_K>
+void KCASHTM<MAX_K>::setPolicy(const kcas_htm_policy &_policy) {
+    policy = _policy;
+    if (policy.htmAttempts > 0 && !kcas_htm_policy::rtmSupported()) {
+        policy.htmAttempts = 0; // _xbegin would raise SIGILL
+    }
+}
+
+template <int MAX_K>
+const kcas_htm_policy &KCASHTM<MAX_K>::getPolicy() {
+    return policy;
+}
+
 template <int MAX_K>
 bool KCASHTM<MAX_K>::execute() {
     assert(kcas_tid.getId() != -1);
@@ -454,8 +471,19 @@ bool KCASHTM<MAX_K>::execute() {
     DESC_INITIALIZED(kcasDescriptors, kcas_tid.getId());
     kcastagptr_t tagptr = TAGPTR_NEW(kcas_tid.getId(), desc->seqBits, KCAS_TAGBIT);
 
-    for (int i = 0; i < MAX_RETRIES; i++) {
+    kcas_execute_stats &stats = kcas_last_execute;
+    stats.reset();
+
+    int attempts = policy.htmAttempts;
+    if (policy.adaptive && attempts > 0 && kcas_htm_state.skip > 0) {
+        --kcas_htm_state.skip;
+        stats.skippedHtm = true;
+        attempts = 0;
+    }
+
+    for (int i = 0; i < attempts; i++) {
         int status;
+        ++stats.htmAttempts;
         if ((status = _xbegin()) == _XBEGIN_STARTED) {
             for (int j = 0; j < desc->numEntries; j++) {
                 casword_t val = *desc->entries[j].addr;
@@ -469,18 +497,37 @@ bool KCASHTM<MAX_K>::execute() {
                 *desc->entries[j].addr = desc->entries[j].newval;
             }
             _xend();
+            stats.committedInHtm = true;
+            kcas_htm_state.backoff = 0;
             return true;
         } else {
             if (_XABORT_EXPLICIT & status) {
                 if (_XABORT_CODE(status) == HTM_READ_DESCRIPTOR) {
+                    ++stats.abortsDescriptor;
                     break;
                 } else if (_XABORT_CODE(status) == HTM_BAD_OLD_VAL) {
                     return false;
                 }
+                ++stats.abortsOther;
+            } else if (_XABORT_CAPACITY & status) {
+                ++stats.abortsCapacity;
+                if (policy.adaptive && !(_XABORT_RETRY & status)) break;
+            } else if (_XABORT_CONFLICT & status) {
+                ++stats.abortsConflict;
+            } else {
+                ++stats.abortsOther;
             }
         }
     }
 
+    if (policy.adaptive && stats.htmAttempts > 0 && stats.abortsDescriptor == 0) {
+        // every transaction aborted by itself: the next few are likely to abort as well
+        int backoff = (kcas_htm_state.backoff > 0) ? 2 * kcas_htm_state.backoff : 1;
+        kcas_htm_state.backoff = (backoff > policy.maxSkip) ? policy.maxSkip : backoff;
+        kcas_htm_state.skip = kcas_htm_state.backoff;
+    }
+
+    stats.fellBack = true;
     kcasdesc_sort<MAX_K>(desc);
     return help(tagptr, desc, false);
 }
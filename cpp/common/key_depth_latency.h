@@ -0,0 +1,210 @@
+/**
+ * Per-depth profile of the nodes visited by tree traversals, and of the
+ * latency of the first load from each of them (compile with
+ * -DKEY_DEPTH_LATENCY_STAT, otherwise the macros below are empty).
+ *
+ * A traversal calls KEY_DEPTH_LATENCY_BEGIN() before it visits its first node
+ * (the root has depth 0), and KEY_DEPTH_LATENCY_TOUCH(node) before its first
+ * read of each node (KEY_DEPTH_LATENCY_RESTART() goes back to depth 0, for a
+ * traversal that starts again from the root). A recursive traversal that
+ * knows the depth of its nodes uses KEY_DEPTH_LATENCY_TOUCH_AT(node, depth),
+ * which only counts nodes deeper than the last one it counted, so that an
+ * operation that retries from a node above it does not count the same depths
+ * twice. An operation whose retries start again from the root calls BEGIN
+ * once, before its retry loop, and KEY_DEPTH_LATENCY_END() after its first
+ * search, so that only that search is profiled.
+ *
+ * One traversal in KEY_DEPTH_LATENCY_PERIOD of each thread
+ * is sampled: for its nodes, TOUCH times a load of the first byte of the node
+ * between serialized rdtsc reads (so the load that misses, if any, is the one
+ * that is timed), and adds the cycles and the node to the depth of the node.
+ * Other traversals only pay for a thread local countdown and a branch per
+ * node. The cycles include the cost of the timing itself, which is reported
+ * as the cycles of a load that hits in L1 (TIMER_OVERHEAD_CYCLES).
+ *
+ * Nodes deeper than KEY_DEPTH_LATENCY_MAX_DEPTH - 1 are counted in the last
+ * depth. Each thread accumulates its own profile, and the profiles of the
+ * threads are summed when they exit and when the profile is printed.
+ */
+
+#ifndef KEY_DEPTH_LATENCY_H
+#define KEY_DEPTH_LATENCY_H
+
+#ifdef KEY_DEPTH_LATENCY_STAT
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <set>
+#include <x86intrin.h>
+#include "json/single_include/nlohmann/json.hpp"
+
+#ifndef KEY_DEPTH_LATENCY_PERIOD
+#define KEY_DEPTH_LATENCY_PERIOD 64
+#endif
+#ifndef KEY_DEPTH_LATENCY_MAX_DEPTH
+#define KEY_DEPTH_LATENCY_MAX_DEPTH 64
+#endif
+
+namespace key_depth_latency {
+
+    struct counts {
+        int64_t traversals = 0;
+        int64_t nodes[KEY_DEPTH_LATENCY_MAX_DEPTH] = {};
+        int64_t cycles[KEY_DEPTH_LATENCY_MAX_DEPTH] = {};
+
+        void add(const counts & other) {
+            traversals += other.traversals;
+            for (int d = 0; d < KEY_DEPTH_LATENCY_MAX_DEPTH; ++d) {
+                nodes[d] += other.nodes[d];
+                cycles[d] += other.cycles[d];
+            }
+        }
+    };
+
+    struct thread_profile;
+
+    // the profiles of the running threads, and the sum of the profiles of the threads that exited
+    inline std::mutex lock;
+    inline std::set<thread_profile *> running;
+    inline counts exited;
+
+    struct thread_profile {
+        counts c;
+        int countdown = KEY_DEPTH_LATENCY_PERIOD;
+        int depth = -1; // of the next node of the sampled traversal (-1: the traversal is not sampled)
+
+        thread_profile() {
+            std::lock_guard<std::mutex> guard(lock);
+            running.insert(this);
+        }
+        ~thread_profile() {
+            std::lock_guard<std::mutex> guard(lock);
+            exited.add(c);
+            running.erase(this);
+        }
+    };
+
+    inline thread_profile & profile() {
+        static thread_local thread_profile p;
+        return p;
+    }
+
+    inline void begin() {
+        thread_profile & p = profile();
+        if (--p.countdown > 0) {
+            p.depth = -1;
+            return;
+        }
+        p.countdown = KEY_DEPTH_LATENCY_PERIOD;
+        p.depth = 0;
+        ++p.c.traversals;
+    }
+
+    inline void restart() {
+        thread_profile & p = profile();
+        if (p.depth > 0) p.depth = 0;
+    }
+
+    inline uint64_t timeLoad(const void * const addr) {
+        _mm_lfence();
+        const uint64_t start = __rdtsc();
+        _mm_lfence();
+        *(volatile const char *) addr;
+        _mm_lfence();
+        return __rdtsc() - start;
+    }
+
+    inline void record(thread_profile & p, const void * const node, const int depth) {
+        const int d = (depth < KEY_DEPTH_LATENCY_MAX_DEPTH) ? depth : KEY_DEPTH_LATENCY_MAX_DEPTH - 1;
+        p.c.cycles[d] += timeLoad(node);
+        ++p.c.nodes[d];
+    }
+
+    inline void touch(const void * const node) {
+        thread_profile & p = profile();
+        if (p.depth < 0) return;
+        record(p, node, p.depth++);
+    }
+
+    inline void touchAt(const void * const node, const int depth) {
+        thread_profile & p = profile();
+        if (p.depth < 0 || depth < p.depth) return;
+        record(p, node, depth);
+        p.depth = depth + 1;
+    }
+
+    inline void end() {
+        profile().depth = -1;
+    }
+
+    // (only while no traversal is running, e.g., between the stages of a run)
+    inline void reset() {
+        std::lock_guard<std::mutex> guard(lock);
+        exited = counts();
+        for (thread_profile * p : running) p->c = counts();
+    }
+
+    inline counts total() {
+        std::lock_guard<std::mutex> guard(lock);
+        counts result = exited;
+        for (thread_profile * p : running) result.add(p->c);
+        return result;
+    }
+
+    inline uint64_t timerOverhead() {
+        volatile char hot = 0;
+        uint64_t result = timeLoad((const void *) &hot);
+        for (int i = 0; i < 1000; ++i) result = std::min(result, timeLoad((const void *) &hot));
+        return result;
+    }
+
+    inline void print() {
+        const counts c = total();
+        std::cout << "SAMPLE_PERIOD=" << KEY_DEPTH_LATENCY_PERIOD << '\n';
+        std::cout << "SAMPLED_TRAVERSALS=" << c.traversals << '\n';
+        std::cout << "TIMER_OVERHEAD_CYCLES=" << timerOverhead() << '\n';
+        if (c.traversals == 0) return;
+        for (int d = 0; d < KEY_DEPTH_LATENCY_MAX_DEPTH; ++d) {
+            if (c.nodes[d] == 0) continue;
+            std::cout << "DEPTH=" << d << "; ";
+            std::cout << "NODES=" << c.nodes[d] << "; ";
+            std::cout << "NODES_PER_TRAVERSAL=" << (c.nodes[d] / static_cast<double>(c.traversals)) << "; ";
+            std::cout << "AVG_LOAD_CYCLES=" << (c.cycles[d] / static_cast<double>(c.nodes[d])) << ";\n";
+        }
+    }
+
+    inline nlohmann::json toJson() {
+        const counts c = total();
+        nlohmann::json j;
+        j["samplePeriod"] = KEY_DEPTH_LATENCY_PERIOD;
+        j["sampledTraversals"] = c.traversals;
+        j["timerOverheadCycles"] = timerOverhead();
+        j["depths"] = nlohmann::json::array();
+        for (int d = 0; d < KEY_DEPTH_LATENCY_MAX_DEPTH; ++d) {
+            if (c.nodes[d] == 0) continue;
+            j["depths"].push_back({{"depth", d}, {"nodes", c.nodes[d]},
+                                   {"avgLoadCycles", c.cycles[d] / static_cast<double>(c.nodes[d])}});
+        }
+        return j;
+    }
+}
+
+#define KEY_DEPTH_LATENCY_BEGIN() key_depth_latency::begin()
+#define KEY_DEPTH_LATENCY_RESTART() key_depth_latency::restart()
+#define KEY_DEPTH_LATENCY_TOUCH(node) key_depth_latency::touch((const void *) (node))
+#define KEY_DEPTH_LATENCY_TOUCH_AT(node, depth) key_depth_latency::touchAt((const void *) (node), (depth))
+#define KEY_DEPTH_LATENCY_END() key_depth_latency::end()
+
+#else
+
+#define KEY_DEPTH_LATENCY_BEGIN()
+#define KEY_DEPTH_LATENCY_RESTART()
+#define KEY_DEPTH_LATENCY_TOUCH(node)
+#define KEY_DEPTH_LATENCY_TOUCH_AT(node, depth)
+#define KEY_DEPTH_LATENCY_END()
+
+#endif /* KEY_DEPTH_LATENCY_STAT */
+
+#endif /* KEY_DEPTH_LATENCY_H */
@@ -0,0 +1,33 @@
+/**
+ * Counters of the key depth and key search statistics (KEY_DEPTH_TOTAL_STAT,
+ * KEY_DEPTH_STAT and KEY_SEARCH_TOTAL_STAT), which are defined in main.cpp
+ * and updated by the data structures that support them.
+ *
+ * The data structures include this header instead of declaring the counters
+ * themselves, so that the registry build (microbench/ds_registry), which
+ * includes each of them in its own namespace, still has a single global copy.
+ */
+
+#ifndef KEY_STATS_H
+#define KEY_STATS_H
+
+#include <cstdint>
+
+#ifdef KEY_DEPTH_TOTAL_STAT
+extern int64_t key_depth_total_sum__;
+extern int64_t key_depth_total_cnt__;
+#endif
+
+#ifdef KEY_DEPTH_STAT
+extern int64_t* key_depth_sum__;
+extern int64_t* key_depth_cnt__;
+#endif
+
+#ifdef KEY_SEARCH_TOTAL_STAT
+extern int64_t key_search_total_iters_cnt__;
+extern int64_t key_search_total_cnt__;
+extern int64_t key_search_total_probe_distance__;
+extern int64_t key_search_total_probe_cnt__;
+#endif
+
+#endif /* KEY_STATS_H */
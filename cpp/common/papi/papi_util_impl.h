@@ -13,7 +13,9 @@ int all_cpu_counters[] = {
     PAPI_TOT_CYC,
    PAPI_TOT_INS,
 //    PAPI_RES_STL,
-//    PAPI_TLB_DM,
+#ifdef PAPI_TLB_COUNTER
+    PAPI_TLB_DM, // skipped (reported as -1) where the cpu has no dTLB miss event
+#endif
 #endif
 };
 std::string all_cpu_counters_strings[] = {
@@ -24,7 +26,9 @@ std::string all_cpu_counters_strings[] = {
     "PAPI_TOT_CYC",
    "PAPI_TOT_INS",
 //    "PAPI_RES_STL",
-//    "PAPI_TLB_DM",
+#ifdef PAPI_TLB_COUNTER
+    "PAPI_TLB_DM",
+#endif
 #endif
 };
 #ifdef USE_PAPI
@@ -0,0 +1,340 @@
+/**
+ * A per-thread, NUMA-local pool for the records of one type (one size class),
+ * for the Pool parameter of record_manager. Compile with -DPOOL_TYPE=numa
+ * (e.g., make ds-reclaim-pool POOLS=numa).
+ *
+ * Records live in slabs of POOL_NUMA_SLAB_BYTES (aligned to their size) that
+ * are bound to the NUMA node of the thread that allocates the slab, and whose
+ * first bytes record that node (its home). Reclaimed records of the slabs
+ * never go back to the allocator:
+ *   - a record freed on its home node goes to the free list of the thread,
+ *   - a record freed on another node is collected per home node, and sent to
+ *     its home node in batches of POOL_NUMA_BATCH records,
+ *   - a thread with more than two batches in its free list gives a batch to
+ *     its node, and a thread with an empty free list takes a batch from its
+ *     node before it carves a new record out of its slab.
+ * So every record a thread gets is in memory local to the thread, and
+ * recycling records takes no malloc calls. The slabs are freed when the pool
+ * is destroyed. The pool keeps a table of its slabs, and a record that was not
+ * carved out of one of them (e.g., a node that the data structure allocated
+ * itself) goes back to the allocator, as with pool_none.
+ *
+ * The node of a thread is fixed when the thread first uses the pool (so
+ * threads should be pinned). Without libnuma there is one node, and the pool
+ * is only a per-thread pool with slab allocation.
+ */
+
+#ifndef POOL_NUMA_H
+#define POOL_NUMA_H
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "plaf.h"
+#include "errors.h"
+#include "pool_interface.h"
+#ifdef USE_LIBNUMA
+#   include "numa_tools.h"
+#endif
+
+#ifndef POOL_NUMA_SLAB_BYTES
+#define POOL_NUMA_SLAB_BYTES (1<<21)
+#endif
+#ifndef POOL_NUMA_BATCH
+#define POOL_NUMA_BATCH 256
+#endif
+#ifndef POOL_NUMA_MAX_SLABS
+#define POOL_NUMA_MAX_SLABS (1<<15) // per record type (must be a power of two)
+#endif
+
+template <typename T = void, class Alloc = allocator_interface<T> >
+class pool_numa : public pool_interface<T, Alloc> {
+private:
+    // a free record (its first word links it to the next free record)
+    struct free_record {
+        free_record * next;
+    };
+
+    struct slab_header {
+        int node;
+    };
+    static const size_t SLAB_HEADER_BYTES = BYTES_IN_CACHE_LINE;
+    static const size_t SLAB_TABLE_SIZE = 2*POOL_NUMA_MAX_SLABS;
+
+    struct node_data {
+        PAD;
+        volatile int lock;
+        volatile int numBatches;                // (read without the lock, to skip empty nodes)
+        std::vector<free_record *> batches;     // chains of POOL_NUMA_BATCH records
+        std::vector<void *> slabs;
+        PAD;
+    };
+
+    struct thread_data {
+        PAD;
+        int node;                   // -1 until the thread first uses the pool
+        free_record * local;
+        int localSize;
+        free_record ** remote;      // per home node: records freed by this thread on another node
+        int * remoteSize;
+        char * slab;
+        size_t slabUsed;
+        long long fresh;            // records carved out of slabs
+        long long recycled;         // records taken from a free list
+        long long remoteFrees;
+        long long foreignFrees;     // records that were not carved out of a slab of the pool
+        PAD;
+    };
+
+    int numNodes;
+    node_data * nodes;
+    thread_data * threads;
+    volatile uintptr_t * slabTable;     // open addressing, the addresses of the slabs (0 = empty)
+    volatile int numSlabs;
+
+    static void acquire(node_data * const nd) {
+        while (__sync_lock_test_and_set(&nd->lock, 1)) {
+            while (nd->lock) __builtin_ia32_pause();
+        }
+    }
+    static void release(node_data * const nd) {
+        __sync_lock_release(&nd->lock);
+    }
+
+    static uintptr_t slabOf(void * const ptr) {
+        return (uintptr_t) ptr & ~((uintptr_t) POOL_NUMA_SLAB_BYTES - 1);
+    }
+
+    static size_t slabTableIndex(const uintptr_t slab) {
+        return (size_t) ((slab / POOL_NUMA_SLAB_BYTES) * 0x9E3779B97F4A7C15ULL) & (SLAB_TABLE_SIZE - 1);
+    }
+
+    void registerSlab(void * const slab) {
+        if (__sync_fetch_and_add(&numSlabs, 1) >= POOL_NUMA_MAX_SLABS) {
+            setbench_error("pool_numa: more than POOL_NUMA_MAX_SLABS="<<POOL_NUMA_MAX_SLABS<<" slabs");
+        }
+        for (size_t i = slabTableIndex((uintptr_t) slab);; i = (i+1) & (SLAB_TABLE_SIZE - 1)) {
+            if (__sync_bool_compare_and_swap(&slabTable[i], (uintptr_t) 0, (uintptr_t) slab)) return;
+        }
+    }
+
+    // (slabs are never removed, and the table is at most half full, so the probe ends)
+    bool isPoolSlab(const uintptr_t slab) {
+        for (size_t i = slabTableIndex(slab);; i = (i+1) & (SLAB_TABLE_SIZE - 1)) {
+            const uintptr_t entry = slabTable[i];
+            if (entry == slab) return true;
+            if (entry == 0) return false;
+        }
+    }
+
+    thread_data * getThreadData(const int tid) {
+        thread_data * const td = &threads[tid];
+        if (td->node < 0) {
+#ifdef USE_LIBNUMA
+            td->node = __numa.get_node_slow();
+            if (td->node < 0 || td->node >= numNodes) td->node = 0;
+#else
+            td->node = 0;
+#endif
+        }
+        return td;
+    }
+
+    void pushBatch(const int node, free_record * const chain) {
+        node_data * const nd = &nodes[node];
+        acquire(nd);
+        nd->batches.push_back(chain);
+        nd->numBatches = nd->batches.size();
+        release(nd);
+    }
+
+    free_record * popBatch(const int node) {
+        node_data * const nd = &nodes[node];
+        if (nd->numBatches == 0) return NULL;
+        free_record * chain = NULL;
+        acquire(nd);
+        if (!nd->batches.empty()) {
+            chain = nd->batches.back();
+            nd->batches.pop_back();
+            nd->numBatches = nd->batches.size();
+        }
+        release(nd);
+        return chain;
+    }
+
+    void newSlab(thread_data * const td) {
+        void * slab = aligned_alloc(POOL_NUMA_SLAB_BYTES, POOL_NUMA_SLAB_BYTES);
+        if (slab == NULL) {
+            setbench_error("pool_numa: could not allocate a slab");
+        }
+#ifdef USE_LIBNUMA
+        numa_tonode_memory(slab, POOL_NUMA_SLAB_BYTES, td->node); // before any page is touched
+#endif
+        ((slab_header *) slab)->node = td->node;
+        registerSlab(slab);
+        td->slab = (char *) slab;
+        td->slabUsed = SLAB_HEADER_BYTES;
+        node_data * const nd = &nodes[td->node];
+        acquire(nd);
+        nd->slabs.push_back(slab);
+        release(nd);
+    }
+
+public:
+    template<typename _Tp1>
+    struct rebind {
+        typedef pool_numa<_Tp1, Alloc> other;
+    };
+    template<typename _Tp1, typename _Tp2>
+    struct rebind2 {
+        typedef pool_numa<_Tp1, _Tp2> other;
+    };
+
+    std::string getSizeString() {
+        long long fresh = 0, recycled = 0, remoteFrees = 0, foreignFrees = 0;
+        size_t slabs = 0;
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            fresh += threads[tid].fresh;
+            recycled += threads[tid].recycled;
+            remoteFrees += threads[tid].remoteFrees;
+            foreignFrees += threads[tid].foreignFrees;
+        }
+        for (int node=0;node<numNodes;++node) {
+            slabs += nodes[node].slabs.size();
+        }
+        std::stringstream ss;
+        ss<<"numa pool: nodes="<<numNodes<<" slabs="<<slabs<<" fresh="<<fresh<<" recycled="<<recycled<<" remote_frees="<<remoteFrees<<" foreign_frees="<<foreignFrees;
+        return ss.str();
+    }
+
+    inline T* get(const int tid) {
+        static_assert(sizeof(T) >= sizeof(free_record), "pool_numa records must be large enough to hold a pointer");
+        static_assert(sizeof(T) + SLAB_HEADER_BYTES <= POOL_NUMA_SLAB_BYTES, "pool_numa records must fit in a slab");
+        static_assert(alignof(T) <= POOL_NUMA_SLAB_BYTES, "pool_numa records must be aligned to at most a slab");
+        thread_data * const td = getThreadData(tid);
+        if (td->local == NULL) {
+            td->local = popBatch(td->node);
+            td->localSize = (td->local == NULL) ? 0 : POOL_NUMA_BATCH;
+        }
+        if (td->local) {
+            free_record * const rec = td->local;
+            td->local = rec->next;
+            --td->localSize;
+            ++td->recycled;
+            return (T *) rec;
+        }
+        td->slabUsed = (td->slabUsed + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (td->slab == NULL || td->slabUsed + sizeof(T) > POOL_NUMA_SLAB_BYTES) {
+            newSlab(td);
+            td->slabUsed = (td->slabUsed + alignof(T) - 1) & ~(alignof(T) - 1);
+        }
+        T * const result = new (td->slab + td->slabUsed) T();
+        td->slabUsed += sizeof(T);
+        ++td->fresh;
+        return result;
+    }
+
+    inline void add(const int tid, T* ptr) {
+        thread_data * const td = getThreadData(tid);
+        const uintptr_t slab = slabOf(ptr);
+        if (!isPoolSlab(slab)) {
+            ++td->foreignFrees;
+            this->alloc->deallocate(tid, ptr);
+            return;
+        }
+        free_record * const rec = (free_record *) ptr;
+        const int home = ((slab_header *) slab)->node;
+        if (home == td->node) {
+            rec->next = td->local;
+            td->local = rec;
+            if (++td->localSize >= 3*POOL_NUMA_BATCH) {
+                // give a batch to the node
+                free_record * chain = td->local;
+                free_record * last = chain;
+                for (int i=1;i<POOL_NUMA_BATCH;++i) last = last->next;
+                td->local = last->next;
+                last->next = NULL;
+                td->localSize -= POOL_NUMA_BATCH;
+                pushBatch(td->node, chain);
+            }
+        } else {
+            ++td->remoteFrees;
+            rec->next = td->remote[home];
+            td->remote[home] = rec;
+            if (++td->remoteSize[home] == POOL_NUMA_BATCH) {
+                pushBatch(home, td->remote[home]);
+                td->remote[home] = NULL;
+                td->remoteSize[home] = 0;
+            }
+        }
+    }
+
+    // (the records in the bag are safe to reuse, so all of them are moved)
+    inline void addMoveFullBlocks(const int tid, blockbag<T> *bag) {
+        addMoveAll(tid, bag);
+    }
+    inline void addMoveAll(const int tid, blockbag<T> *bag) {
+        while (!bag->isEmpty()) {
+            add(tid, bag->remove());
+        }
+    }
+    inline int computeSize(const int tid) {
+        return threads[tid].localSize;
+    }
+
+    void debugPrintStatus(const int tid) {
+        std::cout<<"pool_numa tid="<<tid<<" node="<<threads[tid].node<<" local="<<threads[tid].localSize<<std::endl;
+    }
+
+    pool_numa(const int numProcesses, Alloc * const _alloc, debugInfo * const _debug)
+            : pool_interface<T, Alloc>(numProcesses, _alloc, _debug) {
+#ifdef USE_LIBNUMA
+        numNodes = numa_max_node() + 1;
+#else
+        numNodes = 1;
+#endif
+        nodes = new node_data[numNodes];
+        for (int node=0;node<numNodes;++node) {
+            nodes[node].lock = 0;
+            nodes[node].numBatches = 0;
+        }
+        threads = new thread_data[numProcesses];
+        for (int tid=0;tid<numProcesses;++tid) {
+            thread_data * const td = &threads[tid];
+            td->node = -1;
+            td->local = NULL;
+            td->localSize = 0;
+            td->remote = new free_record *[numNodes];
+            td->remoteSize = new int[numNodes];
+            for (int node=0;node<numNodes;++node) {
+                td->remote[node] = NULL;
+                td->remoteSize[node] = 0;
+            }
+            td->slab = NULL;
+            td->slabUsed = 0;
+            td->fresh = td->recycled = td->remoteFrees = td->foreignFrees = 0;
+        }
+        static_assert((POOL_NUMA_MAX_SLABS & (POOL_NUMA_MAX_SLABS - 1)) == 0, "POOL_NUMA_MAX_SLABS must be a power of two");
+        slabTable = new uintptr_t[SLAB_TABLE_SIZE]();
+        numSlabs = 0;
+    }
+    ~pool_numa() {
+        // records are never destroyed individually, so this frees every record of the pool
+        for (int tid=0;tid<this->NUM_PROCESSES;++tid) {
+            delete[] threads[tid].remote;
+            delete[] threads[tid].remoteSize;
+        }
+        for (int node=0;node<numNodes;++node) {
+            for (void * slab : nodes[node].slabs) free(slab);
+        }
+        delete[] (uintptr_t *) slabTable;
+        delete[] threads;
+        delete[] nodes;
+    }
+};
+
+#endif /* POOL_NUMA_H */
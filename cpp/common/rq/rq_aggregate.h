@@ -0,0 +1,51 @@
+/**
+ * Aggregate range queries: count, sum, min and max of the keys in [lo, hi],
+ * without copying the keys and values of the range into result arrays.
+ *
+ * A data structure that computes the aggregate itself defines
+ * DS_ADAPTER_SUPPORTS_RQ_AGGREGATE in its adapter and provides
+ *     rq_aggregate<K> rangeQueryAggregate(tid, lo, hi)
+ * A data structure that can enumerate a range in place defines
+ * DS_ADAPTER_SUPPORTS_RQ_VISIT and provides
+ *     template <class Visitor> void rangeQueryVisit(tid, lo, hi, Visitor& visit)
+ * which calls visit(key, value) for every key in the range, in key order.
+ * rq_aggregate is itself such a visitor. For any other data structure, the
+ * benchmark materializes the range with rangeQuery and aggregates the arrays.
+ */
+
+#ifndef RQ_AGGREGATE_H
+#define RQ_AGGREGATE_H
+
+template <typename K>
+struct rq_aggregate {
+    long long count;
+    K sum;
+    K min;  // undefined if count == 0
+    K max;  // undefined if count == 0
+
+    rq_aggregate() : count(0), sum(0), min(0), max(0) {}
+
+    inline void add(const K& key) {
+        if (count == 0 || key < min) min = key;
+        if (count == 0 || max < key) max = key;
+        sum += key;
+        ++count;
+    }
+
+    // n > 0 keys in increasing order, stride elements apart
+    inline void addSorted(const K * const keys, const int n, const int stride = 1) {
+        if (count == 0 || keys[0] < min) min = keys[0];
+        if (count == 0 || max < keys[(n-1)*stride]) max = keys[(n-1)*stride];
+        for (int i=0;i<n;++i) {
+            sum += keys[i*stride];
+        }
+        count += n;
+    }
+
+    template <typename V>
+    inline void operator()(const K& key, const V& value) {
+        add(key);
+    }
+};
+
+#endif /* RQ_AGGREGATE_H */
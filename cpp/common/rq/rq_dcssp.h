@@ -27,7 +27,13 @@ extern Random64 rngs[MAX_THREADS_POW2*PREFETCH_SIZE_WORDS];
 #define WAIT_FOR_DTIME(node) ({ false; })
 #endif
 
+// keys found by the traversal of a streaming snapshot before it moves on to its next window (see snapshot_start)
+#ifndef RQ_SNAPSHOT_WINDOW_KEYS
+#define RQ_SNAPSHOT_WINDOW_KEYS (1<<12)
+#endif
+
 #include <pthread.h>
+#include <vector>
 #include <hashlist.h>
 #include "rq_debugging.h"
 #include "dcss_plus_impl.h"
@@ -83,6 +89,32 @@ private:
     #define TIMESTAMP_NOT_SET 0
     #define HASHLIST_INIT_CAPACITY_POW2 (1<<8)
 
+    #define SNAPSHOT_PHASE_TRAVERSAL 0
+    #define SNAPSHOT_PHASE_ANNOUNCEMENTS 1
+    #define SNAPSHOT_PHASE_EPOCH_BAGS 2
+    #define SNAPSHOT_PHASE_DONE 3
+
+    // state of a thread's streaming snapshot (see snapshot_start)
+    struct __rq_snapshot_state {
+        int phase;
+        // keys found by the traversal of the current window
+        int windowKeys;
+        // keys of the last visited node that belong to the snapshot, but did not fit in the caller's buffer yet
+        int numPending;
+        int nextPending;
+        K pendingKeys[RQ_DEBUGGING_MAX_KEYS_PER_NODE];
+        V pendingValues[RQ_DEBUGGING_MAX_KEYS_PER_NODE];
+        // position in the announcements and epoch bags of the other processes
+        long long endTimestamp;
+        int otherTid;
+        int announcementIx;
+        int numAnnouncements;
+        int bagIx;
+        std::vector<blockbag<NodeType> *> bags;
+        std::vector<blockbag_iterator<NodeType>> iterators;
+        PAD;
+    };
+
     PAD;
     const int NUM_PROCESSES;
     PAD;
@@ -102,11 +134,14 @@ private:
 
     int init[MAX_THREADS_POW2] = {0,};
     PAD;
+    __rq_snapshot_state * snapshots;
+    PAD;
 
 public:
     RQProvider(const int numProcesses, DataStructure * ds, RecordManager * recmgr) : NUM_PROCESSES(numProcesses), ds(ds), recmgr(recmgr) {
         prov = new dcsspProvider<void *>(numProcesses);
         threadData = new __rq_thread_data[numProcesses];
+        snapshots = new __rq_snapshot_state[numProcesses];
         DEBUG_INIT_RQPROVIDER(numProcesses);
 #ifdef COUNT_CODE_PATH_EXECUTIONS
         for (int i=0;i<CODE_COVERAGE_MAX_PATHS;++i) {
@@ -136,6 +171,7 @@ public:
         prov->debugPrint();
         delete prov;
         delete[] threadData;
+        delete[] snapshots;
         DEBUG_DEINIT_RQPROVIDER(NUM_PROCESSES);
     }
 
@@ -758,6 +794,262 @@ public:
         DEBUG_RECORD_RQ_SIZE(*startIndex);
         DEBUG_RECORD_RQ_CHECKSUM(tid, threadData[tid].rq_lin_time, rqResultKeys, *startIndex);
     }
+
+    /**
+     * STREAMING SNAPSHOTS
+     *
+     * A streaming snapshot is a range query whose results are handed to the
+     * caller in chunks, instead of being collected in one array of size
+     * proportional to the range. It is linearized at the timestamp returned
+     * by snapshot_start, exactly like traversal_start/traversal_end, and it
+     * must run inside ONE operation of the record manager (the thread must
+     * not become quiescent between snapshot_start and snapshot_end), since
+     * nodes deleted during the scan are recovered from the epoch bags.
+     *
+     * The range is scanned in consecutive windows. Each window is an
+     * ordinary range query over its part of the range (a traversal, then
+     * the nodes deleted since the snapshot started), linearized at the same
+     * timestamp as the others, and the thread's hash list only holds the
+     * keys of the current window. So the memory of a snapshot is bounded by
+     * RQ_SNAPSHOT_WINDOW_KEYS (plus the keys of the nodes deleted in the
+     * window), not by the size of the range, at the price of one pass over
+     * the announcements and epoch bags per window.
+     *
+     * The data structure drives its own traversal (see rq_snapshot_cursor),
+     * and hands out the keys of each visited node before visiting the next
+     * one:
+     *
+     *     snapshot_start(tid);
+     *     for each window [wlo, whi) of [lo, hi]:
+     *         for each node reached by the traversal of [wlo, hi]:
+     *             snapshot_visit(tid, node, wlo, hi);
+     *             emit its keys: while (snapshot_has_pending(tid)) snapshot_emit(tid, keys, values, capacity);
+     *             if (snapshot_window_full(tid)) stop the traversal, and pick whi
+     *         snapshot_traversal_done(tid);
+     *         while (snapshot_visit_deleted(tid, wlo, hi)) { emit the keys below whi }
+     *         snapshot_next_window(tid);
+     *     snapshot_end(tid);
+     *
+     * whi must be a key that no node visited by the traversal of the window
+     * can reach (the smallest key of the subtrees it has not visited yet), so
+     * that the windows do not overlap. Within a window, keys found by the
+     * traversal come out in traversal order, and keys of nodes deleted
+     * during the scan come out last.
+     */
+    long long snapshot_start(const int tid) {
+        traversal_start(tid);
+        __rq_snapshot_state * state = &snapshots[tid];
+        state->phase = SNAPSHOT_PHASE_TRAVERSAL;
+        state->windowKeys = 0;
+        state->numPending = 0;
+        state->nextPending = 0;
+        return threadData[tid].rq_lin_time;
+    }
+
+    inline bool snapshot_has_pending(const int tid) {
+        return snapshots[tid].nextPending < snapshots[tid].numPending;
+    }
+
+    // moves up to capacity pending keys to the caller's buffers, and returns how many
+    inline int snapshot_emit(const int tid, K * const outputKeys, V * const outputValues, const int capacity) {
+        __rq_snapshot_state * state = &snapshots[tid];
+        int cnt = 0;
+        while (cnt < capacity && state->nextPending < state->numPending) {
+            outputKeys[cnt] = state->pendingKeys[state->nextPending];
+            outputValues[cnt] = state->pendingValues[state->nextPending];
+            ++state->nextPending;
+            ++cnt;
+        }
+        return cnt;
+    }
+
+private:
+    inline void snapshot_visit(const int tid, NodeType * const node, const K& lo, const K& hi, bool foundDuringTraversal) {
+        __rq_snapshot_state * state = &snapshots[tid];
+        assert(!snapshot_has_pending(tid));
+        state->numPending = 0;
+        state->nextPending = 0;
+        traversal_try_add(tid, node, state->pendingKeys, state->pendingValues, &state->numPending, lo, hi, foundDuringTraversal);
+    }
+
+public:
+    // the pending keys must have been emitted before the next visit
+    inline void snapshot_visit(const int tid, NodeType * const node, const K& lo, const K& hi) {
+        snapshot_visit(tid, node, lo, hi, true);
+        snapshots[tid].windowKeys += snapshots[tid].numPending;
+    }
+
+    // true once the traversal of the current window found RQ_SNAPSHOT_WINDOW_KEYS keys
+    inline bool snapshot_window_full(const int tid) {
+        return snapshots[tid].windowKeys >= RQ_SNAPSHOT_WINDOW_KEYS;
+    }
+
+    void snapshot_traversal_done(const int tid) {
+        __rq_snapshot_state * state = &snapshots[tid];
+        assert(state->phase == SNAPSHOT_PHASE_TRAVERSAL);
+        SOFTWARE_BARRIER;
+        state->endTimestamp = timestamp;
+        SOFTWARE_BARRIER;
+        state->phase = SNAPSHOT_PHASE_ANNOUNCEMENTS;
+        state->otherTid = 0;
+        state->announcementIx = 0;
+        state->numAnnouncements = -1;
+    }
+
+    /**
+     * visits the next node that was announced or retired by another process
+     * (the nodes traversal_end visits). returns false once all were visited.
+     * the pending keys must have been emitted before the next call.
+     */
+    bool snapshot_visit_deleted(const int tid, const K& lo, const K& hi) {
+        __rq_snapshot_state * state = &snapshots[tid];
+        while (state->phase == SNAPSHOT_PHASE_ANNOUNCEMENTS) {
+            if (state->otherTid >= NUM_PROCESSES) {
+                SOFTWARE_BARRIER;
+                // collect epoch bags of other processes (MUST be after checking announcements!)
+                state->bags.clear();
+                state->iterators.clear();
+                for (int otherTid=0;otherTid<NUM_PROCESSES;++otherTid) if (otherTid != tid) {
+                    blockbag<NodeType> * thread_bags[NUMBER_OF_EPOCH_BAGS+1];
+                    recmgr->get((NodeType *) NULL)->reclaim->getSafeBlockbags(otherTid, thread_bags);
+                    for (int i=0;thread_bags[i];++i) {
+                        state->bags.push_back(thread_bags[i]);
+                        state->iterators.push_back(thread_bags[i]->begin());
+                    }
+                }
+                state->bagIx = 0;
+                state->phase = SNAPSHOT_PHASE_EPOCH_BAGS;
+                break;
+            }
+            if (state->otherTid == tid) {
+                ++state->otherTid;
+                continue;
+            }
+            if (state->numAnnouncements < 0) {
+                state->numAnnouncements = threadData[state->otherTid].numAnnouncements;
+                SOFTWARE_BARRIER;
+            }
+            if (state->announcementIx < state->numAnnouncements) {
+                NodeType * node = (NodeType *) threadData[state->otherTid].announcements[state->announcementIx++];
+                assert(node);
+                snapshot_visit(tid, node, lo, hi, false);
+                return true;
+            }
+            ++state->otherTid;
+            state->announcementIx = 0;
+            state->numAnnouncements = -1;
+        }
+        while (state->phase == SNAPSHOT_PHASE_EPOCH_BAGS) {
+            if (state->bagIx >= (int) state->bags.size()) {
+                state->phase = SNAPSHOT_PHASE_DONE;
+                break;
+            }
+            if (!(state->iterators[state->bagIx] != state->bags[state->bagIx]->end())) {
+                ++state->bagIx;
+                continue;
+            }
+            NodeType * node = (*state->iterators[state->bagIx]);
+            state->iterators[state->bagIx]++;
+            assert(node);
+
+            long long dtime = node->dtime;
+            if (dtime != TIMESTAMP_NOT_SET && dtime > state->endTimestamp) continue;
+            if (!(logicalDeletion && canRetireNodesLogicallyDeletedByOtherProcesses)) {
+                // bags are ordered by dtime (see traversal_end), so the rest of this bag was deleted before the snapshot
+                if (dtime != TIMESTAMP_NOT_SET && dtime < threadData[tid].rq_lin_time) {
+                    ++state->bagIx;
+                    continue;
+                }
+            }
+            snapshot_visit(tid, node, lo, hi, false);
+            return true;
+        }
+        return false;
+    }
+
+    // starts the traversal of the next window, once snapshot_visit_deleted returned false
+    void snapshot_next_window(const int tid) {
+        __rq_snapshot_state * state = &snapshots[tid];
+        assert(state->phase == SNAPSHOT_PHASE_DONE);
+        assert(!snapshot_has_pending(tid));
+        threadData[tid].hashlist->clear();
+        state->phase = SNAPSHOT_PHASE_TRAVERSAL;
+        state->windowKeys = 0;
+        state->bags.clear();
+        state->iterators.clear();
+    }
+
+    void snapshot_end(const int tid) {
+        __rq_snapshot_state * state = &snapshots[tid];
+        state->phase = SNAPSHOT_PHASE_DONE;
+        state->numPending = 0;
+        state->nextPending = 0;
+        state->bags.clear();
+        state->iterators.clear();
+    }
+};
+
+/**
+ * traversal state of a streaming snapshot of a search tree (see STREAMING
+ * SNAPSHOTS in RQProvider): the subtrees that the traversal of the current
+ * window has yet to visit, each with the smallest key it can contain
+ * (bounded is false if it has no lower bound other than the window's).
+ */
+template <typename K, typename NodeType>
+struct rq_snapshot_cursor {
+    struct subtree {
+        NodeType * node;
+        bool bounded;
+        K lowerBound;
+    };
+    K lo;                   // start of the current window
+    K hi;
+    bool traversalDone;
+    bool windowBounded;     // whether the current window ends before windowEnd (or at hi)
+    K windowEnd;
+    std::vector<subtree> stack;
+
+    void startWindow(const K& windowStart, NodeType * const root) {
+        lo = windowStart;
+        traversalDone = false;
+        windowBounded = false;
+        stack.clear();
+        stack.push_back({root, false, windowStart});
+    }
+
+    /**
+     * ends the traversal of the current window before the subtrees it has
+     * not visited yet, if they all have a lower bound above the window's
+     * start. returns false if the window cannot end there.
+     */
+    template <class Compare>
+    bool endWindow(Compare& cmp) {
+        if (stack.empty()) return false;
+        K end = stack.back().lowerBound;
+        for (auto it = stack.begin(); it != stack.end(); ++it) {
+            if (!it->bounded) return false;
+            if (cmp(it->lowerBound, end)) end = it->lowerBound;
+        }
+        if (!cmp(lo, end)) return false;
+        windowEnd = end;
+        windowBounded = true;
+        stack.clear();
+        return true;
+    }
+
+    // drops the keys at or above the end of the window, and returns how many are left
+    template <class Compare, typename V>
+    int clip(Compare& cmp, K * const keys, V * const values, const int cnt) {
+        if (!windowBounded) return cnt;
+        int kept = 0;
+        for (int i=0;i<cnt;++i) {
+            if (!cmp(keys[i], windowEnd)) continue;
+            keys[kept] = keys[i];
+            values[kept] = values[i];
+            ++kept;
+        }
+        return kept;
+    }
 };
 
 #endif	/* RQ_DCSSP_H */
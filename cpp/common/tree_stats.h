@@ -7,14 +7,26 @@
 
 #ifdef USE_TREE_STATS
 
+#include <atomic>
 #include <cassert>
+#include <cstdint>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <vector>
 #include <limits>
+#include <x86intrin.h>
+#ifdef _OPENMP
+#   include <omp.h>
+#endif
 #include "plaf.h"
+#include "random_xoshiro256p.h"
 
-#define MAX_HEIGHT (1<<10)
+#ifndef TREE_STATS_CACHE_LEVELS
+#define TREE_STATS_CACHE_LEVELS 4
+#endif
 
 /**
  * TODO: extend tree_stats.h to start tracking memory layout issues
@@ -25,194 +37,372 @@
  *  avg page density,
  *  alignment histogram,
  *  page occupancy visualizations,
- *  unique pages needed,
- *  unique cache lines needed)
+ *  unique pages needed)
+ */
+
+/**
+ * How TreeStats are computed (set before the data structure is asked for its
+ * TreeStats, e.g. with the -tree-stats-samples argument of the benchmark).
+ *
+ * With sampleWalks == 0, every node is visited. The traversal is depth first
+ * with an explicit stack per thread (so its memory is bounded by the height
+ * times the degree of the tree, not by its size), and if parallelConstruction
+ * is requested, threads that run out of nodes steal the shallowest pending
+ * subtrees of the other threads.
+ *
+ * With sampleWalks > 0, the per-depth counts are estimated from that many
+ * random root-to-leaf walks (Knuth's estimator: a node reached through
+ * ancestors of degrees d_1, ..., d_k counts as d_1 * ... * d_k nodes), which
+ * is unbiased, but only an estimate, so the key sum cannot validate the run.
+ *
+ * With TREE_STATS_BYTES_AT_DEPTH, the distinct cache lines spanned by the
+ * nodes of the top cacheLevels levels are also counted (always exactly).
+ *
+ * With flushNodes, every node is evicted from the caches (clflush) once it has
+ * been visited (e.g., for the cold cache mode of the benchmark): all the lines
+ * of the node with TREE_STATS_BYTES_AT_DEPTH, and its first line otherwise.
  */
+struct tree_stats_options {
+    size_t sampleWalks;
+    size_t cacheLevels;
+    bool flushNodes;
+
+    tree_stats_options() : sampleWalks(0), cacheLevels(TREE_STATS_CACHE_LEVELS), flushNodes(false) {}
+};
+
+tree_stats_options tree_stats_opts;
 
 template <typename NodeHandlerT>
 class TreeStats {
 private:
     typedef typename NodeHandlerT::NodePtrType nodeptr;
+
+    struct DepthCounts {
+        std::vector<size_t> internals;
+        std::vector<size_t> leaves;
+        std::vector<size_t> keys;
+        std::vector<size_t> keysInLeaves;
+        std::vector<size_t> keysInInternals;
+        std::vector<size_t> bytes;
+        size_t sumOfKeys = 0;
+
+        void grow(size_t depth) {
+            if (depth < internals.size()) return;
+            size_t size = 2*depth + 1;
+            internals.resize(size, 0);
+            leaves.resize(size, 0);
+            keys.resize(size, 0);
+            keysInLeaves.resize(size, 0);
+            keysInInternals.resize(size, 0);
+            bytes.resize(size, 0);
+        }
+        void add(const DepthCounts& other) {
+            if (other.internals.empty()) return;
+            grow(other.internals.size() - 1);
+            for (size_t d=0;d<other.internals.size();++d) {
+                internals[d] += other.internals[d];
+                leaves[d] += other.leaves[d];
+                keys[d] += other.keys[d];
+                keysInLeaves[d] += other.keysInLeaves[d];
+                keysInInternals[d] += other.keysInInternals[d];
+                bytes[d] += other.bytes[d];
+            }
+            sumOfKeys += other.sumOfKeys;
+        }
+    };
+
+    struct WorkItem {
+        nodeptr node;
+        size_t depth;
+    };
+
+    struct Worker {
+        PAD;
+        std::vector<WorkItem> stack;    // private: depth first order
+        std::mutex lock;
+        std::vector<WorkItem> shared;   // published for other threads to steal
+        std::atomic<size_t> numShared;
+        DepthCounts counts;
+        std::vector<std::unordered_set<uintptr_t>> cacheLines; // per depth < cacheLevels
+        PAD;
+
+        Worker(size_t cacheLevels) : numShared(0), cacheLines(cacheLevels) {}
+
+        // move the shallowest half of the stack to shared
+        void publish() {
+            std::lock_guard<std::mutex> guard(lock);
+            size_t half = stack.size() / 2;
+            shared.insert(shared.end(), stack.begin(), stack.begin() + half);
+            stack.erase(stack.begin(), stack.begin() + half);
+            numShared = shared.size();
+        }
+        // move up to half (all, if thief == this) of shared to the stack of thief
+        bool steal(Worker * thief) {
+            std::lock_guard<std::mutex> guard(lock);
+            if (shared.empty()) return false;
+            size_t n = (thief == this) ? shared.size() : (shared.size() + 1) / 2;
+            thief->stack.insert(thief->stack.end(), shared.begin(), shared.begin() + n);
+            shared.erase(shared.begin(), shared.begin() + n);
+            numShared = shared.size();
+            return true;
+        }
+    };
+
     PAD;
-    size_t internalsAtDepth[MAX_HEIGHT];
-    size_t leavesAtDepth[MAX_HEIGHT];
-    size_t keysAtDepth[MAX_HEIGHT];
-    size_t keysInLeavesAtDepth[MAX_HEIGHT];
-    size_t keysInInternalsAtDepth[MAX_HEIGHT];
+    std::vector<size_t> internalsAtDepth;
+    std::vector<size_t> leavesAtDepth;
+    std::vector<size_t> keysAtDepth;
+    std::vector<size_t> keysInLeavesAtDepth;
+    std::vector<size_t> keysInInternalsAtDepth;
     size_t sumOfKeys;
 #ifdef TREE_STATS_BYTES_AT_DEPTH
-    size_t bytesAtDepth[MAX_HEIGHT];
+    std::vector<size_t> bytesAtDepth;
+    std::vector<size_t> cacheLinesAtDepth;
 #endif
+    size_t sampleWalks; // 0 if the counts are exact
     PAD;
 
-    void computeStats(NodeHandlerT * handler, nodeptr node, size_t depth, size_t maxDepth = std::numeric_limits<size_t>::max()) {
-        if (!handler) return;
-
-        //std::cout<<"nodeAddr="<<(size_t)node<<" depth="<<depth<<" degree="<<node->size<<" internal?="<<NodeHandlerT::isInternal(node)<<std::endl;
-        if (!node || depth > maxDepth) return;
+    void visit(NodeHandlerT * handler, Worker * w, nodeptr node, size_t depth, size_t maxDepth) {
+        DepthCounts& c = w->counts;
+        c.grow(depth);
         size_t numKeys = handler->getNumKeys(node);
-        keysAtDepth[depth] += numKeys;
-        sumOfKeys += handler->getSumOfKeys(node);
+        c.keys[depth] += numKeys;
+        c.sumOfKeys += handler->getSumOfKeys(node);
 #ifdef TREE_STATS_BYTES_AT_DEPTH
-        bytesAtDepth[depth] += handler->getSizeInBytes(node);
+        size_t bytes = handler->getSizeInBytes(node);
+        c.bytes[depth] += bytes;
+        if (depth < w->cacheLines.size() && bytes > 0) {
+            uintptr_t addr = (uintptr_t) node; // (tag bits of a tagged pointer do not change its line)
+            for (uintptr_t line = addr / BYTES_IN_CACHE_LINE; line <= (addr + bytes - 1) / BYTES_IN_CACHE_LINE; ++line) {
+                w->cacheLines[depth].insert(line);
+            }
+        }
 #endif
         if (handler->isLeaf(node)) {
-            ++leavesAtDepth[depth];
-            keysInLeavesAtDepth[depth] += numKeys;
+            ++c.leaves[depth];
+            c.keysInLeaves[depth] += numKeys;
         } else {
-            ++internalsAtDepth[depth];
-            keysInInternalsAtDepth[depth] += numKeys;
+            ++c.internals[depth];
+            c.keysInInternals[depth] += numKeys;
+            if (depth == maxDepth) return;
             auto it = handler->getChildIterator(node);
             while (it.hasNext()) {
                 auto child = it.next();
-                computeStats(handler, child, 1+depth, maxDepth);
+                if (child) w->stack.push_back({child, depth+1});
             }
         }
     }
 
-public:
-    TreeStats(NodeHandlerT * handler, nodeptr root, bool parallelConstruction, bool freeHandler = true) {
-        for (size_t d=0;d<MAX_HEIGHT;++d) {
-            internalsAtDepth[d] = 0;
-            leavesAtDepth[d] = 0;
-            keysAtDepth[d] = 0;
-            keysInLeavesAtDepth[d] = 0;
-            keysInInternalsAtDepth[d] = 0;
+    void flush(NodeHandlerT * handler, nodeptr node) {
+        uintptr_t addr = (uintptr_t) node;
 #ifdef TREE_STATS_BYTES_AT_DEPTH
-            bytesAtDepth[d] = 0;
+        size_t bytes = handler->getSizeInBytes(node);
+#else
+        size_t bytes = 1;
 #endif
+        for (uintptr_t line = addr / BYTES_IN_CACHE_LINE; line <= (addr + bytes - 1) / BYTES_IN_CACHE_LINE; ++line) {
+            _mm_clflush((const void *) (line * BYTES_IN_CACHE_LINE));
         }
-        sumOfKeys = 0;
-#ifdef _OPENMP
-
-        if (!handler) return;
-
-        if (!parallelConstruction) {
-            computeStats(handler, root, 0);
+    }
 
-        } else {
-            /**
-             * PARALLEL constructor
-             */
-            std::cout<<"computing tree_stats in PARALLEL..."<<std::endl;
-            #ifdef _OPENMP
-                const size_t minNodes = 4*omp_get_max_threads();
-            #else
-                const size_t minNodes = 1;
-            #endif
-
-            std::vector<nodeptr> qn;    // queue of node pointers
-            std::vector<size_t> qd;     // queue of depths
-            qn.reserve(minNodes*2);
-            qd.reserve(minNodes*2);
-            qn.push_back(root);
-            qd.push_back(0);
-
-            size_t ix = 0; // index of top in qn and qd
-            size_t currDepth = 0;
-            size_t ixStartOfDepth = 0;
-            size_t nodesSeenAtDepth = 0;
-
-            #ifdef _OPENMP
-                const size_t ompThreads = omp_get_max_threads();
-            #else
-                const size_t ompThreads = 1;
-            #endif
-            std::cout<<"bounded depth BFS to partition into subtrees for parallel computation ("<<ompThreads<<" threads)..."<<std::endl;
-            while (ix < qn.size()) {
-                auto node = qn[ix];
-                auto depth = qd[ix];
-                TRACE COUTATOMIC("tree_stats: queue visiting node "<<(uintptr_t) node<<" at depth "<<depth<<std::endl);
-                ++ix;
-                TRACE COUTATOMIC("tree_stats: new ix="<<ix<<std::endl);
-
-                if (depth != currDepth) {
-                    if (nodesSeenAtDepth >= minNodes) {
-                        TRACE COUTATOMIC("tree_stats: we have seen enough nodes ("<<nodesSeenAtDepth<<") at depth "<<currDepth<<" so we cut off the bfs"<<std::endl);
-                        --ix;
-                        TRACE COUTATOMIC("tree_stats: new new ix="<<ix<<std::endl);
-                        break;
-                    }
-                    currDepth = depth;
-                    nodesSeenAtDepth = 0;
-                    ixStartOfDepth = ix-1;
-                    TRACE COUTATOMIC("tree_stats: new depth "<<depth<<" ixStartOfDepth="<<ixStartOfDepth<<std::endl);
-                }
-                ++nodesSeenAtDepth;
-                TRACE COUTATOMIC("tree_stats: nodesSeenAtDepth "<<currDepth<<" changed to "<<nodesSeenAtDepth<<std::endl);
-
-                // add any children to the queue
-                if (node && !handler->isLeaf(node)) {
-                    auto it = handler->getChildIterator(node);
-                    while (it.hasNext()) {
-                        auto child = it.next();
-                        TRACE COUTATOMIC("tree_stats: add child "<<(uintptr_t) child<<" of node "<<(uintptr_t) node<<" to queue at depth "<<(1+depth)<<std::endl);
-                        qn.push_back(child);
-                        qd.push_back(1+depth);
+    // one worker of the traversal of all nodes at depth <= maxDepth
+    void traverse(NodeHandlerT * handler, std::vector<Worker *>& workers, const int tid, const int numThreads,
+                  std::atomic<int>& numIdle, size_t maxDepth) {
+        Worker * me = workers[tid];
+        while (true) {
+            if (me->stack.empty() && !me->steal(me)) {
+                // out of work: steal from the others until every thread is out of work
+                ++numIdle;
+                bool found = false;
+                while (!found && numIdle < numThreads) {
+                    for (int i=1;i<numThreads && !found;++i) {
+                        Worker * victim = workers[(tid+i) % numThreads];
+                        if (victim->numShared == 0) continue;
+                        --numIdle;
+                        found = victim->steal(me);
+                        if (!found) ++numIdle;
                     }
+                    if (!found) std::this_thread::yield();
                 }
+                if (!found) return;
             }
-            if (nodesSeenAtDepth < minNodes) {
-                currDepth = 0;
-                ix = 1;
-                ixStartOfDepth = 0;
-                TRACE COUTATOMIC("tree_stats: not enough nodes seen ("<<nodesSeenAtDepth<<") at any depth just partition into ONE tree"<<std::endl);
+            WorkItem item = me->stack.back();
+            me->stack.pop_back();
+            visit(handler, me, item.node, item.depth, maxDepth);
+            if (tree_stats_opts.flushNodes) flush(handler, item.node);
+            if (numIdle.load(std::memory_order_relaxed) > 0 && me->stack.size() > 1 && me->numShared == 0) {
+                me->publish();
             }
+        }
+    }
 
-            // we now have at least minNodes subtrees to process (in qn[ixStartOfDepth ... ix]),
-            // so we can use openmp parallel for to construct TreeStats for these subtrees in parallel.
-            std::cout<<"partitioned into "<<(ix-ixStartOfDepth)<<" subtrees; running parallel for..."<<std::endl;
-            #pragma omp parallel for schedule(dynamic, 1)
-            for (size_t i=ixStartOfDepth;i<ix;++i) {
-                TreeStats<NodeHandlerT> * ts = new TreeStats(handler, qn[i], false, false);
-                TRACE COUTATOMIC("tree_stats: sequential compute at depth "<<currDepth<<std::endl);
-                for (size_t d=0;d<MAX_HEIGHT-currDepth;++d) {
-                    FAA(&internalsAtDepth[d+currDepth], ts->internalsAtDepth[d]);
-                    FAA(&leavesAtDepth[d+currDepth], ts->leavesAtDepth[d]);
-                    FAA(&keysAtDepth[d+currDepth], ts->keysAtDepth[d]);
-                    FAA(&keysInLeavesAtDepth[d+currDepth], ts->keysInLeavesAtDepth[d]);
-                    FAA(&keysInInternalsAtDepth[d+currDepth], ts->keysInInternalsAtDepth[d]);
+    void computeStats(NodeHandlerT * handler, nodeptr root, bool parallel, size_t maxDepth, DepthCounts& result
 #ifdef TREE_STATS_BYTES_AT_DEPTH
-                    FAA(&bytesAtDepth[d+currDepth], ts->bytesAtDepth[d]);
+                      , std::vector<size_t>& linesAtDepth
+#endif
+                      ) {
+        int maxThreads = 1;
+#ifdef _OPENMP
+        if (parallel) maxThreads = omp_get_max_threads();
+#endif
+        std::vector<Worker *> workers;
+        for (int i=0;i<maxThreads;++i) {
+            workers.push_back(new Worker(tree_stats_opts.cacheLevels));
+        }
+        workers[0]->stack.push_back({root, 0});
+        std::atomic<int> numIdle(0);
+#ifdef _OPENMP
+        if (maxThreads > 1) {
+            #pragma omp parallel num_threads(maxThreads)
+            traverse(handler, workers, omp_get_thread_num(), omp_get_num_threads(), numIdle, maxDepth);
+        } else
 #endif
+        {
+            traverse(handler, workers, 0, 1, numIdle, maxDepth);
+        }
+
+        for (auto w : workers) {
+            result.add(w->counts);
+        }
+#ifdef TREE_STATS_BYTES_AT_DEPTH
+        linesAtDepth.assign(tree_stats_opts.cacheLevels, 0);
+        for (size_t d=0;d<linesAtDepth.size();++d) {
+            std::unordered_set<uintptr_t> lines;
+            for (auto w : workers) {
+                lines.insert(w->cacheLines[d].begin(), w->cacheLines[d].end());
+            }
+            linesAtDepth[d] = lines.size();
+        }
+#endif
+        for (auto w : workers) {
+            delete w;
+        }
+    }
+
+    // Knuth's estimator over numWalks random root-to-leaf walks
+    void estimateStats(NodeHandlerT * handler, nodeptr root, bool parallel, size_t numWalks, DepthCounts& result) {
+        int maxThreads = 1;
+#ifdef _OPENMP
+        if (parallel) maxThreads = omp_get_max_threads();
+#endif
+        std::vector<std::vector<double>> sums(maxThreads); // per thread: 6 estimates per depth, then the sum of keys
+        #pragma omp parallel for num_threads(maxThreads) schedule(static)
+        for (size_t walk=0;walk<numWalks;++walk) {
+#ifdef _OPENMP
+            const int tid = omp_get_thread_num();
+#else
+            const int tid = 0;
+#endif
+            std::vector<double>& est = sums[tid];
+            if (est.empty()) est.push_back(0);
+            Random64 rng(walk * 0x9E3779B97F4A7C15ULL + 1);
+
+            double weight = 1;
+            nodeptr node = root;
+            for (size_t depth=0; node; ++depth) {
+                if (est.size() < 1 + 6*(depth+1)) est.resize(1 + 6*(depth+1), 0);
+                double * at = &est[1 + 6*depth];
+                size_t numKeys = handler->getNumKeys(node);
+                at[2] += weight * numKeys;
+                est[0] += weight * handler->getSumOfKeys(node);
+#ifdef TREE_STATS_BYTES_AT_DEPTH
+                at[5] += weight * handler->getSizeInBytes(node);
+#endif
+                if (handler->isLeaf(node)) {
+                    at[1] += weight;
+                    at[3] += weight * numKeys;
+                    break;
                 }
-                FAA(&sumOfKeys, ts->sumOfKeys);
-                delete ts;
+                at[0] += weight;
+                at[4] += weight * numKeys;
+
+                size_t degree = 0;
+                for (auto it = handler->getChildIterator(node); it.hasNext(); it.next()) ++degree;
+                if (degree == 0) break;
+                size_t choice = rng.next(degree);
+                auto it = handler->getChildIterator(node);
+                for (size_t i=0;i<choice;++i) it.next();
+                node = it.next();
+                weight *= degree;
             }
+        }
 
-//            std::cout<<"currDepth="<<currDepth<<std::endl;
-//            std::cout<<(ix-ixStartOfDepth+1)<<" subtrees computed in parallel... addresses:"<<std::endl;
-//            for (int i=ixStartOfDepth;i<ix;++i) {
-//                std::cout<<" "<<qn[i]<<"[depth "<<qd[i]<<"]";
-//            }
-//            std::cout<<std::endl;
+        std::vector<double> total;
+        for (auto& est : sums) {
+            if (total.size() < est.size()) total.resize(est.size(), 0);
+            for (size_t i=0;i<est.size();++i) total[i] += est[i];
+        }
+        if (total.empty()) return;
+        const size_t height = (total.size() - 1) / 6;
+        result.grow(height - 1);
+        auto estimate = [&](double sum) { return (size_t) (sum / numWalks + 0.5); };
+        for (size_t d=0;d<height;++d) {
+            const double * at = &total[1 + 6*d];
+            result.internals[d] = estimate(at[0]);
+            result.leaves[d] = estimate(at[1]);
+            result.keys[d] = estimate(at[2]);
+            result.keysInLeaves[d] = estimate(at[3]);
+            result.keysInInternals[d] = estimate(at[4]);
+            result.bytes[d] = estimate(at[5]);
+        }
+        result.sumOfKeys = estimate(total[0]);
+    }
 
-            // compute stats for the top of the tree, ABOVE the parallel constructed subtrees.
-            std::cout<<"computing stats for the top of the tree (above the partitions)..."<<std::endl;
-            if (currDepth > 0) computeStats(handler, root, 0, currDepth - 1);
+public:
+    TreeStats(NodeHandlerT * handler, nodeptr root, bool parallelConstruction, bool freeHandler = true) {
+        sumOfKeys = 0;
+        sampleWalks = tree_stats_opts.sampleWalks;
+        if (!handler) return;
 
+        DepthCounts counts;
+#ifdef TREE_STATS_BYTES_AT_DEPTH
+        std::vector<size_t> lines;
+#endif
+        if (root) {
+            if (parallelConstruction) std::cout<<"computing tree_stats in PARALLEL..."<<std::endl;
+            if (sampleWalks > 0) {
+                std::cout<<"estimating tree_stats from "<<sampleWalks<<" random root-to-leaf walks..."<<std::endl;
+                estimateStats(handler, root, parallelConstruction, sampleWalks, counts);
+#ifdef TREE_STATS_BYTES_AT_DEPTH
+                if (tree_stats_opts.cacheLevels > 0) {
+                    DepthCounts top;
+                    computeStats(handler, root, parallelConstruction, tree_stats_opts.cacheLevels - 1, top, lines);
+                }
+#endif
+            } else {
+                computeStats(handler, root, parallelConstruction, std::numeric_limits<size_t>::max(), counts
+#ifdef TREE_STATS_BYTES_AT_DEPTH
+                             , lines
+#endif
+                             );
+            }
         }
-#else
-        computeStats(handler, root, 0);
+
+        internalsAtDepth = counts.internals;
+        leavesAtDepth = counts.leaves;
+        keysAtDepth = counts.keys;
+        keysInLeavesAtDepth = counts.keysInLeaves;
+        keysInInternalsAtDepth = counts.keysInInternals;
+        sumOfKeys = counts.sumOfKeys;
+#ifdef TREE_STATS_BYTES_AT_DEPTH
+        bytesAtDepth = counts.bytes;
+        cacheLinesAtDepth = lines;
 #endif
         if (freeHandler) delete handler;
     }
 
     size_t getInternalsAtDepth(size_t d) {
-        assert(d < MAX_HEIGHT);
-        return internalsAtDepth[d];
+        return (d < internalsAtDepth.size()) ? internalsAtDepth[d] : 0;
     }
     size_t getLeavesAtDepth(size_t d) {
-        assert(d < MAX_HEIGHT);
-        return leavesAtDepth[d];
+        return (d < leavesAtDepth.size()) ? leavesAtDepth[d] : 0;
     }
     size_t getNodesAtDepth(size_t d) {
-        assert(d < MAX_HEIGHT);
         return getInternalsAtDepth(d) + getLeavesAtDepth(d);
     }
     size_t getHeight() {
         size_t d=0;
-        while (d < MAX_HEIGHT && getNodesAtDepth(d) > 0) {
+        while (getNodesAtDepth(d) > 0) {
             ++d;
         }
         return d;
@@ -237,12 +427,10 @@ public:
         return getInternals() + getLeaves();
     }
     size_t getPointersAtDepth(size_t d) {
-        assert(d+1 < MAX_HEIGHT);
         return getNodesAtDepth(d+1);
     }
     size_t getKeysAtDepth(size_t d) {
-        assert(d < MAX_HEIGHT);
-        return keysAtDepth[d];
+        return (d < keysAtDepth.size()) ? keysAtDepth[d] : 0;
     }
     size_t getKeys() {
         size_t maxDepth = getHeight();
@@ -304,7 +492,7 @@ public:
     }
 #ifdef TREE_STATS_BYTES_AT_DEPTH
     size_t getBytesAtDepth(size_t d) {
-        return bytesAtDepth[d];
+        return (d < bytesAtDepth.size()) ? bytesAtDepth[d] : 0;
     }
     size_t getSizeInBytes() {
         size_t height = getHeight();
@@ -314,10 +502,25 @@ public:
         }
         return bytes;
     }
+    double getBytesPerKey() {
+        double denom = getKeys();
+        return (denom == 0) ? 0 : getSizeInBytes() / denom;
+    }
+    // distinct cache lines spanned by the nodes at depth d < tree_stats_opts.cacheLevels
+    size_t getCacheLinesAtDepth(size_t d) {
+        return (d < cacheLinesAtDepth.size()) ? cacheLinesAtDepth[d] : 0;
+    }
+    size_t getCacheLevels() {
+        return cacheLinesAtDepth.size();
+    }
 #endif
     size_t getSumOfKeys() {
         return sumOfKeys;
     }
+    // number of random walks the counts were estimated from (0 if they are exact)
+    size_t getSampleWalks() {
+        return sampleWalks;
+    }
     std::string toString() {
         std::stringstream ss;
         size_t height = getHeight();
@@ -391,7 +594,21 @@ public:
         }
         ss<<std::endl;
         ss<<"tree_stats_sizeInBytes="<<getSizeInBytes()<<std::endl;
+        ss<<"tree_stats_bytesPerKey="<<getBytesPerKey()<<std::endl;
+
+        size_t cacheLines = 0;
+        ss<<"tree_stats_cacheLinesAtDepth=";
+        for (size_t d=0;d<getCacheLevels();++d) {
+            ss<<(d?" ":"")<<getCacheLinesAtDepth(d);
+            cacheLines += getCacheLinesAtDepth(d);
+        }
+        ss<<std::endl;
+        ss<<"tree_stats_cacheLinesTopLevels="<<cacheLines<<std::endl;
 #endif
+        if (sampleWalks > 0) {
+            ss<<std::endl;
+            ss<<"tree_stats_sampleWalks="<<sampleWalks<<std::endl;
+        }
 
         return ss.str();
     }
@@ -14,20 +14,25 @@
 
 #include <iostream>
 #include "errors.h"
+#include "ds_parameters.h"
 #ifdef USE_TREE_STATS
 #   define TREE_STATS_BYTES_AT_DEPTH
 #   include "tree_stats.h"
 #endif
 #include "ccavl_impl.h"
+#include "hot_key_combiner.h"
 
 #define NODE_T node_t<K,V>
 #define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, NODE_T>
 #define DATA_STRUCTURE_T ccavl<K, V, RECORD_MANAGER_T>
+#define COMBINER_T hot_key_combiner<K, V, DATA_STRUCTURE_T>
 
 template <typename K, typename V, class Reclaim = reclaimer_debra<K>, class Alloc = allocator_new<K>, class Pool = pool_none<K>>
 class ds_adapter {
 private:
     DATA_STRUCTURE_T * const tree;
+    // optional flat-combining front-end for updates (ds parameter bronson.combining)
+    COMBINER_T * const combiner;
 
 public:
     ds_adapter(const int NUM_THREADS,
@@ -35,13 +40,18 @@ public:
                const K& unused1,
                const V& unused2,
                Random64 * const unused3)
-    : tree(new DATA_STRUCTURE_T(NUM_THREADS, KEY_NEG_INFTY))
+    : tree(new DATA_STRUCTURE_T(NUM_THREADS, KEY_NEG_INFTY
+            , ds_parameters::get<int>("bronson.spinCount", SPIN_COUNT)
+            , ds_parameters::get<int>("bronson.yieldCount", YIELD_COUNT)
+            , ds_parameters::get<bool>("bronson.readerBypass", false)))
+    , combiner(ds_parameters::get<bool>("bronson.combining", false) ? new COMBINER_T(tree, NULL) : NULL)
     {
         if (NUM_THREADS > MAX_THREADS_POW2) {
             setbench_error("NUM_THREADS exceeds MAX_THREADS_POW2");
         }
     }
     ~ds_adapter() {
+        delete combiner;
         delete tree;
     }
 
@@ -60,12 +70,15 @@ public:
         return tree->find(tid, key) != getNoValue();
     }
     V insert(const int tid, const K& key, const V& val) {
+        if (combiner) return combiner->update(tid, COMBINER_T::INSERT_REPLACE, key, val);
         return tree->insertReplace(tid, key, val);
     }
     V insertIfAbsent(const int tid, const K& key, const V& val) {
+        if (combiner) return combiner->update(tid, COMBINER_T::INSERT_IF_ABSENT, key, val);
         return tree->insertIfAbsent(tid, key, val);
     }
     V erase(const int tid, const K& key) {
+        if (combiner) return combiner->update(tid, COMBINER_T::ERASE, key, NULL);
         return tree->erase(tid, key);
     }
     V find(const int tid, const K& key) {
@@ -76,6 +89,14 @@ public:
     }
     void printSummary() {
         tree->printSummary();
+        std::cout<<"combining_enabled="<<(combiner != NULL)<<std::endl;
+#ifdef GSTATS_HANDLE_STATS
+        if (combiner) {
+            long long updates = GSTATS_OBJECT_NAME.get_sum<long long>(num_combining_updates);
+            long long eliminated = GSTATS_OBJECT_NAME.get_sum<long long>(num_eliminated_updates);
+            std::cout<<"combining_elimination_rate="<<(updates ? eliminated / (double) updates : 0.)<<std::endl;
+        }
+#endif
     }
     bool validateStructure() {
         return true;
@@ -187,5 +208,6 @@ public:
 
 #undef RECORD_MANAGER_T
 #undef DATA_STRUCTURE_T
+#undef COMBINER_T
 
 #endif
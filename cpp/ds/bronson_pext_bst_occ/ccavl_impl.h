@@ -30,7 +30,9 @@
 #ifndef CCAVL_H
 #define CCAVL_H
 
+#include <sched.h>
 #include "record_manager.h"
+#include "key_depth_latency.h"
 
 //#if  (INDEX_STRUCT == IDX_CCAVL_SPIN)
 //#define SPIN_LOCK
@@ -41,21 +43,23 @@
 //#error
 //#endif
 
-//#ifdef SPIN_LOCK
+// CCAVL_BLOCKING_LOCKS: threads that give up waiting for a rotation sleep
+// on the node's lock instead of spinning on it (for oversubscribed runs)
+#ifndef CCAVL_BLOCKING_LOCKS
 typedef pthread_spinlock_t ptlock_t;
 #define lock_size               sizeof(ptlock_t)
 #define mutex_init(lock)        pthread_spin_init(lock, PTHREAD_PROCESS_PRIVATE)
 #define mutex_destroy(lock)     pthread_spin_destroy(lock)
 #define mutex_lock(lock)        pthread_spin_lock(lock)
 #define mutex_unlock(lock)      pthread_spin_unlock(lock)
-//#else
-//typedef pthread_mutex_t ptlock_t;
-//#define lock_size               sizeof(ptlock_t)
-//#define mutex_init(lock)        pthread_mutex_init(lock, NULL)
-//#define mutex_destroy(lock)     pthread_mutex_destroy(lock)
-//#define mutex_lock(lock)        pthread_mutex_lock(lock)
-//#define mutex_unlock(lock)      pthread_mutex_unlock(lock)
-//#endif
+#else
+typedef pthread_mutex_t ptlock_t;
+#define lock_size               sizeof(ptlock_t)
+#define mutex_init(lock)        pthread_mutex_init(lock, NULL)
+#define mutex_destroy(lock)     pthread_mutex_destroy(lock)
+#define mutex_lock(lock)        pthread_mutex_lock(lock)
+#define mutex_unlock(lock)      pthread_mutex_unlock(lock)
+#endif
 
 #define lock_mb() asm volatile("":::"memory")
 
@@ -115,12 +119,15 @@ static void * SpecialNull = (void *) &t_SpecialNull; // this hack implies sval_t
 static void * t_SpecialRetry;
 static void * SpecialRetry = (void *) &t_SpecialRetry; // this hack implies sval_t must be a pointer!
 
-/** The number of spins before yielding. */
-#define SPIN_COUNT 100
+/** The number of spins before yielding (negative: spin until the change completes). */
+#define SPIN_COUNT -1
 
 /** The number of yields before blocking. */
 #define YIELD_COUNT 0
 
+/** Bound on the length of a reader's walk past a changing node. */
+#define BYPASS_MAX_DEPTH 128
+
 // we encode directions as characters
 #define LEFT 'L'
 #define RIGHT 'R'
@@ -160,6 +167,11 @@ private:
     int init[MAX_THREADS_POW2] = {0,};
 //    PAD;
 
+    // how to deal with a node that is being rotated (see waitUntilChangeCompleted)
+    const int spinCount;
+    const int yieldCount;
+    const bool readerBypass;
+
     node_t<skey_t, sval_t> * rb_alloc(const int tid);
     node_t<skey_t, sval_t>* rbnode_create(const int tid, skey_t key, sval_t value, node_t<skey_t, sval_t>* parent);
     sval_t get(const int tid, node_t<skey_t, sval_t>* tree, skey_t key);
@@ -183,7 +195,8 @@ private:
             sval_t newValue,
             node_t<skey_t, sval_t>* parent,
             node_t<skey_t, sval_t>* curr,
-            version_t nodeOVL);
+            version_t nodeOVL,
+            int depth);
     sval_t update(const int tid, node_t<skey_t, sval_t>* tree, skey_t key, int func, sval_t expected, sval_t newValue);
     node_t<skey_t, sval_t>* rebalance_nl(const int tid, node_t<skey_t, sval_t>* nParent, node_t<skey_t, sval_t>* n);
     void fixHeightAndRebalance(const int tid, node_t<skey_t, sval_t>* curr);
@@ -191,6 +204,7 @@ private:
     node_t<skey_t, sval_t>* get_child(node_t<skey_t, sval_t>* curr, char dir);
     void setChild(node_t<skey_t, sval_t>* curr, char dir, node_t<skey_t, sval_t>* new_node);
     void waitUntilChangeCompleted(node_t<skey_t, sval_t>* curr, version_t ovl);
+    sval_t bypassGet(skey_t key, node_t<skey_t, sval_t>* curr);
     int height(volatile node_t<skey_t, sval_t>* curr);
     sval_t decodeNull(sval_t v);
     sval_t encodeNull(sval_t v);
@@ -198,7 +212,8 @@ private:
     sval_t attemptGet(skey_t key,
         node_t<skey_t, sval_t>* curr,
         char dirToC,
-        version_t nodeOVL);
+        version_t nodeOVL,
+        int depth); // (of curr, the root has depth 0; for KEY_DEPTH_LATENCY_STAT)
 
     int shouldUpdate(int func, sval_t prev, sval_t expected);
     int nodeCondition(node_t<skey_t, sval_t>* curr);
@@ -217,8 +232,12 @@ public:
     skey_t KEY_NEG_INFTY;
     PAD;
 
-    ccavl(const int numProcesses, const skey_t& _KEY_NEG_INFTY)
+    ccavl(const int numProcesses, const skey_t& _KEY_NEG_INFTY,
+          const int _spinCount = SPIN_COUNT, const int _yieldCount = YIELD_COUNT, const bool _readerBypass = false)
     : recmgr(new RecMgr(numProcesses, SIGQUIT))
+    , spinCount(_spinCount)
+    , yieldCount(_yieldCount)
+    , readerBypass(_readerBypass)
     , NUM_PROCESSES(numProcesses)
     , KEY_NEG_INFTY(_KEY_NEG_INFTY) {
         const int tid = 0;
@@ -470,6 +489,13 @@ void ccavl<skey_t, sval_t, RecMgr>::setChild(node_t<skey_t, sval_t>* curr, char
 
 //////// per-node blocking
 
+/**
+ * By default we spin until the change completes, which is fastest when every
+ * thread has its own core. When threads are oversubscribed, a descheduled
+ * rotating thread would stall every spinning waiter, so spinCount and
+ * yieldCount bound the spinning and yielding, after which we wait on the
+ * node's lock (held for the whole rotation).
+ */
 template <typename skey_t, typename sval_t, class RecMgr>
 void ccavl<skey_t, sval_t, RecMgr>::waitUntilChangeCompleted(node_t<skey_t, sval_t>* curr, version_t ovl) {
     int tries;
@@ -478,7 +504,14 @@ void ccavl<skey_t, sval_t, RecMgr>::waitUntilChangeCompleted(node_t<skey_t, sval
         return;
     }
 
-    for (tries = 0; tries < SPIN_COUNT; /*++tries*/) {
+    for (tries = 0; spinCount < 0 || tries < spinCount; ++tries) {
+        if (curr->changeOVL != ovl) {
+            return;
+        }
+    }
+
+    for (tries = 0; tries < yieldCount; ++tries) {
+        sched_yield();
         if (curr->changeOVL != ovl) {
             return;
         }
@@ -492,6 +525,25 @@ void ccavl<skey_t, sval_t, RecMgr>::waitUntilChangeCompleted(node_t<skey_t, sval
     assert(curr->changeOVL != ovl);
 }
 
+/**
+ * Lets a reader get past a node that is being rotated without waiting.
+ * A node with the key and a non-null value proves the key was present when
+ * the value was read, however we got there (removal nulls the value before
+ * unlinking). Anything else proves nothing while the rotation is in progress,
+ * so we return SpecialRetry and the caller waits as usual.
+ */
+template <typename skey_t, typename sval_t, class RecMgr>
+sval_t ccavl<skey_t, sval_t, RecMgr>::bypassGet(skey_t key, node_t<skey_t, sval_t>* curr) {
+    for (int depth = 0; curr != NULL && depth < BYPASS_MAX_DEPTH; ++depth) {
+        if (key == curr->key) {
+            sval_t vo = curr->value;
+            return vo != NULL ? vo : (sval_t) SpecialRetry;
+        }
+        curr = key < curr->key ? curr->left : curr->right;
+    }
+    return (sval_t) SpecialRetry;
+}
+
 //////// node access functions
 
 template <typename skey_t, typename sval_t, class RecMgr>
@@ -521,11 +573,13 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::getImpl(node_t<skey_t, sval_t>* tree, skey
     //long rightCmp;
     sval_t vo;
 
+    KEY_DEPTH_LATENCY_BEGIN();
     while (1) {
         right = (node_t<skey_t, sval_t>*) tree->right;
         if (right == NULL) {
             return NULL;
         } else {
+            KEY_DEPTH_LATENCY_TOUCH_AT(right, 0);
             //rightCmp = key - right->key;
 
             if (key == right->key) {
@@ -535,11 +589,14 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::getImpl(node_t<skey_t, sval_t>* tree, skey
 
             ovl = right->changeOVL;
             if (isShrinkingOrUnlinked(ovl)) {
+                if (readerBypass && (vo = bypassGet(key, right)) != SpecialRetry) {
+                    return vo;
+                }
                 waitUntilChangeCompleted(right, ovl);
                 // RETRY
             } else if (right == tree->right) {
                 // the reread of .right is the one protected by our read of ovl
-                vo = attemptGet(key, right, (key < right->key ? LEFT : RIGHT), ovl);
+                vo = attemptGet(key, right, (key < right->key ? LEFT : RIGHT), ovl, 0);
                 if (vo != SpecialRetry) {
                     return vo;
                 }
@@ -563,7 +620,8 @@ template <typename skey_t, typename sval_t, class RecMgr>
 sval_t ccavl<skey_t, sval_t, RecMgr>::attemptGet(skey_t key,
         node_t<skey_t, sval_t>* curr,
         char dirToC,
-        version_t nodeOVL) {
+        version_t nodeOVL,
+        int depth) {
     node_t<skey_t, sval_t>* child;
     //long childCmp;
     version_t childOVL;
@@ -582,6 +640,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptGet(skey_t key,
             // shrinks.
             return NULL;
         } else {
+            KEY_DEPTH_LATENCY_TOUCH_AT(child, depth + 1);
             //childCmp = key - child->key;
             if (key == child->key) {
                 // how we got here is irrelevant
@@ -591,6 +650,9 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptGet(skey_t key,
             // child is non-null
             childOVL = child->changeOVL;
             if (isShrinkingOrUnlinked(childOVL)) {
+                if (readerBypass && (vo = bypassGet(key, child)) != SpecialRetry) {
+                    return vo;
+                }
                 waitUntilChangeCompleted(child, childOVL);
 
                 if (hasShrunkOrUnlinked(nodeOVL, curr->changeOVL)) {
@@ -615,7 +677,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptGet(skey_t key,
                 // traversals were definitely okay.  This means that we are
                 // no longer vulnerable to node shrinks, and we don't need
                 // to validate nodeOVL any more.
-                vo = attemptGet(key, child, (key < child->key ? LEFT : RIGHT), childOVL);
+                vo = attemptGet(key, child, (key < child->key ? LEFT : RIGHT), childOVL, depth + 1);
                 if (vo != (sval_t) SpecialRetry) {
                     return vo;
                 }
@@ -685,7 +747,8 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptUpdate(
         sval_t newValue,
         node_t<skey_t, sval_t>* parent,
         node_t<skey_t, sval_t>* curr,
-        version_t nodeOVL) {
+        version_t nodeOVL,
+        int depth) {
     // As the search progresses there is an implicit min and max assumed for the
     // branch of the tree rooted at node. A left rotation of a node x results in
     // the range of keys in the right branch of x being reduced, so if we are at a
@@ -768,6 +831,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptUpdate(
             }
         } else {
             // non-null child
+            KEY_DEPTH_LATENCY_TOUCH_AT(child, depth + 1);
             version_t childOVL = child->changeOVL;
             if (isShrinkingOrUnlinked(childOVL)) {
                 waitUntilChangeCompleted(child, childOVL);
@@ -790,7 +854,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptUpdate(
                 // no longer vulnerable to node shrinks, and we don't need
                 // to validate nodeOVL any more.
                 sval_t vo = attemptUpdate(tid, key, func,
-                        expected, newValue, curr, child, childOVL);
+                        expected, newValue, curr, child, childOVL, depth + 1);
                 if (vo != (sval_t) SpecialRetry) {
                     return vo;
                 }
@@ -803,6 +867,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::attemptUpdate(
 template <typename skey_t, typename sval_t, class RecMgr>
 sval_t ccavl<skey_t, sval_t, RecMgr>::update(const int tid, node_t<skey_t, sval_t>* tree, skey_t key, int func, sval_t expected, sval_t newValue) {
 
+    KEY_DEPTH_LATENCY_BEGIN();
     while (1) {
         node_t<skey_t, sval_t>* right = tree->right;
         if (right == NULL) {
@@ -815,6 +880,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::update(const int tid, node_t<skey_t, sval_
             }
             // else RETRY
         } else {
+            KEY_DEPTH_LATENCY_TOUCH_AT(right, 0);
             version_t ovl = right->changeOVL;
             if (isShrinkingOrUnlinked(ovl)) {
                 waitUntilChangeCompleted(right, ovl);
@@ -822,7 +888,7 @@ sval_t ccavl<skey_t, sval_t, RecMgr>::update(const int tid, node_t<skey_t, sval_
             } else if (right == tree->right) {
                 // this is the protected .right
                 sval_t vo = attemptUpdate(tid, key, func,
-                        expected, newValue, tree, right, ovl);
+                        expected, newValue, tree, right, ovl, 0);
                 if (vo != (sval_t) SpecialRetry) {
                     return vo;
                 }
@@ -0,0 +1,252 @@
+/**
+ * Flat-combining front-end for updates to hot keys.
+ *
+ * Keys hash to a fixed table of combining slots. An update first tries to
+ * lock its slot; the winner (the combiner) applies its own update and every
+ * update published in the slot meanwhile. Threads that find the slot locked
+ * publish their update and wait until a combiner has applied it, or until
+ * the slot becomes free and they can combine themselves.
+ *
+ * Updates in one batch that target the same key are collapsed: the combiner
+ * reads the current value once, computes the result of each update in
+ * publication order, and applies only the net change to the tree (at most one
+ * insert or erase). Updates that do not reach the tree this way are counted
+ * as eliminated. All updates go through the slots (finds do not), so the
+ * combiner is the only writer of its keys and the net change linearizes the
+ * whole batch.
+ */
+
+#ifndef BRONSON_HOT_KEY_COMBINER_H
+#define BRONSON_HOT_KEY_COMBINER_H
+
+#include <atomic>
+#include <sched.h>
+#include "plaf.h"
+
+#ifdef GSTATS_HANDLE_STATS
+#   ifndef __AND
+#      define __AND ,
+#   endif
+#   define GSTATS_HANDLE_STATS_BRONSON_COMBINING(gstats_handle_stat) \
+        gstats_handle_stat(LONG_LONG, num_combining_updates, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_combined_for_others, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_eliminated_updates, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_combiner_batches, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+
+    // define a variable for each stat above
+    GSTATS_HANDLE_STATS_BRONSON_COMBINING(__DECLARE_EXTERN_STAT_ID);
+#endif
+
+#ifndef HOT_KEY_COMBINING_SLOTS
+#define HOT_KEY_COMBINING_SLOTS 1024 // power of two
+#endif
+#ifndef HOT_KEY_COMBINING_RECORDS
+#define HOT_KEY_COMBINING_RECORDS 8 // publication records per slot
+#endif
+#ifndef HOT_KEY_COMBINING_SPIN_COUNT
+#define HOT_KEY_COMBINING_SPIN_COUNT 100 // spins before a waiter yields
+#endif
+
+template <typename K, typename V, class Tree>
+class hot_key_combiner {
+public:
+    enum UpdateType { INSERT_REPLACE, INSERT_IF_ABSENT, ERASE };
+
+private:
+    enum RecordState { EMPTY, CLAIMED, PENDING, DONE };
+
+    struct Record {
+        std::atomic<int> state;
+        UpdateType type;
+        K key;
+        V val;
+        V result;
+    };
+
+    struct Slot {
+        volatile char padding0[PREFETCH_SIZE_BYTES];
+        std::atomic<bool> locked;
+        Record records[HOT_KEY_COMBINING_RECORDS];
+        volatile char padding1[PREFETCH_SIZE_BYTES];
+    };
+
+    Tree * const tree;
+    const V NO_VALUE;
+    Slot * const slots;
+
+    static size_t slotOf(const K& key) {
+        // fibonacci hashing spreads consecutive keys over the slots
+        return ((uint64_t) key * 0x9E3779B97F4A7C15ULL) >> 32 & (HOT_KEY_COMBINING_SLOTS - 1);
+    }
+
+    bool tryLock(Slot * slot) {
+        return !slot->locked.load(std::memory_order_relaxed)
+            && !slot->locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock(Slot * slot) {
+        slot->locked.store(false, std::memory_order_release);
+    }
+
+    // sequential effect of one update on the value of its key
+    static V applyTo(V& current, const UpdateType type, const V& val, const V& noValue) {
+        V result = current;
+        switch (type) {
+            case INSERT_REPLACE: current = val; break;
+            case INSERT_IF_ABSENT: if (current == noValue) current = val; break;
+            case ERASE: current = noValue; break;
+        }
+        return result;
+    }
+
+    V applyToTree(const int tid, const UpdateType type, const K& key, const V& val) {
+        switch (type) {
+            case INSERT_REPLACE: return tree->insertReplace(tid, key, val);
+            case INSERT_IF_ABSENT: return tree->insertIfAbsent(tid, key, val);
+            default: return tree->erase(tid, key);
+        }
+    }
+
+    /**
+     * Apply own (if not NULL) and all pending records of the slot.
+     * Must hold the slot lock.
+     */
+    void combine(const int tid, Slot * slot, Record * own) {
+        Record * batch[HOT_KEY_COMBINING_RECORDS + 1];
+        bool handled[HOT_KEY_COMBINING_RECORDS + 1];
+        int batchSize = 0;
+        if (own) batch[batchSize++] = own;
+        for (int i = 0; i < HOT_KEY_COMBINING_RECORDS; ++i) {
+            if (slot->records[i].state.load(std::memory_order_acquire) == PENDING) {
+                batch[batchSize++] = &slot->records[i];
+            }
+        }
+        if (batchSize > 1) {
+            GSTATS_ADD(tid, num_combiner_batches, 1);
+            GSTATS_ADD(tid, num_combined_for_others, batchSize - 1);
+        }
+        for (int i = 0; i < batchSize; ++i) handled[i] = false;
+
+        for (int i = 0; i < batchSize; ++i) {
+            if (handled[i]) continue;
+            const K key = batch[i]->key;
+            int groupSize = 0;
+            for (int j = i; j < batchSize; ++j) {
+                if (batch[j]->key == key) ++groupSize;
+            }
+            if (groupSize == 1) {
+                batch[i]->result = applyToTree(tid, batch[i]->type, key, batch[i]->val);
+                handled[i] = true;
+                continue;
+            }
+
+            const V initial = tree->find(tid, key);
+            V current = initial;
+            for (int j = i; j < batchSize; ++j) {
+                if (batch[j]->key != key) continue;
+                batch[j]->result = applyTo(current, batch[j]->type, batch[j]->val, NO_VALUE);
+                handled[j] = true;
+            }
+            int treeUpdates = 0;
+            if (current != initial) {
+                treeUpdates = 1;
+                if (current == NO_VALUE) {
+                    tree->erase(tid, key);
+                } else if (initial == NO_VALUE) {
+                    tree->insertIfAbsent(tid, key, current);
+                } else {
+                    tree->insertReplace(tid, key, current);
+                }
+            }
+            GSTATS_ADD(tid, num_eliminated_updates, groupSize - treeUpdates);
+        }
+        for (int i = 0; i < batchSize; ++i) {
+            batch[i]->state.store(DONE, std::memory_order_release);
+        }
+    }
+
+public:
+    hot_key_combiner(Tree * const _tree, const V& noValue)
+    : tree(_tree)
+    , NO_VALUE(noValue)
+    , slots(new Slot[HOT_KEY_COMBINING_SLOTS]) {
+        static_assert((HOT_KEY_COMBINING_SLOTS & (HOT_KEY_COMBINING_SLOTS - 1)) == 0, "HOT_KEY_COMBINING_SLOTS must be a power of two");
+        for (int i = 0; i < HOT_KEY_COMBINING_SLOTS; ++i) {
+            slots[i].locked = false;
+            for (int j = 0; j < HOT_KEY_COMBINING_RECORDS; ++j) {
+                slots[i].records[j].state = EMPTY;
+            }
+        }
+    }
+
+    ~hot_key_combiner() {
+        delete[] slots;
+    }
+
+    V update(const int tid, const UpdateType type, const K& key, const V& val) {
+        GSTATS_ADD(tid, num_combining_updates, 1);
+        Slot * const slot = &slots[slotOf(key)];
+        Record * published = NULL;
+        while (true) {
+            if (tryLock(slot)) {
+                if (published == NULL) {
+                    Record own;
+                    own.type = type;
+                    own.key = key;
+                    own.val = val;
+                    combine(tid, slot, &own);
+                    unlock(slot);
+                    return own.result;
+                }
+                // our published record is applied by this pass unless a
+                // combiner finished it right before we got the lock
+                if (published->state.load(std::memory_order_acquire) != DONE) {
+                    combine(tid, slot, NULL);
+                }
+                unlock(slot);
+            }
+            if (published == NULL) {
+                for (int i = 0; i < HOT_KEY_COMBINING_RECORDS; ++i) {
+                    Record * record = &slot->records[i];
+                    int expected = EMPTY;
+                    if (record->state.load(std::memory_order_relaxed) == EMPTY
+                            && record->state.compare_exchange_strong(expected, CLAIMED)) {
+                        record->type = type;
+                        record->key = key;
+                        record->val = val;
+                        record->state.store(PENDING, std::memory_order_release);
+                        published = record;
+                        break;
+                    }
+                }
+                if (published == NULL) {
+                    sched_yield(); // all records busy: retry the lock later
+                    continue;
+                }
+            }
+            // wait for a combiner to apply our update, or for the lock to be free
+            for (int spins = 0; published->state.load(std::memory_order_acquire) != DONE && slot->locked.load(std::memory_order_relaxed); ++spins) {
+                if (spins >= HOT_KEY_COMBINING_SPIN_COUNT) {
+                    sched_yield(); // the combiner may be descheduled
+                    spins = 0;
+                }
+                SOFTWARE_BARRIER;
+            }
+            if (published->state.load(std::memory_order_acquire) == DONE) {
+                V result = published->result;
+                published->state.store(EMPTY, std::memory_order_release);
+                return result;
+            }
+        }
+    }
+};
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <iostream>
 #include "errors.h"
+#include "ds_parameters.h"
 #include "brown_ext_abtree_lf_impl.h"
 #ifdef USE_TREE_STATS
 #   define TREE_STATS_BYTES_AT_DEPTH
@@ -41,6 +42,12 @@ public:
         if (NUM_THREADS > MAX_THREADS_POW2) {
             setbench_error("NUM_THREADS exceeds MAX_THREADS_POW2");
         }
+        // levels of the tree replicated on every NUMA node (0 = no replication)
+        const int replicaLevels = ds_parameters::get<int>("abtree.replicaLevels", 0);
+        if (replicaLevels < 0) {
+            setbench_error("abtree.replicaLevels must be non-negative");
+        }
+        ds->setReplicaLevels(replicaLevels);
     }
     ~ds_adapter() {
         delete ds;
@@ -75,8 +82,20 @@ public:
     int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
         return ds->rangeQuery(tid, lo, hi, resultKeys, (void ** const) resultValues);
     }
+
+    #define DS_ADAPTER_SUPPORTS_RQ_AGGREGATE
+    #define DS_ADAPTER_SUPPORTS_RQ_VISIT
+    rq_aggregate<K> rangeQueryAggregate(const int tid, const K& lo, const K& hi) {
+        return ds->rangeQueryAggregate(tid, lo, hi);
+    }
+    template <class Visitor>
+    void rangeQueryVisit(const int tid, const K& lo, const K& hi, Visitor& visit) {
+        auto visitValue = [&visit](const K& key, void * const value) { visit(key, (V) value); };
+        ds->rangeQueryVisit(tid, lo, hi, visitValue);
+    }
     void printSummary() {
         ds->debugGetRecMgr()->printStatus();
+        ds->printReplicaSummary();
     }
     bool validateStructure() {
         return true;
@@ -51,6 +51,11 @@
 #include "record_manager.h"
 #include "prefetching.h"
 #include "scx_provider.h"
+#include "rq_aggregate.h"
+#include "key_depth_latency.h"
+#ifdef USE_LIBNUMA
+#   include "numa_tools.h"
+#endif
 
 namespace abtree_ns {
 
@@ -78,6 +83,7 @@ namespace abtree_ns {
         volatile int marked; // 0 or 1
         int weight; // 0 or 1
         int size; // degree of node
+        volatile int replicated; // 0 or 1: a replica of the top levels may lead searches to this node
         K searchKey;
         K keys[DEGREE];
         Node<DEGREE,K> * volatile ptrs[DEGREE];
@@ -111,6 +117,44 @@ namespace abtree_ns {
         }
     };
 
+    /**
+     * NUMA replication of the top levels (enabled by setReplicaLevels(k > 0)).
+     *
+     * Every NUMA node has its own replica of the internal nodes in the top k
+     * levels of the tree: copies of their keys, whose child pointers lead to
+     * other replica nodes, or (tagged with ABTREE_REPLICA_FRONTIER) to the real
+     * internal node where the search continues. Searches, inserts and deletes
+     * start from the node the replica of their NUMA node leads to, so the top
+     * levels are read from memory local to the node, and are not invalidated
+     * by updates on other sockets.
+     *
+     * A frontier node that is still in the tree (not marked) is a valid place
+     * to start: internal nodes are never changed in a way that changes the
+     * range of keys in their subtree, only replaced (and marked first). Real
+     * nodes that a replica points to are flagged as replicated, and retiring a
+     * replicated node increments replicaVersion, so replicas built before that
+     * are stale and never lead to a node that may have been freed. A stale
+     * replica is rebuilt by the first thread of its NUMA node that sees it,
+     * while the other threads of the node search from the root.
+     */
+    #define ABTREE_REPLICA_FRONTIER ((uintptr_t) 1)
+
+    struct abtree_replica_slot {
+        PAD;
+        void * volatile root;               // Node, or NULL
+        volatile int building;
+        volatile long long failedVersion;   // the tree was too small to replicate at this version
+        PAD;
+    };
+
+    struct abtree_replica_counters {
+        PAD;
+        long long hits;         // operations that started at a frontier node
+        long long fallbacks;    // operations that started at the root
+        long long rebuilds;
+        PAD;
+    };
+
     template <int DEGREE, typename K, class Compare, class RecManager>
     class abtree {
     private:
@@ -131,6 +175,14 @@ namespace abtree_ns {
 
         Node<DEGREE,K> * entry;
 
+        int replicaLevels;
+        int numReplicas;
+        abtree_replica_slot * replicas;
+        PAD;
+        volatile long long replicaVersion;
+        PAD;
+        abtree_replica_counters replicaCounters[MAX_THREADS_POW2];
+
         #define arraycopy(src, srcStart, dest, destStart, len) \
             for (int ___i=0;___i<(len);++___i) { \
                 (dest)[(destStart)+___i] = (src)[(srcStart)+___i]; \
@@ -153,6 +205,21 @@ namespace abtree_ns {
 
         Node<DEGREE,K>* allocateNode(const int tid);
 
+        inline void retireNode(const int tid, Node<DEGREE,K> * node) {
+            if (node->replicated) __sync_fetch_and_add(&replicaVersion, 1);
+            recordmgr->retire(tid, node);
+        }
+
+        // the real internal node the replica of this thread's NUMA node leads to for key, or NULL
+        Node<DEGREE,K> * replicaSearchStart(const int tid, const K& key);
+        void rebuildReplica(const int tid, const int r);
+        Node<DEGREE,K> * copyTopLevels(const int tid, Node<DEGREE,K> * node, const int depth, bool * ok);
+        void freeReplica(const int tid, Node<DEGREE,K> * node, const bool retire);
+
+        // calls handler(leaf, from, to) for every leaf whose keys[from..to-1] are the keys of the leaf in [lo, hi]
+        template <class LeafHandler>
+        void visitLeavesInRange(const int tid, Node<DEGREE,K> * node, const K& lo, const K& hi, LeafHandler& handler);
+
         void freeSubtree(Node<DEGREE,K>* node, int* nodes) {
             const int tid = 0;
             if (node == NULL) return;
@@ -202,6 +269,10 @@ public:
         , a(std::max(DEGREE/4, 2))
         , recordmgr(new RecManager(numProcesses, suspectedCrashSignal))
         , prov(new SCXProvider<Node<DEGREE,K>, MAX_NODE_DEPENDENCIES_PER_SCX>(numProcesses))
+        , replicaLevels(0)
+        , numReplicas(0)
+        , replicas(NULL)
+        , replicaVersion(0)
         , NO_VALUE((void *) -1LL)
         , NUM_PROCESSES(numProcesses)
         {
@@ -230,6 +301,10 @@ public:
 
     #ifdef ABTREE_ENABLE_DESTRUCTOR
         ~abtree() {
+            for (int r=0;r<numReplicas;++r) {
+                if (replicas[r].root) freeReplica(0, (Node<DEGREE,K> *) replicas[r].root, false);
+            }
+            delete[] replicas;
             int nodes = 0;
             freeSubtree(entry, &nodes);
 //            COUTATOMIC("main thread: deleted tree containing "<<nodes<<" nodes"<<std::endl);
@@ -241,6 +316,48 @@ public:
 
         Node<DEGREE,K> * debug_getEntryPoint() { return entry; }
 
+        /**
+         * Replicate the top levels levels of the tree on every NUMA node
+         * (one replica without libnuma). Must be called before any thread
+         * accesses the tree.
+         */
+        void setReplicaLevels(const int levels) {
+            replicaLevels = levels;
+            if (levels <= 0) return;
+#ifdef USE_LIBNUMA
+            numReplicas = __numa.get_num_nodes();
+#else
+            numReplicas = 1;
+#endif
+            replicas = new abtree_replica_slot[numReplicas];
+            for (int r=0;r<numReplicas;++r) {
+                replicas[r].root = NULL;
+                replicas[r].building = 0;
+                replicas[r].failedVersion = -1;
+            }
+            for (int tid=0;tid<MAX_THREADS_POW2;++tid) {
+                replicaCounters[tid].hits = 0;
+                replicaCounters[tid].fallbacks = 0;
+                replicaCounters[tid].rebuilds = 0;
+            }
+        }
+        int getReplicaLevels() { return replicaLevels; }
+        void printReplicaSummary() {
+            if (replicaLevels <= 0) return;
+            long long hits = 0, fallbacks = 0, rebuilds = 0;
+            for (int tid=0;tid<MAX_THREADS_POW2;++tid) {
+                hits += replicaCounters[tid].hits;
+                fallbacks += replicaCounters[tid].fallbacks;
+                rebuilds += replicaCounters[tid].rebuilds;
+            }
+            std::cout<<"abtree_replica_levels="<<replicaLevels<<std::endl;
+            std::cout<<"abtree_replicas="<<numReplicas<<std::endl;
+            std::cout<<"abtree_replica_hits="<<hits<<std::endl;
+            std::cout<<"abtree_replica_fallbacks="<<fallbacks<<std::endl;
+            std::cout<<"abtree_replica_rebuilds="<<rebuilds<<std::endl;
+            std::cout<<"abtree_replica_version="<<replicaVersion<<std::endl;
+        }
+
     public:
         /*******************************************************************
          * Utility functions for integration with the test harness
@@ -401,6 +518,10 @@ public:
         const std::pair<void*,bool> find(const int tid, const K& key);
         bool contains(const int tid, const K& key);
         int rangeQuery(const int tid, const K& low, const K& hi, K * const resultKeys, void ** const resultValues);
+        // not linearizable: the traversal sees each leaf as of the time it reaches it
+        template <class Visitor>
+        void rangeQueryVisit(const int tid, const K& lo, const K& hi, Visitor& visit);
+        rq_aggregate<K> rangeQueryAggregate(const int tid, const K& lo, const K& hi);
         bool validate(const long long keysum, const bool checkkeysum) {
             if (checkkeysum) {
                 long long treekeysum = getSumOfKeys();
@@ -443,20 +564,156 @@ abtree_ns::Node<DEGREE,K> * abtree_ns::abtree<DEGREE,K,Compare,RecManager>::allo
         exit(-1);
     }
     prov->initNode(newnode);
+    newnode->replicated = 0;
 // #ifdef GSTATS_HANDLE_STATS
 //     GSTATS_APPEND(tid, node_allocated_addresses, ((long long) newnode)%(1<<12));
 // #endif
     return newnode;
 }
 
+template <int DEGREE, typename K, class Compare, class RecManager>
+abtree_ns::Node<DEGREE,K> * abtree_ns::abtree<DEGREE,K,Compare,RecManager>::replicaSearchStart(const int tid, const K& key) {
+    if (replicaLevels <= 0) return NULL;
+#ifdef USE_LIBNUMA
+    const int r = __numa.get_node_periodic() % numReplicas;
+#else
+    const int r = 0;
+#endif
+    Node<DEGREE,K> * n = (Node<DEGREE,K> *) replicas[r].root;
+    if (n == NULL || (long long) n->scxPtr != replicaVersion) {
+        if (!replicas[r].building && replicas[r].failedVersion != replicaVersion
+                && __sync_bool_compare_and_swap(&replicas[r].building, 0, 1)) {
+            rebuildReplica(tid, r);
+            replicas[r].building = 0;
+        }
+        ++replicaCounters[tid].fallbacks;
+        return NULL;
+    }
+    while (true) {
+        KEY_DEPTH_LATENCY_TOUCH(n);
+        const uintptr_t child = (uintptr_t) n->ptrs[n->getChildIndex(key, cmp)];
+        if (child & ABTREE_REPLICA_FRONTIER) {
+            Node<DEGREE,K> * const frontier = (Node<DEGREE,K> *) (child & ~ABTREE_REPLICA_FRONTIER);
+            if (frontier->marked) {
+                // removed from the tree, and will be retired (making the replica stale)
+                ++replicaCounters[tid].fallbacks;
+                return NULL;
+            }
+            ++replicaCounters[tid].hits;
+            return frontier;
+        }
+        n = (Node<DEGREE,K> *) child;
+    }
+}
+
+/**
+ * Returns a copy of the subtree of node down to depth replicaLevels, or node
+ * tagged with ABTREE_REPLICA_FRONTIER if node is at that depth or has a leaf
+ * child or grandchild. (Leaves are not marked when they are removed, so they
+ * cannot be validated, and stopping above the parents of leaves means that an
+ * update that starts at a frontier node always passes through a real
+ * grandparent of its leaf.) Sets *ok to false if a node that was removed from
+ * the tree is encountered.
+ */
+template <int DEGREE, typename K, class Compare, class RecManager>
+abtree_ns::Node<DEGREE,K> * abtree_ns::abtree<DEGREE,K,Compare,RecManager>::copyTopLevels(const int tid, Node<DEGREE,K> * node, const int depth, bool * ok) {
+    // flag the node before checking that it is still in the tree, so either
+    // we see it marked, or whoever retires it sees the flag and bumps the version
+    node->replicated = 1;
+    __sync_synchronize();
+    if (node->marked) {
+        *ok = false;
+        return NULL;
+    }
+    bool frontier = (depth == replicaLevels);
+    Node<DEGREE,K> * children[DEGREE];
+    const int size = node->getABDegree();
+    for (int i=0;i<size;++i) {
+        children[i] = node->ptrs[i];
+        if (children[i]->isLeaf()) {
+            frontier = true;
+            continue;
+        }
+        for (int j=0;j<children[i]->getABDegree();++j) {
+            if (children[i]->ptrs[j]->isLeaf()) frontier = true;
+        }
+    }
+    if (frontier) return (Node<DEGREE,K> *) ((uintptr_t) node | ABTREE_REPLICA_FRONTIER);
+
+    Node<DEGREE,K> * copy = allocateNode(tid);
+    copy->leaf = false;
+    copy->weight = node->weight;
+    copy->size = size;
+    copy->searchKey = node->searchKey;
+    for (int i=0;i<size;++i) {
+        copy->ptrs[i] = NULL;
+    }
+    arraycopy(node->keys, 0, copy->keys, 0, node->getKeyCount());
+    for (int i=0;i<size && *ok;++i) {
+        copy->ptrs[i] = copyTopLevels(tid, children[i], depth+1, ok);
+    }
+    if (!*ok) {
+        freeReplica(tid, copy, false);
+        return NULL;
+    }
+    return copy;
+}
+
+template <int DEGREE, typename K, class Compare, class RecManager>
+void abtree_ns::abtree<DEGREE,K,Compare,RecManager>::freeReplica(const int tid, Node<DEGREE,K> * node, const bool retire) {
+    if (node == NULL || ((uintptr_t) node & ABTREE_REPLICA_FRONTIER)) return;
+    for (int i=0;i<node->getABDegree();++i) {
+        freeReplica(tid, node->ptrs[i], retire);
+    }
+    if (retire) {
+        recordmgr->retire(tid, node);
+    } else {
+        recordmgr->deallocate(tid, node);
+    }
+}
+
+template <int DEGREE, typename K, class Compare, class RecManager>
+void abtree_ns::abtree<DEGREE,K,Compare,RecManager>::rebuildReplica(const int tid, const int r) {
+    ++replicaCounters[tid].rebuilds;
+    const long long version = replicaVersion;
+    bool ok = true;
+    Node<DEGREE,K> * root = entry->ptrs[0];
+    if (root->isLeaf()) {
+        // too small to replicate until the root is replaced (flagged, so that bumps the version)
+        root->replicated = 1;
+        __sync_synchronize();
+        if (entry->ptrs[0] == root) replicas[r].failedVersion = version;
+        return;
+    }
+    Node<DEGREE,K> * copy = copyTopLevels(tid, root, 0, &ok);
+    if (!ok) return; // changed while it was copied
+    if ((uintptr_t) copy & ABTREE_REPLICA_FRONTIER) {
+        // the root has a leaf child or grandchild: search from the root until the (flagged) root is replaced
+        replicas[r].failedVersion = version;
+        return;
+    }
+    copy->scxPtr = (scx_handle_t) version; // (replica nodes are never passed to LLX/SCX)
+    Node<DEGREE,K> * old = (Node<DEGREE,K> *) replicas[r].root;
+    SOFTWARE_BARRIER;
+    replicas[r].root = copy;
+    freeReplica(tid, old, true);
+}
+
 template <int DEGREE, typename K, class Compare, class RecManager>
 const std::pair<void*,bool> abtree_ns::abtree<DEGREE,K,Compare,RecManager>::find(const int tid, const K& key) {
     std::pair<void*,bool> result;
     auto guard = recordmgr->getGuard(tid, true);
-    Node<DEGREE,K> * l = entry->ptrs[0];
+    KEY_DEPTH_LATENCY_BEGIN();
+    Node<DEGREE,K> * l = replicaSearchStart(tid, key);
+    if (l == NULL) {
+        KEY_DEPTH_LATENCY_RESTART();
+        l = entry->ptrs[0];
+    }
+    KEY_DEPTH_LATENCY_TOUCH(l);
     while (!l->isLeaf()) {
         int ix = l->getChildIndex(key, cmp);
         l = l->ptrs[ix];
+        KEY_DEPTH_LATENCY_TOUCH(l);
     }
     int index = l->getKeyIndex(key, cmp);
     if (index < l->getKeyCount() && l->keys[index] == key) {
@@ -479,9 +736,54 @@ int abtree_ns::abtree<DEGREE,K,Compare,RecManager>::rangeQuery(const int tid, co
     setbench_error("not implemented");
 }
 
+template <int DEGREE, typename K, class Compare, class RecManager>
+template <class LeafHandler>
+void abtree_ns::abtree<DEGREE,K,Compare,RecManager>::visitLeavesInRange(const int tid, Node<DEGREE,K> * node, const K& lo, const K& hi, LeafHandler& handler) {
+    if (node->isLeaf()) {
+        // leaves are immutable, and their keys are sorted
+        const int nkeys = node->getKeyCount();
+        const int from = node->getKeyIndex(lo, cmp);
+        int to = from;
+        while (to < nkeys && !cmp(hi, (const K&) node->keys[to])) {
+            ++to;
+        }
+        if (from < to) handler(node, from, to);
+        return;
+    }
+    const int first = node->getChildIndex(lo, cmp);
+    const int last = node->getChildIndex(hi, cmp);
+    for (int i=first;i<=last;++i) {
+        visitLeavesInRange(tid, node->ptrs[i], lo, hi, handler);
+    }
+}
+
+template <int DEGREE, typename K, class Compare, class RecManager>
+template <class Visitor>
+void abtree_ns::abtree<DEGREE,K,Compare,RecManager>::rangeQueryVisit(const int tid, const K& lo, const K& hi, Visitor& visit) {
+    auto guard = recordmgr->getGuard(tid, true);
+    auto handler = [&visit](Node<DEGREE,K> * leaf, const int from, const int to) {
+        for (int i=from;i<to;++i) {
+            visit((const K&) leaf->keys[i], (void *) leaf->ptrs[i]);
+        }
+    };
+    visitLeavesInRange(tid, entry->ptrs[0], lo, hi, handler);
+}
+
+template <int DEGREE, typename K, class Compare, class RecManager>
+rq_aggregate<K> abtree_ns::abtree<DEGREE,K,Compare,RecManager>::rangeQueryAggregate(const int tid, const K& lo, const K& hi) {
+    rq_aggregate<K> result;
+    auto guard = recordmgr->getGuard(tid, true);
+    auto handler = [&result](Node<DEGREE,K> * leaf, const int from, const int to) {
+        result.addSorted((const K *) &leaf->keys[from], to - from);
+    };
+    visitLeavesInRange(tid, entry->ptrs[0], lo, hi, handler);
+    return result;
+}
+
 
 template <int DEGREE, typename K, class Compare, class RecManager>
 void* abtree_ns::abtree<DEGREE,K,Compare,RecManager>::doInsert(const int tid, const K& key, void * const value, const bool replace) {
+    KEY_DEPTH_LATENCY_BEGIN();
     while (true) {
         /**
          * search
@@ -489,16 +791,23 @@ void* abtree_ns::abtree<DEGREE,K,Compare,RecManager>::doInsert(const int tid, co
         auto guard = recordmgr->getGuard(tid);
         Node<DEGREE,K> * gp = NULL;
         Node<DEGREE,K> * p = entry;
-        Node<DEGREE,K> * l = p->ptrs[0];
+        Node<DEGREE,K> * l = replicaSearchStart(tid, key);
+        if (l == NULL) {
+            KEY_DEPTH_LATENCY_RESTART();
+            l = p->ptrs[0];
+        }
         int ixToP = -1;
         int ixToL = 0;
+        KEY_DEPTH_LATENCY_TOUCH(l);
         while (!l->isLeaf()) {
             ixToP = ixToL;
             ixToL = l->getChildIndex(key, cmp);
             gp = p;
             p = l;
             l = l->ptrs[ixToL];
+            KEY_DEPTH_LATENCY_TOUCH(l);
         }
+        KEY_DEPTH_LATENCY_END(); // (the searches of the retries are not profiled)
 
         /**
          * do the update
@@ -534,7 +843,7 @@ void* abtree_ns::abtree<DEGREE,K,Compare,RecManager>::doInsert(const int tid, co
             n->weight = true;
 
             if (prov->scxExecute(tid, (void * volatile *) &p->ptrs[ixToL], l, n)) {
-                this->recordmgr->retire(tid, l);
+                retireNode(tid, l);
                 fixDegreeViolation(tid, n);
                 return oldValue;
             }
@@ -574,7 +883,7 @@ void* abtree_ns::abtree<DEGREE,K,Compare,RecManager>::doInsert(const int tid, co
                 n->weight = l->weight;
 
                 if (prov->scxExecute(tid, (void * volatile *) &p->ptrs[ixToL], l, n)) {
-                    recordmgr->retire(tid, l);
+                    retireNode(tid, l);
                     fixDegreeViolation(tid, n);
                     return NO_VALUE;
                 }
@@ -637,7 +946,7 @@ void* abtree_ns::abtree<DEGREE,K,Compare,RecManager>::doInsert(const int tid, co
                 //       if n will become the root
 
                 if (prov->scxExecute(tid, (void * volatile *) &p->ptrs[ixToL], l, n)) {
-                    recordmgr->retire(tid, l);
+                    retireNode(tid, l);
                     // after overflow, there may be a weight violation at n
                     fixWeightViolation(tid, n);
                     return NO_VALUE;
@@ -653,6 +962,7 @@ void* abtree_ns::abtree<DEGREE,K,Compare,RecManager>::doInsert(const int tid, co
 
 template <int DEGREE, typename K, class Compare, class RecManager>
 const std::pair<void*,bool> abtree_ns::abtree<DEGREE,K,Compare,RecManager>::erase(const int tid, const K& key) {
+    KEY_DEPTH_LATENCY_BEGIN();
     while (true) {
         /**
          * search
@@ -660,16 +970,23 @@ const std::pair<void*,bool> abtree_ns::abtree<DEGREE,K,Compare,RecManager>::eras
         auto guard = recordmgr->getGuard(tid);
         Node<DEGREE,K> * gp = NULL;
         Node<DEGREE,K> * p = entry;
-        Node<DEGREE,K> * l = p->ptrs[0];
+        Node<DEGREE,K> * l = replicaSearchStart(tid, key);
+        if (l == NULL) {
+            KEY_DEPTH_LATENCY_RESTART();
+            l = p->ptrs[0];
+        }
         int ixToP = -1;
         int ixToL = 0;
+        KEY_DEPTH_LATENCY_TOUCH(l);
         while (!l->isLeaf()) {
             ixToP = ixToL;
             ixToL = l->getChildIndex(key, cmp);
             gp = p;
             p = l;
             l = l->ptrs[ixToL];
+            KEY_DEPTH_LATENCY_TOUCH(l);
         }
+        KEY_DEPTH_LATENCY_END(); // (the searches of the retries are not profiled)
 
         /**
          * do the update
@@ -707,7 +1024,7 @@ const std::pair<void*,bool> abtree_ns::abtree<DEGREE,K,Compare,RecManager>::eras
 
             void* oldValue = l->ptrs[keyIndex];
             if (prov->scxExecute(tid, (void * volatile *) &p->ptrs[ixToL], l, n)) {
-                recordmgr->retire(tid, l);
+                retireNode(tid, l);
                 /**
                  * Compress may be needed at p after removing key from l.
                  */
@@ -816,8 +1133,8 @@ bool abtree_ns::abtree<DEGREE,K,Compare,RecManager>::fixWeightViolation(const in
             n->weight = true;
 
             if (prov->scxExecute(tid, (void * volatile *) &gp->ptrs[ixToP], p, n)) {
-                recordmgr->retire(tid, p);
-                recordmgr->retire(tid, l);
+                retireNode(tid, p);
+                retireNode(tid, l);
                 /**
                  * Compress may be needed at the new internal node we created
                  * (since we move grandchildren from two parents together).
@@ -886,8 +1203,8 @@ bool abtree_ns::abtree<DEGREE,K,Compare,RecManager>::fixWeightViolation(const in
             //       if n will become the root
 
             if (prov->scxExecute(tid, (void * volatile *) &gp->ptrs[ixToP], p, n)) {
-                recordmgr->retire(tid, p);
-                recordmgr->retire(tid, l);
+                retireNode(tid, p);
+                retireNode(tid, l);
 
                 fixWeightViolation(tid, n);
                 fixDegreeViolation(tid, n);
@@ -1060,9 +1377,9 @@ bool abtree_ns::abtree<DEGREE,K,Compare,RecManager>::fixDegreeViolation(const in
             // if appropriate, we perform RootAbsorb at the same time.
             if (gp == entry && p->getABDegree() == 2) {
                 if (prov->scxExecute(tid, (void * volatile *) &gp->ptrs[ixToP], p, newl)) {
-                    recordmgr->retire(tid, p);
-                    recordmgr->retire(tid, l);
-                    recordmgr->retire(tid, s);
+                    retireNode(tid, p);
+                    retireNode(tid, l);
+                    retireNode(tid, s);
 
                     fixDegreeViolation(tid, newl);
                     return true;
@@ -1096,9 +1413,9 @@ bool abtree_ns::abtree<DEGREE,K,Compare,RecManager>::fixDegreeViolation(const in
                 n->weight = true;
 
                 if (prov->scxExecute(tid, (void * volatile *) &gp->ptrs[ixToP], p, n)) {
-                    recordmgr->retire(tid, p);
-                    recordmgr->retire(tid, l);
-                    recordmgr->retire(tid, s);
+                    retireNode(tid, p);
+                    retireNode(tid, l);
+                    retireNode(tid, s);
 
                     fixDegreeViolation(tid, newl);
                     fixDegreeViolation(tid, n);
@@ -1200,9 +1517,9 @@ bool abtree_ns::abtree<DEGREE,K,Compare,RecManager>::fixDegreeViolation(const in
             n->weight = true;
 
             if (prov->scxExecute(tid, (void * volatile *) &gp->ptrs[ixToP], p, n)) {
-                recordmgr->retire(tid, p);
-                recordmgr->retire(tid, l);
-                recordmgr->retire(tid, s);
+                retireNode(tid, p);
+                retireNode(tid, l);
+                retireNode(tid, s);
 
                 fixDegreeViolation(tid, n);
                 return true;
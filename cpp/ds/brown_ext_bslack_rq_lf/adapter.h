@@ -76,6 +76,20 @@ public:
     int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
         return ds->rangeQuery(tid, lo, hi, resultKeys, (void ** const) resultValues);
     }
+#ifdef RQ_LOCKFREE
+    // streaming snapshots (see bslack::snapshotBegin)
+    #define DS_ADAPTER_SUPPORTS_RQ_SNAPSHOT
+    typedef typename DATA_STRUCTURE_T::SnapshotCursor SnapshotCursor;
+    long long snapshotBegin(const int tid, const K& lo, const K& hi, SnapshotCursor * const cursor) {
+        return ds->snapshotBegin(tid, lo, hi, cursor);
+    }
+    int snapshotNext(const int tid, SnapshotCursor * const cursor, K * const resultKeys, V * const resultValues, const int capacity) {
+        return ds->snapshotNext(tid, cursor, resultKeys, (void ** const) resultValues, capacity);
+    }
+    void snapshotEnd(const int tid, SnapshotCursor * const cursor) {
+        ds->snapshotEnd(tid, cursor);
+    }
+#endif
     void printSummary() {
         ds->debugGetRecMgr()->printStatus();
     }
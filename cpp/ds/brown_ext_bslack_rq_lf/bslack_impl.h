@@ -156,7 +156,7 @@ namespace bslack_ns {
         int weight; // 0 or 1
         int size; // degree of node
         K searchKey;
-#if defined(RQ_LOCKFREE) || defined(RQ_RWLOCK) || defined(HTM_RQ_RWLOCK)
+#if defined(RQ_LOCKFREE) || defined(RQ_RWLOCK) || defined(RQ_HTM_RWLOCK)
         volatile long long itime; // for use by range query algorithm
         volatile long long dtime; // for use by range query algorithm
 #endif
@@ -789,6 +789,19 @@ public:
         const std::pair<void*,bool> find(const int tid, const K& key);
         bool contains(const int tid, const K& key);
         int rangeQuery(const int tid, const K& low, const K& hi, K * const resultKeys, void ** const resultValues);
+#ifdef RQ_LOCKFREE
+        /**
+         * Streaming snapshot of the keys in [lo, hi] (see STREAMING SNAPSHOTS in rq_dcssp.h).
+         * snapshotNext copies the next (at most capacity) keys of the snapshot into
+         * resultKeys/resultValues and returns how many, or 0 once the snapshot is
+         * exhausted. The thread stays in one operation of the record manager from
+         * snapshotBegin to snapshotEnd, so a long scan delays reclamation.
+         */
+        typedef rq_snapshot_cursor<K, Node<DEGREE,K>> SnapshotCursor;
+        long long snapshotBegin(const int tid, const K& lo, const K& hi, SnapshotCursor * const cursor);
+        int snapshotNext(const int tid, SnapshotCursor * const cursor, K * const resultKeys, void ** const resultValues, const int capacity);
+        void snapshotEnd(const int tid, SnapshotCursor * const cursor);
+#endif
         bool validate(const long long keysum, const bool checkkeysum) {
             if (checkkeysum) {
                 long long treekeysum = getSumOfKeys();
@@ -990,6 +1003,71 @@ int bslack_ns::bslack<DEGREE,K,Compare,RecManager>::rangeQuery(const int tid, co
     return size;
 }
 
+#ifdef RQ_LOCKFREE
+template<int DEGREE, typename K, class Compare, class RecManager>
+long long bslack_ns::bslack<DEGREE,K,Compare,RecManager>::snapshotBegin(const int tid, const K& lo, const K& hi, SnapshotCursor * const cursor) {
+    recordmgr->startOp(tid);
+    cursor->hi = hi;
+    cursor->startWindow(lo, entry);
+    return rqProvider->snapshot_start(tid);
+}
+
+template<int DEGREE, typename K, class Compare, class RecManager>
+int bslack_ns::bslack<DEGREE,K,Compare,RecManager>::snapshotNext(const int tid, SnapshotCursor * const cursor, K * const resultKeys, void ** const resultValues, const int capacity) {
+    int size = 0;
+    while (size < capacity) {
+        // hand out the keys of the last visited node first
+        if (rqProvider->snapshot_has_pending(tid)) {
+            int cnt = rqProvider->snapshot_emit(tid, resultKeys+size, resultValues+size, capacity-size);
+            size += cursor->clip(cmp, resultKeys+size, resultValues+size, cnt);
+            continue;
+        }
+
+        // then the same depth first traversal as rangeQuery, one node at a time, until the window is full
+        if (!cursor->traversalDone) {
+            if (rqProvider->snapshot_window_full(tid)) cursor->endWindow(cmp);
+            if (cursor->stack.empty()) {
+                rqProvider->snapshot_traversal_done(tid);
+                cursor->traversalDone = true;
+                continue;
+            }
+            auto subtree = cursor->stack.back();
+            cursor->stack.pop_back();
+            Node<DEGREE,K> * node = subtree.node;
+            assert(node);
+            if (node->isLeaf()) {
+                rqProvider->snapshot_visit(tid, node, cursor->lo, cursor->hi);
+            } else {
+                int nkeys = node->getKeyCount();
+                int r = nkeys;
+                while (r > 0 && cmp(cursor->hi, (const K&) node->keys[r-1])) --r;
+                int l = 0;
+                while (l < nkeys && !cmp(cursor->lo, (const K&) node->keys[l])) ++l;
+                for (int i=r;i>l; --i) cursor->stack.push_back({rqProvider->read_addr(tid, &node->ptrs[i]), true, (const K&) node->keys[i-1]});
+                cursor->stack.push_back({rqProvider->read_addr(tid, &node->ptrs[l]), subtree.bounded, subtree.lowerBound});
+            }
+            continue;
+        }
+
+        // then the nodes deleted during the scan
+        if (rqProvider->snapshot_visit_deleted(tid, cursor->lo, cursor->hi)) continue;
+
+        // and on to the next window
+        if (!cursor->windowBounded) break;
+        rqProvider->snapshot_next_window(tid);
+        cursor->startWindow(cursor->windowEnd, entry);
+    }
+    return size;
+}
+
+template<int DEGREE, typename K, class Compare, class RecManager>
+void bslack_ns::bslack<DEGREE,K,Compare,RecManager>::snapshotEnd(const int tid, SnapshotCursor * const cursor) {
+    rqProvider->snapshot_end(tid);
+    cursor->stack.clear();
+    recordmgr->endOp(tid);
+}
+#endif
+
 
 template <int DEGREE, typename K, class Compare, class RecManager>
 void* bslack_ns::bslack<DEGREE,K,Compare,RecManager>::doInsert(const int tid, const K& key, void * const value, const bool replace) {
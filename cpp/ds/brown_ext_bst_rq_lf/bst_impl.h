@@ -282,6 +282,19 @@ public:
         const std::pair<V,bool> erase(const int tid, const K& key);
         const std::pair<V,bool> find(const int tid, const K& key);
         int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues);
+#ifdef RQ_LOCKFREE
+        /**
+         * Streaming snapshot of the keys in [lo, hi] (see STREAMING SNAPSHOTS in rq_dcssp.h).
+         * snapshotNext copies the next (at most capacity) keys of the snapshot into
+         * resultKeys/resultValues and returns how many, or 0 once the snapshot is
+         * exhausted. The thread stays in one operation of the record manager from
+         * snapshotBegin to snapshotEnd, so a long scan delays reclamation.
+         */
+        typedef rq_snapshot_cursor<K, Node<K,V>> SnapshotCursor;
+        long long snapshotBegin(const int tid, const K& lo, const K& hi, SnapshotCursor * const cursor);
+        int snapshotNext(const int tid, SnapshotCursor * const cursor, K * const resultKeys, V * const resultValues, const int capacity);
+        void snapshotEnd(const int tid, SnapshotCursor * const cursor);
+#endif
         bool contains(const int tid, const K& key);
         int size(void); /** warning: size is a LINEAR time operation, and does not return consistent results with concurrency **/
 
@@ -479,6 +492,73 @@ int bst_ns::bst<K,V,Compare,RecManager>::rangeQuery(const int tid, const K& lo,
     return size;
 }
 
+#ifdef RQ_LOCKFREE
+template<class K, class V, class Compare, class RecManager>
+long long bst_ns::bst<K,V,Compare,RecManager>::snapshotBegin(const int tid, const K& lo, const K& hi, SnapshotCursor * const cursor) {
+    recmgr->startOp(tid);
+    cursor->hi = hi;
+    cursor->startWindow(lo, root);
+    return rqProvider->snapshot_start(tid);
+}
+
+template<class K, class V, class Compare, class RecManager>
+int bst_ns::bst<K,V,Compare,RecManager>::snapshotNext(const int tid, SnapshotCursor * const cursor, K * const resultKeys, V * const resultValues, const int capacity) {
+    int size = 0;
+    while (size < capacity) {
+        // hand out the key of the last visited leaf first
+        if (rqProvider->snapshot_has_pending(tid)) {
+            int cnt = rqProvider->snapshot_emit(tid, resultKeys+size, resultValues+size, capacity-size);
+            size += cursor->clip(cmp, resultKeys+size, resultValues+size, cnt);
+            continue;
+        }
+
+        // then the same depth first traversal as rangeQuery, one node at a time, until the window is full
+        if (!cursor->traversalDone) {
+            if (rqProvider->snapshot_window_full(tid)) cursor->endWindow(cmp);
+            if (cursor->stack.empty()) {
+                rqProvider->snapshot_traversal_done(tid);
+                cursor->traversalDone = true;
+                continue;
+            }
+            auto subtree = cursor->stack.back();
+            cursor->stack.pop_back();
+            Node<K,V> * node = subtree.node;
+            assert(node);
+            Node<K,V> * left = rqProvider->read_addr(tid, &node->left);
+            if (left != NULL) {
+                if (node->key != this->NO_KEY && !cmp(cursor->hi, node->key)) {
+                    Node<K,V> * right = rqProvider->read_addr(tid, &node->right);
+                    assert(right);
+                    cursor->stack.push_back({right, true, node->key});
+                }
+                if (node->key == this->NO_KEY || cmp(cursor->lo, node->key)) {
+                    cursor->stack.push_back({left, subtree.bounded, subtree.lowerBound});
+                }
+            } else {
+                rqProvider->snapshot_visit(tid, node, cursor->lo, cursor->hi);
+            }
+            continue;
+        }
+
+        // then the leaves deleted during the scan
+        if (rqProvider->snapshot_visit_deleted(tid, cursor->lo, cursor->hi)) continue;
+
+        // and on to the next window
+        if (!cursor->windowBounded) break;
+        rqProvider->snapshot_next_window(tid);
+        cursor->startWindow(cursor->windowEnd, root);
+    }
+    return size;
+}
+
+template<class K, class V, class Compare, class RecManager>
+void bst_ns::bst<K,V,Compare,RecManager>::snapshotEnd(const int tid, SnapshotCursor * const cursor) {
+    rqProvider->snapshot_end(tid);
+    cursor->stack.clear();
+    recmgr->endOp(tid);
+}
+#endif
+
 template<class K, class V, class Compare, class RecManager>
 const std::pair<V,bool> bst_ns::bst<K,V,Compare,RecManager>::find(const int tid, const K& key) {
     std::pair<V,bool> result;
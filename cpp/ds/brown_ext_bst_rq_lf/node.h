@@ -36,7 +36,7 @@ namespace bst_ns {
 #endif
         nodeptr left;
         nodeptr right;
-#if defined(RQ_LOCKFREE) || defined(RQ_RWLOCK) || defined(HTM_RQ_RWLOCK)
+#if defined(RQ_LOCKFREE) || defined(RQ_RWLOCK) || defined(RQ_HTM_RWLOCK)
         volatile long long itime; // for use by range query algorithm
         volatile long long dtime; // for use by range query algorithm
 #endif
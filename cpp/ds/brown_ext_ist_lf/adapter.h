@@ -10,6 +10,7 @@
 
 #include <iostream>
 #include "errors.h"
+#include "ds_parameters.h"
 #include "brown_ext_ist_lf_impl.h"
 #ifdef USE_TREE_STATS
 #   define TREE_STATS_BYTES_AT_DEPTH
@@ -22,7 +23,10 @@
 #else
 #    define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, NODE_T, KVPair<K,V>, RebuildOperation<K,V>, MultiCounter>
 #endif
-#define DATA_STRUCTURE_T istree<K, V, Interpolator<K>, RECORD_MANAGER_T>
+#ifndef IST_INTERPOLATOR
+#   define IST_INTERPOLATOR Interpolator /* or FixedPointInterpolator (see ist_search_kernels.h) */
+#endif
+#define DATA_STRUCTURE_T istree<K, V, IST_INTERPOLATOR<K>, RECORD_MANAGER_T>
 
 template <typename T>
 struct ValidAllocatorTest { static constexpr bool value = false; };
@@ -42,37 +46,54 @@ static bool isValidPool(void) {
     return ValidPoolTest<Pool>::value;
 }
 
-template <typename K>
-class Interpolator {
-public:
-    bool less(const K& a, const K& b);
-    double interpolate(const K& key, const K& rangeLeft, const K& rangeRight);
-};
-
-template <>
-class Interpolator<long long> {
-public:
-    int compare(const long long& a, const long long& b) {
-        return (a < b) ? -1 : (a > b) ? 1 : 0;
-    }
-//    double interpolate(const long long& key, const long long& rangeLeft, const long long& rangeRight) {
-//        if (rangeRight == rangeLeft) return 0;
-//        return ((double) key - (double) rangeLeft) / ((double) rangeRight - (double) rangeLeft);
-//    }
-};
-
 template <typename K, typename V, class Reclaim = reclaimer_debra<K>, class Alloc = allocator_new<K>, class Pool = pool_none<K>>
 class ds_adapter {
 private:
     DATA_STRUCTURE_T * const ds;
 
+    static ist_node_placement_policy placementFromParameters() {
+        ist_node_placement_policy policy;
+        policy.hugePageThreshold = ds_parameters::get<size_t>("ist.hugePageThreshold", policy.hugePageThreshold);
+        policy.explicitHugePages = ds_parameters::get<bool>("ist.explicitHugePages", policy.explicitHugePages);
+        policy.numaLocal = ds_parameters::get<bool>("ist.numaLocal", policy.numaLocal);
+        policy.interleaveDepth = ds_parameters::get<size_t>("ist.interleaveDepth", policy.interleaveDepth);
+#ifndef USE_LIBNUMA
+        if (policy.numaLocal || policy.interleaveDepth) {
+            setbench_error("ist.numaLocal and ist.interleaveDepth require libnuma (USE_LIBNUMA)");
+        }
+#endif
+        return policy;
+    }
+
+    static ist_rebuild_policy rebuildPolicyFromParameters() {
+        ist_rebuild_policy policy (REBUILD_FRACTION, MAX_ACCEPTABLE_LEAF_SIZE);
+        policy.rebuildFraction = ds_parameters::get<double>("ist.rebuildFraction", policy.rebuildFraction);
+        policy.maxLeafSize = ds_parameters::get<size_t>("ist.maxLeafSize", policy.maxLeafSize);
+        policy.collaborativeMarkAndCount = ds_parameters::get<bool>("ist.collaborativeMarkAndCount", policy.collaborativeMarkAndCount);
+        policy.adaptive = ds_parameters::get<bool>("ist.adaptiveRebuild", policy.adaptive);
+        policy.maxRebuildScale = ds_parameters::get<size_t>("ist.maxRebuildScale", policy.maxRebuildScale);
+        policy.wastedChangeFraction = ds_parameters::get<double>("ist.wastedChangeFraction", policy.wastedChangeFraction);
+        if (policy.rebuildFraction <= 0) {
+            setbench_error("ist.rebuildFraction must be positive");
+        }
+        if (policy.maxLeafSize < 2) {
+            setbench_error("ist.maxLeafSize must be at least 2");
+        }
+        if (policy.maxRebuildScale < 1) {
+            setbench_error("ist.maxRebuildScale must be at least 1");
+        }
+        return policy;
+    }
+
 public:
+    // (the main thread builds the adapter after the harness seeded rand(), so the
+    // seed of the per-thread generators of the tree follows the seed of the run)
     ds_adapter(const int NUM_THREADS,
                const K& unused1,
                const K& KEY_MAX,
                const V& NO_VALUE,
                Random64 * const unused3)
-    : ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MAX, NO_VALUE))
+    : ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MAX, NO_VALUE, placementFromParameters(), rebuildPolicyFromParameters(), rand()))
     {
         if (!isValidAllocator<Alloc>()) {
             setbench_error("This data structure must be used with allocator_new.")
@@ -94,7 +115,7 @@ public:
             , const size_t initNumKeys
             , const size_t initConstructionSeed /* note: randomness is used to ensure good tree structure whp */
     )
-    : ds(new DATA_STRUCTURE_T(initKeys, initValues, initNumKeys, initConstructionSeed, NUM_THREADS, KEY_MAX, NO_VALUE))
+    : ds(new DATA_STRUCTURE_T(initKeys, initValues, initNumKeys, initConstructionSeed, NUM_THREADS, KEY_MAX, NO_VALUE, placementFromParameters(), rebuildPolicyFromParameters(), initConstructionSeed))
     {
         if (!isValidAllocator<Alloc>()) {
             setbench_error("This data structure must be used with allocator_new.")
@@ -139,9 +160,26 @@ public:
     int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
         setbench_error("not implemented");
     }
+
+    #define DS_ADAPTER_SUPPORTS_RQ_AGGREGATE
+    #define DS_ADAPTER_SUPPORTS_RQ_VISIT
+    rq_aggregate<K> rangeQueryAggregate(const int tid, const K& lo, const K& hi) {
+        return ds->rangeQueryAggregate(tid, lo, hi);
+    }
+    template <class Visitor>
+    void rangeQueryVisit(const int tid, const K& lo, const K& hi, Visitor& visit) {
+        ds->rangeQueryVisit(tid, lo, hi, visit);
+    }
     void printSummary() {
         auto recmgr = ds->debugGetRecMgr();
         recmgr->printStatus();
+#ifdef USE_TREE_STATS
+        // keys whose value word sits in a node (one cache line with inline leaf pairs) vs. keys behind a KVPair pointer
+        size_t keysInNodes = 0, keysInKVPairs = 0;
+        countKeysByPlacement(NODE_TO_CASWORD(ds->debug_getEntryPoint()), &keysInNodes, &keysInKVPairs);
+        std::cout<<"keys_in_nodes="<<keysInNodes<<std::endl;
+        std::cout<<"keys_in_kvpairs="<<keysInKVPairs<<std::endl;
+#endif
 //        auto sizeBytes = ds->debugComputeSizeBytes();
 //        std::cout<<"endingSizeBytes="<<sizeBytes<<std::endl;
     }
@@ -151,6 +189,13 @@ public:
     }
     void printObjectSizes() {
         std::cout<<"size_node="<<(sizeof(NODE_T))<<std::endl;
+        std::cout<<"size_kvpair="<<(sizeof(KVPair<K,V>))<<std::endl;
+#ifdef IST_INLINE_LEAF_PAIRS
+        std::cout<<"size_leaf_entry="<<(sizeof(K)+sizeof(casword_t))<<std::endl; // key and value word of one inline pair
+        std::cout<<"inline_leaf_pairs=1"<<std::endl;
+#else
+        std::cout<<"inline_leaf_pairs=0"<<std::endl;
+#endif
     }
     // try to clean up: must only be called by a single thread as part of the test harness!
     void debugGCSingleThreaded() {
@@ -223,6 +268,23 @@ public:
 #endif
 
 private:
+#ifdef USE_TREE_STATS
+    void countKeysByPlacement(casword_t ptr, size_t * keysInNodes, size_t * keysInKVPairs) {
+        if (IS_KVPAIR(ptr)) { ++*keysInKVPairs; return; }
+        if (IS_REBUILDOP(ptr)) ptr = NODE_TO_CASWORD(CASWORD_TO_REBUILDOP(ptr)->rebuildRoot);
+        if (!IS_NODE(ptr) || ptr == NODE_TO_CASWORD(NULL)) return;
+        auto node = CASWORD_TO_NODE(ptr);
+        for (int i=0;i<node->degree;++i) {
+            auto child = node->ptr(i);
+            if (IS_VAL(child)) {
+                if (!IS_EMPTY_VAL(child)) ++*keysInNodes;
+            } else {
+                countKeysByPlacement(child, keysInNodes, keysInKVPairs);
+            }
+        }
+    }
+#endif
+
     template<typename... Arguments>
     void iterate_helper_fn(int depth, void (*callback)(K key, V value, Arguments... args)
             , casword_t ptr, Arguments... args) {
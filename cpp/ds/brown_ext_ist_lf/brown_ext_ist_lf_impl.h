@@ -18,6 +18,12 @@
 #ifndef BROWN_EXT_IST_LF_IMPL_H
 #define BROWN_EXT_IST_LF_IMPL_H
 
+// IST_SEARCH_STATS (opt-in, since it adds stores to every search inside a node)
+// adds the searches of the IST to the KEY_SEARCH_TOTAL_STAT totals
+#if defined IST_SEARCH_STATS && !defined KEY_SEARCH_TOTAL_STAT
+#error IST_SEARCH_STATS needs KEY_SEARCH_TOTAL_STAT
+#endif
+
 #ifdef GSTATS_HANDLE_STATS
 #   ifndef __AND
 #      define __AND ,
@@ -39,6 +45,12 @@
         gstats_handle_stat(LONG_LONG, num_complete_rebuild_at_depth, 100, { \
                 gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
         }) \
+        gstats_handle_stat(LONG_LONG, bytes_rebuilt_at_depth, 100, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_wasted_rebuild_at_depth, 100, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
         gstats_handle_stat(LONG_LONG, num_help_rebuild, 1, { \
                 gstats_output_item(PRINT_RAW, SUM, TOTAL) \
         }) \
@@ -57,6 +69,12 @@
         gstats_handle_stat(LONG_LONG, duration_traverseAndRetire, 1, { \
                 gstats_output_item(PRINT_RAW, SUM, TOTAL) \
         }) \
+        gstats_handle_stat(LONG_LONG, num_mapped_nodes_allocated, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_mapped_node_bytes_allocated, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
 
     // define a variable for each stat above
     GSTATS_HANDLE_STATS_BROWN_EXT_IST_LF(__DECLARE_EXTERN_STAT_ID);
@@ -93,7 +111,8 @@ public:
 //#define NO_REBUILDING
 //#define PAD_CHANGESUM
 //#define IST_DISABLE_COLLABORATIVE_MARK_AND_COUNT
-#define MAX_ACCEPTABLE_LEAF_SIZE (48)
+//#define IST_INLINE_LEAF_PAIRS /* store each key next to its value word in leaves (see Node::inlinePairs) */
+#define MAX_ACCEPTABLE_LEAF_SIZE (48) /* default for ist_rebuild_policy::maxLeafSize */
 
 #define GV_FLIP_RECORDS
 
@@ -119,6 +138,13 @@ public:
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
 #   include "multi_counter.h"
 #endif
+#include "ist_node_placement.h"
+#include "ist_rebuild_policy.h"
+#include "ist_search_kernels.h"
+#include "rq_aggregate.h"
+#include "key_depth_latency.h"
+
+#include "key_stats.h"
 
 // Note: the following are hacky macros to essentially replace polymorphic types
 //       since polymorphic types are unnecessarily expensive. A child pointer in
@@ -175,7 +201,7 @@ public:
 
 
 // constants for rebuilding
-#define REBUILD_FRACTION            (0.25) /* any subtree will be rebuilt after a number of updates equal to this fraction of its size are performed; example: after 250k updates in a subtree that contained 1M keys at the time it was last rebuilt, it will be rebuilt again */
+#define REBUILD_FRACTION            (0.25) /* default for ist_rebuild_policy::rebuildFraction; any subtree will be rebuilt after a number of updates equal to this fraction of its size are performed; example: after 250k updates in a subtree that contained 1M keys at the time it was last rebuilt, it will be rebuilt again */
 #define EPS                         (0.25) /* unused */
 
 //static thread_local Random64 * myRNG = NULL; //new Random64(rand());
@@ -189,8 +215,10 @@ struct Node {
     size_t volatile degree;
     K minKey;                   // field not *technically* needed (used to avoid loading extra cache lines for interpolationSearch in the common case, buying for time for prefetching while interpolation arithmetic occurs)
     K maxKey;                   // field not *technically* needed (same as above)
+    uint64_t interpolationFactor; // precomputed by Interpolate::factor when minKey and maxKey are set (see ist_search_kernels.h)
     size_t capacity;            // field likely not needed (but convenient and good for debug asserts)
     size_t initSize;            // initial size (at time of last rebuild) of the subtree rooted at this node
+    size_t rebuildScale;        // the subtree is rebuilt after rebuildFraction * rebuildScale * initSize updates (see ist_rebuild_policy.h)
     size_t volatile dirty;      // 2-LSBs are marked by markAndCount; also stores the number of pairs in a subtree as recorded by markAndCount (see SUM_TO_DIRTY_FINISHED and DIRTY_FINISHED_TO_SUM)
     size_t volatile nextMarkAndCount; // facilitates recursive-collaborative markAndCount() by allowing threads to dynamically soft-partition subtrees (NOT workstealing/exclusive access---this is still a lock-free mechanism)
 #ifdef PAD_CHANGESUM
@@ -199,14 +227,48 @@ struct Node {
     volatile size_t changeSum;  // could be merged with initSize above (subtract make initSize 1/4 of what it would normally be, then subtract from it instead of incrementing changeSum, and rebuild when it hits zero)
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
     MultiCounter * externalChangeCounter; // NULL for all nodes except the root (or top few nodes), and supercedes changeSum when non-NULL.
+#endif
+    size_t mappedBytes;         // length of the mmap backing this node, or 0 if it was allocated with ::operator new (see ist_node_placement.h)
+#ifdef IST_INLINE_LEAF_PAIRS
+    size_t inlinePairs;         // non-zero for nodes created by createLeaf, which interleave keys and pointers (see below)
 #endif
     // unlisted fields: capacity-1 keys of type K followed by capacity values/pointers of type casword_t
     // the values/pointers have tags in their 3 LSBs so that they satisfy either IS_NODE, IS_KVPAIR, IS_REBUILDOP or IS_VAL
+    // with IST_INLINE_LEAF_PAIRS, leaves instead store ptr0, key0, ptr1, key1, ..., ptr(capacity-1),
+    // so key(i) shares a cache line with the value word ptr(i+1) that a successful search reads next
+
+    // nodes are freed by the record manager with delete, so both kinds of allocation must be handled here
+    // (Node is trivially destructible, so mappedBytes is still intact)
+    static void operator delete(void * p) {
+        const size_t mappedBytes = ((Node<K,V> *) p)->mappedBytes;
+        if (mappedBytes) {
+            ist_node_placement_policy::unmap(p, mappedBytes);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    static size_t bytesForDegree(const size_t degree) {
+        return sizeof(Node<K,V>) + sizeof(K) * (degree - 1) + sizeof(casword_t) * degree;
+    }
 
     inline K * keyAddr(const int ix) {
+#ifdef IST_INLINE_LEAF_PAIRS
+        static_assert(sizeof(K) % sizeof(casword_t) == 0, "IST_INLINE_LEAF_PAIRS requires keys to keep pointers word aligned");
+        if (inlinePairs) {
+            return (K *) (((char *) this)+sizeof(Node<K,V>)+sizeof(casword_t)+ix*(sizeof(K)+sizeof(casword_t)));
+        }
+#endif
         K * const firstKey = ((K *) (((char *) this)+sizeof(Node<K,V>)));
         return &firstKey[ix];
     }
+    // distance between consecutive keys, in units of K
+    inline int keyStride() {
+#ifdef IST_INLINE_LEAF_PAIRS
+        if (inlinePairs) return (sizeof(K)+sizeof(casword_t)) / sizeof(K);
+#endif
+        return 1;
+    }
     inline K& key(const int ix) {
         assert(ix >= 0);
         assert(ix < degree - 1);
@@ -216,7 +278,12 @@ struct Node {
     inline casword_t volatile * ptrAddr(const int ix) {
         assert(ix >= 0);
         assert(ix < degree);
-        K * const firstKeyAfter = keyAddr(capacity - 1);
+#ifdef IST_INLINE_LEAF_PAIRS
+        if (inlinePairs) {
+            return (casword_t *) (((char *) this)+sizeof(Node<K,V>)+ix*(sizeof(K)+sizeof(casword_t)));
+        }
+#endif
+        K * const firstKeyAfter = ((K *) (((char *) this)+sizeof(Node<K,V>))) + (capacity - 1);
         casword_t * const firstPtr = (casword_t *) firstKeyAfter;
         return &firstPtr[ix];
     }
@@ -283,6 +350,9 @@ private:
     RecManager * const recordmgr;
     dcssProvider<void* /* unused */> * const prov;
     Interpolate cmp;
+    const ist_node_placement_policy placement;
+    const ist_rebuild_policy rebuildPolicy;
+    const uint64_t rngSeed;     // thread tid's generator is seeded with rngSeed + tid
 
     Node<K,V> * root;
 
@@ -291,12 +361,20 @@ private:
     void helpRebuild(const int tid, RebuildOperation<K,V> * op);
     int interpolationSearch(const int tid, const K& key, Node<K,V> * const node);
     V doUpdate(const int tid, const K& key, const V& val, UpdateType t);
+    template <class Visitor>
+    void visitRange(const int tid, const casword_t ptr, const K& lo, const K& hi, Visitor& visit);
 
-    Node<K,V> * createNode(const int tid, const int degree);
-    Node<K,V> * createLeaf(const int tid, KVPair<K,V> * pairs, int numPairs);
-    Node<K,V> * createMultiCounterNode(const int tid, const int degree);
+    Node<K,V> * createNode(const int tid, const int degree, const size_t depth);
+    Node<K,V> * createLeaf(const int tid, KVPair<K,V> * pairs, int numPairs, const size_t depth);
+    Node<K,V> * createMultiCounterNode(const int tid, const int degree, const size_t depth);
     KVPair<K,V> * createKVPair(const int tid, const K& key, const V& value);
 
+    void setKeyRange(Node<K,V> * node) {
+        node->minKey = node->key(0);
+        node->maxKey = node->key(node->degree-2);
+        node->interpolationFactor = cmp.factor(node->minKey, node->maxKey, node->degree-1);
+    }
+
     void debugPrintWord(std::ofstream& ofs, casword_t w) {
         //ofs<<(void *) (w&~TOTAL_MASK)<<"("<<(IS_REBUILDOP(w) ? "r" : IS_VAL(w) ? "v" : "n")<<")";
         //ofs<<(IS_REBUILDOP(w) ? "RebuildOp *" : IS_VAL(w) ? "V" : "Node *");
@@ -522,6 +600,7 @@ private:
         size_t initNumKeys;
         istree<K,V,Interpolate,RecManager> * ist;
         size_t depth;
+        size_t rebuildScale;
         KVPair<K,V> * pairs;
         size_t pairsAdded;
         casword_t tree;
@@ -534,8 +613,10 @@ private:
                 return NODE_TO_CASWORD(NULL); // bail early if tree was already constructed by someone else
             }
 
-            if (psetSize <= MAX_ACCEPTABLE_LEAF_SIZE) {
-                return ist->createLeaf(tid, pset, psetSize);
+            if (psetSize <= ist->rebuildPolicy.maxLeafSize) {
+                auto leaf = ist->createLeaf(tid, pset, psetSize, currDepth);
+                leaf->rebuildScale = rebuildScale;
+                return leaf;
             } else {
                 double numChildrenD = std::sqrt((double) psetSize);
                 size_t numChildren = (size_t) std::ceil(numChildrenD);
@@ -548,15 +629,16 @@ private:
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
                 Node<K,V> * node = NULL;
                 if (currDepth <= 1) {
-                    node = ist->createMultiCounterNode(tid, numChildren);
+                    node = ist->createMultiCounterNode(tid, numChildren, currDepth);
                 } else {
-                    node = ist->createNode(tid, numChildren);
+                    node = ist->createNode(tid, numChildren, currDepth);
                 }
 #else
-                auto node = ist->createNode(tid, numChildren);
+                auto node = ist->createNode(tid, numChildren, currDepth);
 #endif
                 node->degree = numChildren;
                 node->initSize = psetSize;
+                node->rebuildScale = rebuildScale;
 
                 if (parallelizeWithOMP) { // special code for partially parallel initialization
                     #pragma omp parallel
@@ -597,17 +679,17 @@ private:
                         childSet += sz;
                     }
                 }
-                node->minKey = node->key(0);
-                node->maxKey = node->key(node->degree-2);
+                ist->setKeyRange(node);
                 assert(node->degree <= node->capacity);
                 return node;
             }
         }
     public:
-        IdealBuilder(istree<K,V,Interpolate,RecManager> * _ist, const size_t _initNumKeys, const size_t _depth) {
+        IdealBuilder(istree<K,V,Interpolate,RecManager> * _ist, const size_t _initNumKeys, const size_t _depth, const size_t _rebuildScale = 1) {
             initNumKeys = _initNumKeys;
             ist = _ist;
             depth = _depth;
+            rebuildScale = _rebuildScale;
             pairs = new KVPair<K,V>[initNumKeys];
             pairsAdded = 0;
             tree = (casword_t) NULL;
@@ -676,12 +758,35 @@ private:
     void addKVPairs(const int tid, casword_t ptr, IdealBuilder * b);
     void addKVPairsSubset(const int tid, RebuildOperation<K,V> * op, Node<K,V> * node, size_t * numKeysToSkip, size_t * numKeysToAdd, size_t depth, IdealBuilder * b, casword_t volatile * constructingSubtree);
     casword_t createIdealConcurrent(const int tid, RebuildOperation<K,V> * op, const size_t keyCount);
+
+    // bytes of the nodes of an ideal subtree containing keyCount keys (for rebuilding statistics)
+    size_t idealSubtreeBytes(const size_t keyCount) {
+        if (keyCount == 0) return 0;
+        if (keyCount == 1) return sizeof(KVPair<K,V>);
+        if (keyCount <= rebuildPolicy.maxLeafSize) return Node<K,V>::bytesForDegree(keyCount+1);
+        size_t numChildren = (size_t) std::ceil(std::sqrt((double) keyCount));
+        size_t childSize = keyCount / numChildren;
+        size_t remainder = keyCount % numChildren;
+        return Node<K,V>::bytesForDegree(numChildren)
+                + remainder * idealSubtreeBytes(childSize+1)
+                + (numChildren - remainder) * idealSubtreeBytes(childSize);
+    }
     void subtreeBuildAndReplace(const int tid, RebuildOperation<K,V>* op, Node<K,V>* parent, size_t ix, size_t childSize, size_t remainder);
 
     int init[MAX_THREADS_POW2] = {0,};
     PAD;
     Random64 threadRNGs[MAX_THREADS_POW2];
     PAD;
+#ifdef IST_SEARCH_STATS
+    struct SearchStats {
+        int64_t searches;       // searches inside a node that used interpolation
+        int64_t iters;          // keys compared by those searches
+        int64_t probeDistance;  // sum of distances between guessed and final key positions
+        PAD;
+    };
+    SearchStats searchStats[MAX_THREADS_POW2] = {};
+    PAD;
+#endif
 public:
     const K INF_KEY;
     const V NO_VALUE;
@@ -692,7 +797,7 @@ public:
 //        if (myRNG == NULL) myRNG = new Random64(rand());
         if (init[tid]) return; else init[tid] = !init[tid];
 
-        threadRNGs[tid].setSeed(rand());
+        threadRNGs[tid].setSeed(rngSeed + tid); // (so runs with the same seed match, whatever order the threads start in)
         assert(threadRNGs[tid].next());
         prov->initThread(tid);
         recordmgr->initThread(tid);
@@ -701,6 +806,14 @@ public:
 //        if (myRNG != NULL) { delete myRNG; myRNG = NULL; }
         if (!init[tid]) return; else init[tid] = !init[tid];
 
+#ifdef IST_SEARCH_STATS
+        // publish this thread's search statistics (the global counters are read after the run)
+        __sync_fetch_and_add(&key_search_total_cnt__, searchStats[tid].searches);
+        __sync_fetch_and_add(&key_search_total_iters_cnt__, searchStats[tid].iters);
+        __sync_fetch_and_add(&key_search_total_probe_cnt__, searchStats[tid].searches);
+        __sync_fetch_and_add(&key_search_total_probe_distance__, searchStats[tid].probeDistance);
+        searchStats[tid] = {};
+#endif
         prov->deinitThread(tid);
         recordmgr->deinitThread(tid);
     }
@@ -708,20 +821,25 @@ public:
     istree(const int numProcesses
          , const K infinity
          , const V noValue
+         , const ist_node_placement_policy& _placement = ist_node_placement_policy()
+         , const ist_rebuild_policy& _rebuildPolicy = ist_rebuild_policy(REBUILD_FRACTION, MAX_ACCEPTABLE_LEAF_SIZE)
+         , const uint64_t _rngSeed = 0
     )
     : recordmgr(new RecManager(numProcesses, SIGQUIT))
     , prov(new dcssProvider<void* /* unused */>(numProcesses))
+    , placement(_placement)
+    , rebuildPolicy(_rebuildPolicy)
+    , rngSeed(_rngSeed)
     , INF_KEY(infinity)
     , NO_VALUE(noValue)
     , NUM_PROCESSES(numProcesses)
     {
-        srand(time(0)); // for seeding per-thread RNGs in initThread
         cmp = Interpolate();
 
         const int tid = 0;
         initThread(tid);
 
-        Node<K,V> * _root = createNode(tid, 1);
+        Node<K,V> * _root = createNode(tid, 1, 0);
         _root->degree = 1;
         _root->minKey = INF_KEY;
         _root->maxKey = INF_KEY;
@@ -737,9 +855,15 @@ public:
          , const int numProcesses
          , const K infinity
          , const V noValue
+         , const ist_node_placement_policy& _placement = ist_node_placement_policy()
+         , const ist_rebuild_policy& _rebuildPolicy = ist_rebuild_policy(REBUILD_FRACTION, MAX_ACCEPTABLE_LEAF_SIZE)
+         , const uint64_t _rngSeed = 0
     )
     : recordmgr(new RecManager(numProcesses, SIGQUIT))
     , prov(new dcssProvider<void* /* unused */>(numProcesses))
+    , placement(_placement)
+    , rebuildPolicy(_rebuildPolicy)
+    , rngSeed(_rngSeed)
     , INF_KEY(infinity)
     , NO_VALUE(noValue)
     , NUM_PROCESSES(numProcesses)
@@ -747,13 +871,12 @@ public:
 
 #if defined IST_INIT_CONCURRENT_INSERT_THEN_REBUILD
 
-        srand(time(0)); // for seeding per-thread RNGs in initThread
         cmp = Interpolate();
 
         const int dummyTid = 0;
         initThread(dummyTid);
 
-        Node<K,V> * _root = createNode(dummyTid, 1);
+        Node<K,V> * _root = createNode(dummyTid, 1, 0);
         _root->degree = 1;
         _root->minKey = INF_KEY;
         _root->maxKey = INF_KEY;
@@ -785,13 +908,12 @@ public:
 #elif defined IST_INIT_PARALLEL_IDEAL_BUILD
 
         // parallelization of sequential ideal builder
-        srand(time(0)); // for seeding per-thread RNGs in initThread
         cmp = Interpolate();
 
         const int tid = 0;
         initThread(tid);
 
-        Node<K,V> * _root = createNode(tid, 1);
+        Node<K,V> * _root = createNode(tid, 1, 0);
         _root->degree = 1;
         root = _root;
 
@@ -807,13 +929,12 @@ public:
 #elif defined IST_INIT_SEQUENTIAL
 
         // old sequential tree building method
-        srand(time(0)); // for seeding per-thread RNGs in initThread
         cmp = Interpolate();
 
         const int tid = 0;
         initThread(tid);
 
-        Node<K,V> * _root = createNode(tid, 1);
+        Node<K,V> * _root = createNode(tid, 1, 0);
         _root->degree = 1;
         root = _root;
 
@@ -851,6 +972,18 @@ public:
     V erase(const int tid, const K& key) {
         return doUpdate(tid, key, NO_VALUE, Erase);
     }
+    // not linearizable: each subtree is seen as of the time the traversal reaches it
+    template <class Visitor>
+    void rangeQueryVisit(const int tid, const K& lo, const K& hi, Visitor& visit) {
+        assert(init[tid]);
+        auto guard = recordmgr->getGuard(tid, true);
+        visitRange(tid, NODE_TO_CASWORD(root), lo, hi, visit);
+    }
+    rq_aggregate<K> rangeQueryAggregate(const int tid, const K& lo, const K& hi) {
+        rq_aggregate<K> result;
+        rangeQueryVisit(tid, lo, hi, result);
+        return result;
+    }
     RecManager * const debugGetRecMgr() {
         return recordmgr;
     }
@@ -864,6 +997,7 @@ V istree<K,V,Interpolate,RecManager>::find(const int tid, const K& key) {
     assert(ptr);
     Node<K,V> * parent = root;
     int ixToPtr = 0;
+    KEY_DEPTH_LATENCY_BEGIN(); // (profiles the internal nodes, the child of root has depth 0)
     while (true) {
         if (unlikely(IS_KVPAIR(ptr))) {
             auto kv = CASWORD_TO_KVPAIR(ptr);
@@ -876,6 +1010,7 @@ V istree<K,V,Interpolate,RecManager>::find(const int tid, const K& key) {
             // ptr is an internal node
             parent = CASWORD_TO_NODE(ptr);
             assert(parent);
+            KEY_DEPTH_LATENCY_TOUCH(parent);
             ixToPtr = interpolationSearch(tid, key, parent);
             ptr = prov->readPtr(tid, parent->ptrAddr(ixToPtr));
         } else {
@@ -889,6 +1024,35 @@ V istree<K,V,Interpolate,RecManager>::find(const int tid, const K& key) {
     }
 }
 
+template <typename K, typename V, class Interpolate, class RecManager>
+template <class Visitor>
+void istree<K,V,Interpolate,RecManager>::visitRange(const int tid, const casword_t ptr, const K& lo, const K& hi, Visitor& visit) {
+    if (unlikely(IS_KVPAIR(ptr))) {
+        auto kv = CASWORD_TO_KVPAIR(ptr);
+        if (!(kv->k < lo) && !(hi < kv->k)) visit(kv->k, kv->v);
+    } else if (unlikely(IS_REBUILDOP(ptr))) {
+        auto rebuild = CASWORD_TO_REBUILDOP(ptr);
+        visitRange(tid, NODE_TO_CASWORD(rebuild->rebuildRoot), lo, hi, visit);
+    } else {
+        assert(IS_NODE(ptr));
+        auto node = CASWORD_TO_NODE(ptr);
+        // only the children between the ones lo and hi lead to can hold keys in [lo, hi]
+        const int first = interpolationSearch(tid, lo, node);
+        const int last = interpolationSearch(tid, hi, node);
+        for (int i=first;i<=last;++i) {
+            auto childptr = prov->readPtr(tid, node->ptrAddr(i));
+            if (IS_VAL(childptr)) {
+                if (IS_EMPTY_VAL(childptr)) continue;
+                assert(i > 0);
+                const K& k = node->key(i - 1); // keys of nodes do not change, so we can linearize this read with the value read
+                if (!(k < lo) && !(hi < k)) visit(k, CASWORD_TO_VAL(childptr));
+            } else {
+                visitRange(tid, childptr, lo, hi, visit);
+            }
+        }
+    }
+}
+
 template <typename K, typename V, class Interpolate, class RecManager>
 void istree<K,V,Interpolate,RecManager>::helpFreeSubtree(const int tid, Node<K,V> * node) {
     // if node is the root of a *large* subtree (256+ children),
@@ -996,7 +1160,7 @@ size_t istree<K,V,Interpolate,RecManager>::markAndCount(const int tid, const cas
 #if !defined IST_DISABLE_COLLABORATIVE_MARK_AND_COUNT
     // optimize for contention by first claiming a subtree to recurse on
     // THEN after there are no more subtrees to claim, help (any that are still DIRTY_STARTED)
-    if (node->degree > MAX_ACCEPTABLE_LEAF_SIZE) { // prevent this optimization from being applied at the leaves, where the number of fetch&adds will be needlessly high
+    if (rebuildPolicy.collaborativeMarkAndCount && node->degree > rebuildPolicy.maxLeafSize) { // prevent this optimization from being applied at the leaves, where the number of fetch&adds will be needlessly high
         while (1) {
             auto ix = __sync_fetch_and_add(&node->nextMarkAndCount, 1);
             if (ix >= node->degree) break;
@@ -1127,7 +1291,7 @@ void istree<K, V, Interpolate, RecManager>::subtreeBuildAndReplace(const int tid
     auto newChildSize = childSize + (ix < remainder);
 
     // build new subtree
-    IdealBuilder b (this, newChildSize, 1+op->depth);
+    IdealBuilder b (this, newChildSize, 1+op->depth, parent->rebuildScale);
     auto numKeysToSkip = totalSizeSoFar;
     auto numKeysToAdd = newChildSize;
     TRACE printf("    tid=%d calls addKVPairsSubset with numKeysToSkip=%lld and numKeysToAdd=%lld\n", tid, (long long) numKeysToSkip, (long long) numKeysToAdd);
@@ -1190,8 +1354,10 @@ casword_t istree<K,V,Interpolate,RecManager>::createIdealConcurrent(const int ti
     } else {
         assert(newRoot == NODE_TO_CASWORD(NULL));
 
-        if (keyCount <= MAX_ACCEPTABLE_LEAF_SIZE) {
-            IdealBuilder b (this, keyCount, op->depth);
+        // every helper computes the same scale (keyCount is fixed once the old subtree is marked)
+        auto rebuildScale = rebuildPolicy.nextRebuildScale(op->rebuildRoot->rebuildScale, op->rebuildRoot->initSize, keyCount);
+        if (keyCount <= rebuildPolicy.maxLeafSize) {
+            IdealBuilder b (this, keyCount, op->depth, rebuildScale);
             casword_t dummy = NODE_TO_CASWORD(NULL);
             addKVPairs(tid, NODE_TO_CASWORD(op->rebuildRoot), &b);
             word = b.getCASWord(tid, &dummy);
@@ -1199,11 +1365,11 @@ casword_t istree<K,V,Interpolate,RecManager>::createIdealConcurrent(const int ti
         } else {
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
             if (op->depth <= 1) {
-                word = NODE_TO_CASWORD(createMultiCounterNode(tid, numChildren));
+                word = NODE_TO_CASWORD(createMultiCounterNode(tid, numChildren, op->depth));
                 TRACE printf("    tid=%d create multi counter root=%llx\n", tid, (unsigned long long) word);
             } else {
 #endif
-                word = NODE_TO_CASWORD(createNode(tid, numChildren));
+                word = NODE_TO_CASWORD(createNode(tid, numChildren, op->depth));
                 TRACE printf("    tid=%d create regular root=%llx\n", tid, (unsigned long long) word);
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
             }
@@ -1213,6 +1379,7 @@ casword_t istree<K,V,Interpolate,RecManager>::createIdealConcurrent(const int ti
             for (int i=0;i<CASWORD_TO_NODE(word)->capacity;++i) {
                 *CASWORD_TO_NODE(word)->ptrAddr(i) = NODE_TO_CASWORD(NULL);
             }
+            CASWORD_TO_NODE(word)->rebuildScale = rebuildScale;
             CASWORD_TO_NODE(word)->degree = 0; // zero this out so we can have threads synchronize a bit later by atomically incrementing this until it hits node->capacity
         }
 
@@ -1256,7 +1423,7 @@ casword_t istree<K,V,Interpolate,RecManager>::createIdealConcurrent(const int ti
     assert(op->newRoot == word || EMPTY_VAL_TO_CASWORD /* as per above, rebuildop was part of a subtree that was rebuilt, and "word" was reclaimed! */);
 
     // stop here if there is no subtree to build (just one kvpair or node)
-    if (IS_KVPAIR(word) || keyCount <= MAX_ACCEPTABLE_LEAF_SIZE) return word;
+    if (IS_KVPAIR(word) || keyCount <= rebuildPolicy.maxLeafSize) return word;
 
     assert(IS_NODE(word));
     auto node = CASWORD_TO_NODE(word);
@@ -1300,8 +1467,7 @@ casword_t istree<K,V,Interpolate,RecManager>::createIdealConcurrent(const int ti
     }
 
     node->initSize = keyCount;
-    node->minKey = node->key(0);
-    node->maxKey = node->key(node->degree-2);
+    setKeyRange(node);
     assert(node->minKey != INF_KEY);
     assert(node->maxKey != INF_KEY);
     assert(node->minKey <= node->maxKey);
@@ -1377,6 +1543,10 @@ void istree<K,V,Interpolate,RecManager>::helpRebuild(const int tid, RebuildOpera
         SOFTWARE_BARRIER;
 #ifdef GSTATS_HANDLE_STATS
         GSTATS_ADD_IX(tid, num_complete_rebuild_at_depth, 1, op->depth);
+        GSTATS_ADD_IX(tid, bytes_rebuilt_at_depth, idealSubtreeBytes(keyCount), op->depth);
+        if (rebuildPolicy.isWasted(op->rebuildRoot->rebuildScale, op->rebuildRoot->initSize, keyCount)) {
+            GSTATS_ADD_IX(tid, num_wasted_rebuild_at_depth, 1, op->depth);
+        }
 #endif
 //        freeSubtree(tid, NODE_TO_CASWORD(op->rebuildRoot), true);
 //        helpFreeSubtree(tid, op->rebuildRoot);
@@ -1505,7 +1675,7 @@ int istree<K,V,Interpolate,RecManager>::interpolationSearch(const int tid, const
         return numKeys;
     }
     // assert: minKey <= key < maxKey
-    int ix = (numKeys * (key - minKey) / (maxKey - minKey));
+    int ix = cmp.guess(key, minKey, maxKey, numKeys, node->interpolationFactor);
 
     // __builtin_prefetch((node->keyAddr(0))+(ix-8), 1);                           // prefetch approximate key location
     // __builtin_prefetch((node->keyAddr(0))+(ix), 1);                             // prefetch approximate key location
@@ -1513,29 +1683,24 @@ int istree<K,V,Interpolate,RecManager>::interpolationSearch(const int tid, const
 
     const K& ixKey = node->key(ix);
 //    std::cout<<"key="<<key<<" minKey="<<minKey<<" maxKey="<<maxKey<<" ix="<<ix<<" ixKey="<<ixKey<<std::endl;
+    int result;
     if (key < ixKey) {
         // search to the left for node.key[i] <= key, then return i+1
-        int i;
-        for (i=ix-1;i>=0;--i) {
-            if (unlikely(key >= node->key(i))) {
-//                GSTATS_APPEND_D(tid, visited_in_isearch, (ix-1) - i + 1);
-                return i+1;
-            }
-        }
-        assert(false); return -1;
+        result = cmp.scanLeft(node->keyAddr(0), node->keyStride(), ix-1, key) + 1;
     } else if (key > ixKey) {
-        int i;
-        for (i=ix+1;i<numKeys;++i) { // recall: degree - 1 keys vs degree pointers
-            if (unlikely(key < node->key(i))) {
-//                GSTATS_APPEND_D(tid, visited_in_isearch, i - (ix+1) + 1);
-                return i;
-            }
-        }
-        assert(false); return -1;
+        // search to the right for the first node.key[i] > key
+        result = cmp.scanRight(node->keyAddr(0), node->keyStride(), ix+1, numKeys, key); // recall: degree - 1 keys vs degree pointers
     } else {
-//        GSTATS_APPEND_D(tid, visited_in_isearch, 1);
-        return ix+1;
+        result = ix+1;
     }
+#ifdef IST_SEARCH_STATS
+    // the key at result-1 is the largest one <= key
+    const int distance = (result-1 > ix) ? (result-1 - ix) : (ix - (result-1));
+    ++searchStats[tid].searches;
+    searchStats[tid].iters += 1 + distance;
+    searchStats[tid].probeDistance += distance;
+#endif
+    return result;
 }
 
 // note: val is unused if t == Erase
@@ -1550,6 +1715,7 @@ V istree<K,V,Interpolate,RecManager>::doUpdate(const int tid, const K& key, cons
     int pathLength;
     Node<K,V> * node;
 
+    KEY_DEPTH_LATENCY_BEGIN();
 retry:
     pathLength = 0;
     auto guard = recordmgr->getGuard(tid);
@@ -1560,6 +1726,7 @@ retryNode:
         bool affectsChangeSum = true;
         auto word = prov->readPtr(tid, node->ptrAddr(ix));
         if (IS_KVPAIR(word) || IS_VAL(word)) {
+            KEY_DEPTH_LATENCY_END(); // (the searches of the retries are not profiled)
             KVPair<K,V> * pair = NULL;
             Node<K,V> * newNode = NULL;
             KVPair<K,V> * newPair = NULL;
@@ -1612,7 +1779,7 @@ retryNode:
                             pairs[0] = { foundKey, foundVal };
                             pairs[1] = { key, val };
                         }
-                        newNode = createLeaf(tid, pairs, 2);
+                        newNode = createLeaf(tid, pairs, 2, pathLength);
                         newWord = NODE_TO_CASWORD(newNode);
                         foundVal = NO_VALUE; // the key we are inserting had no current value
                     }
@@ -1655,7 +1822,7 @@ retryNode:
                     // now, we must determine whether we should rebuild
                     for (int i=0;i<pathLength;++i) {
 //                        if ((path[i]->changeSum + (NUM_PROCESSES-1)) / (SAMPLING_PROB * (1 - EPS)) >= REBUILD_FRACTION * path[i]->initSize) {
-                        if (path[i]->readChangeSum(tid, &threadRNGs[tid] /*myRNG*/) >= REBUILD_FRACTION * path[i]->initSize) {
+                        if (path[i]->readChangeSum(tid, &threadRNGs[tid] /*myRNG*/) >= rebuildPolicy.rebuildFraction * path[i]->rebuildScale * path[i]->initSize) {
                             if (i == 0) {
 #ifndef NO_REBUILDING
 #   ifdef GSTATS_HANDLE_STATS
@@ -1721,11 +1888,13 @@ retryNode:
             return foundVal;
         } else if (IS_REBUILDOP(word)) {
             //std::cout<<"found supposed rebuildop "<<(size_t) word<<" at path length "<<pathLength<<std::endl;
+            KEY_DEPTH_LATENCY_END();
             helpRebuild(tid, CASWORD_TO_REBUILDOP(word));
             goto retry;
         } else {
             assert(IS_NODE(word));
             node = CASWORD_TO_NODE(word);
+            KEY_DEPTH_LATENCY_TOUCH(node);
             path[pathLength++] = node; // push on stack
             assert(pathLength <= MAX_PATH_LENGTH);
         }
@@ -1733,14 +1902,27 @@ retryNode:
 }
 
 template <typename K, typename V, class Interpolate, class RecManager>
-Node<K,V>* istree<K,V,Interpolate,RecManager>::createNode(const int tid, const int degree) {
-    size_t sz = sizeof(Node<K,V>) + sizeof(K) * (degree - 1) + sizeof(casword_t) * degree;
-    Node<K,V> * node = (Node<K,V> *) ::operator new (sz); //(Node<K,V> *) new char[sz];
+Node<K,V>* istree<K,V,Interpolate,RecManager>::createNode(const int tid, const int degree, const size_t depth) {
+    size_t sz = Node<K,V>::bytesForDegree(degree);
+    size_t mappedBytes = 0;
+    Node<K,V> * node = (Node<K,V> *) placement.map(sz, depth, &mappedBytes);
+    if (node) {
+        GSTATS_ADD(tid, num_mapped_nodes_allocated, 1);
+        GSTATS_ADD(tid, num_mapped_node_bytes_allocated, mappedBytes);
+    } else {
+        node = (Node<K,V> *) ::operator new (sz); //(Node<K,V> *) new char[sz];
+    }
+    node->mappedBytes = mappedBytes;
+#ifdef IST_INLINE_LEAF_PAIRS
+    node->inlinePairs = 0;
+#endif
 //    std::cout<<"node of degree "<<degree<<" allocated size "<<sz<<" @ "<<(size_t) node<<std::endl;
     assert((((size_t) node) & TOTAL_MASK) == 0);
     node->capacity = degree;
     node->degree = 0;
     node->initSize = 0;
+    node->rebuildScale = 1;
+    node->interpolationFactor = 0;
     node->changeSum = 0;
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
     node->externalChangeCounter = NULL;
@@ -1753,8 +1935,11 @@ Node<K,V>* istree<K,V,Interpolate,RecManager>::createNode(const int tid, const i
 }
 
 template <typename K, typename V, class Interpolate, class RecManager>
-Node<K,V>* istree<K,V,Interpolate,RecManager>::createLeaf(const int tid, KVPair<K,V> * pairs, int numPairs) {
-    auto node = createNode(tid, numPairs+1);
+Node<K,V>* istree<K,V,Interpolate,RecManager>::createLeaf(const int tid, KVPair<K,V> * pairs, int numPairs, const size_t depth) {
+    auto node = createNode(tid, numPairs+1, depth);
+#ifdef IST_INLINE_LEAF_PAIRS
+    node->inlinePairs = 1; // same size as the default layout, so createNode's allocation fits
+#endif
     node->degree = numPairs+1;
     node->initSize = numPairs;
     *node->ptrAddr(0) = EMPTY_VAL_TO_CASWORD;
@@ -1772,15 +1957,14 @@ Node<K,V>* istree<K,V,Interpolate,RecManager>::createLeaf(const int tid, KVPair<
         node->key(i) = pairs[i].k;
         *node->ptrAddr(i+1) = VAL_TO_CASWORD(pairs[i].v);
     }
-    node->minKey = node->key(0);
-    node->maxKey = node->key(node->degree-2);
+    setKeyRange(node);
     return node;
 }
 
 template <typename K, typename V, class Interpolate, class RecManager>
-Node<K,V>* istree<K,V,Interpolate,RecManager>::createMultiCounterNode(const int tid, const int degree) {
+Node<K,V>* istree<K,V,Interpolate,RecManager>::createMultiCounterNode(const int tid, const int degree, const size_t depth) {
 //    GSTATS_ADD(tid, num_multi_counter_node_created, 1);
-    auto node = createNode(tid, degree);
+    auto node = createNode(tid, degree, depth);
 #ifndef IST_DISABLE_MULTICOUNTER_AT_ROOT
     node->externalChangeCounter = new MultiCounter(this->NUM_PROCESSES, 1);
 //    std::cout<<"created MultiCounter at address "<<node->externalChangeCounter<<std::endl;
@@ -0,0 +1,91 @@
+/**
+ * Placement of large interpolation search tree nodes.
+ *
+ * Nodes of the ideal subtrees built by rebuilding can be huge (the root of a
+ * tree with 10^9 keys has ~31k children), and a search touches one cache line
+ * in each of them on a different 4KB page, which costs a dTLB miss per level.
+ *
+ * Nodes of at least hugePageThreshold bytes are therefore mapped with mmap,
+ * aligned to 2MB and either advised to use transparent huge pages or taken
+ * from the explicit huge page pool (MAP_HUGETLB, falling back to transparent
+ * huge pages if the pool is exhausted). With libnuma, mapped nodes above
+ * interleaveDepth are interleaved over all NUMA nodes (every thread searches
+ * them), and deeper mapped nodes can be bound to the NUMA node of the thread
+ * that builds them. Smaller nodes keep using ::operator new.
+ *
+ * The number of mapped bytes is recorded in the node itself, so the node's
+ * operator delete (invoked by the record manager) knows how to free it.
+ *
+ * (The dTLB misses can be counted with PAPI_TLB_DM: make papi_tlb=1.)
+ */
+
+#ifndef IST_NODE_PLACEMENT_H
+#define IST_NODE_PLACEMENT_H
+
+#include <sys/mman.h>
+#include <sched.h>
+#include <cstdint>
+#include <new>
+#ifdef USE_LIBNUMA
+#   include <numa.h>
+#endif
+
+#define IST_HUGE_PAGE_SIZE (2*1024*1024)
+
+struct ist_node_placement_policy {
+    size_t hugePageThreshold;   // in bytes; 0 disables mapping of large nodes
+    bool explicitHugePages;     // use MAP_HUGETLB instead of madvise(MADV_HUGEPAGE)
+    bool numaLocal;             // bind the other mapped nodes to the NUMA node of the allocating thread
+    size_t interleaveDepth;     // mapped nodes at depth < interleaveDepth are interleaved over all NUMA nodes
+
+    ist_node_placement_policy()
+    : hugePageThreshold(0), explicitHugePages(false), numaLocal(false), interleaveDepth(0) {}
+
+    /**
+     * returns NULL if a node of sz bytes should be allocated with ::operator new.
+     * otherwise, returns a 2MB aligned mapping and stores its length in mappedBytes.
+     */
+    void * map(const size_t sz, const size_t depth, size_t * mappedBytes) const {
+        if (hugePageThreshold == 0 || sz < hugePageThreshold) return NULL;
+        const size_t len = (sz + IST_HUGE_PAGE_SIZE - 1) & ~((size_t) IST_HUGE_PAGE_SIZE - 1);
+
+        void * p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (explicitHugePages) {
+            p = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if (p == MAP_FAILED) {
+            // over-allocate by one huge page, then trim to a 2MB boundary so THP can back the whole node
+            char * raw = (char *) mmap(NULL, len + IST_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) return NULL;
+            char * aligned = (char *) (((uintptr_t) raw + IST_HUGE_PAGE_SIZE - 1) & ~((uintptr_t) IST_HUGE_PAGE_SIZE - 1));
+            if (aligned > raw) munmap(raw, aligned - raw);
+            munmap(aligned + len, (raw + len + IST_HUGE_PAGE_SIZE) - (aligned + len));
+            p = aligned;
+#ifdef MADV_HUGEPAGE
+            madvise(p, len, MADV_HUGEPAGE);
+#endif
+        }
+
+#ifdef USE_LIBNUMA
+        // the policy must be set before the first touch (pages are populated when the builder writes the node)
+        if (numa_available() != -1) {
+            if (depth < interleaveDepth) {
+                numa_interleave_memory(p, len, numa_all_nodes_ptr);
+            } else if (numaLocal) {
+                const int node = numa_node_of_cpu(sched_getcpu());
+                if (node >= 0) numa_tonode_memory(p, len, node);
+            }
+        }
+#endif
+        *mappedBytes = len;
+        return p;
+    }
+
+    static void unmap(void * p, const size_t mappedBytes) {
+        munmap(p, mappedBytes);
+    }
+};
+
+#endif /* IST_NODE_PLACEMENT_H */
@@ -0,0 +1,51 @@
+/**
+ * Run-time rebuilding parameters of the interpolation search tree.
+ *
+ * A subtree is rebuilt once the number of updates in it since its last
+ * rebuild reaches rebuildFraction * rebuildScale * initSize, and subtrees of
+ * at most maxLeafSize keys are built as a single leaf.
+ *
+ * In adaptive mode, each rebuild decides the rebuildScale of the new subtree.
+ * A rebuild is considered wasted if the size of the subtree barely changed
+ * since the previous rebuild (e.g., uniform churn, where inserts and deletes
+ * cancel out and the ideal structure of the subtree hardly moves). Wasted
+ * rebuilds double the scale (up to maxRebuildScale), and useful rebuilds halve
+ * it again. Without adaptive mode the scale is always 1.
+ */
+
+#ifndef IST_REBUILD_POLICY_H
+#define IST_REBUILD_POLICY_H
+
+#include <cstddef>
+
+struct ist_rebuild_policy {
+    double rebuildFraction;         // default REBUILD_FRACTION
+    size_t maxLeafSize;             // default MAX_ACCEPTABLE_LEAF_SIZE
+    bool collaborativeMarkAndCount; // divide markAndCount work between helpers (see IST_DISABLE_COLLABORATIVE_MARK_AND_COUNT)
+    bool adaptive;
+    size_t maxRebuildScale;         // adaptive mode only
+    double wastedChangeFraction;    // adaptive mode only: rebuilds that changed the size by less than this fraction of the rebuild threshold are wasted
+
+    ist_rebuild_policy(const double _rebuildFraction, const size_t _maxLeafSize)
+    : rebuildFraction(_rebuildFraction)
+    , maxLeafSize(_maxLeafSize)
+    , collaborativeMarkAndCount(true)
+    , adaptive(false)
+    , maxRebuildScale(4)
+    , wastedChangeFraction(0.5) {}
+
+    bool isWasted(const size_t oldScale, const size_t oldInitSize, const size_t keyCount) const {
+        const double change = (keyCount > oldInitSize) ? keyCount - oldInitSize : oldInitSize - keyCount;
+        return change < wastedChangeFraction * rebuildFraction * oldScale * oldInitSize;
+    }
+
+    size_t nextRebuildScale(const size_t oldScale, const size_t oldInitSize, const size_t keyCount) const {
+        if (!adaptive) return 1;
+        if (isWasted(oldScale, oldInitSize, keyCount)) {
+            return (2*oldScale > maxRebuildScale) ? maxRebuildScale : 2*oldScale;
+        }
+        return (oldScale > 1) ? oldScale/2 : 1;
+    }
+};
+
+#endif /* IST_REBUILD_POLICY_H */
@@ -0,0 +1,122 @@
+/**
+ * Search kernels for the nodes of the interpolation search tree.
+ *
+ * istree<K,V,Interpolate,RecManager> searches inside a node by guessing the
+ * position of the key from minKey and maxKey, then scanning left or right from
+ * the guess. Interpolate provides both steps:
+ *
+ *   uint64_t factor(minKey, maxKey, numKeys)
+ *       precomputed per node when its key range is set (0 if unused)
+ *   int guess(key, minKey, maxKey, numKeys, factor)
+ *       position in [0, numKeys) for minKey <= key < maxKey
+ *   int scanLeft(keys, stride, from, key)
+ *       largest i <= from with keys[i*stride] <= key (exists: keys[0] <= key)
+ *   int scanRight(keys, stride, from, numKeys, key)
+ *       smallest i >= from with key < keys[i*stride] (exists: key < keys[numKeys-1])
+ *
+ * Interpolator is the original kernel (integer division and a scalar scan).
+ * FixedPointInterpolator replaces the division with a multiplication by a
+ * per-node Q63 reciprocal, and scans 64-bit keys with AVX-512 or AVX2 compares
+ * when the binary is compiled for them (e.g., -march=native) and the keys are
+ * contiguous (stride 1). Select it by compiling with
+ * -DIST_INTERPOLATOR=FixedPointInterpolator.
+ */
+
+#ifndef IST_SEARCH_KERNELS_H
+#define IST_SEARCH_KERNELS_H
+
+#include <cstdint>
+#include <type_traits>
+#if defined __AVX2__ || defined __AVX512F__
+#   include <immintrin.h>
+#endif
+
+template <typename K>
+class Interpolator {
+public:
+    int compare(const K& a, const K& b) {
+        return (a < b) ? -1 : (a > b) ? 1 : 0;
+    }
+    uint64_t factor(const K& minKey, const K& maxKey, const int numKeys) {
+        return 0;
+    }
+    int guess(const K& key, const K& minKey, const K& maxKey, const int numKeys, const uint64_t factor) {
+        return (numKeys * (key - minKey) / (maxKey - minKey));
+    }
+    int scanLeft(const K * const keys, const int stride, const int from, const K& key) {
+        for (int i=from;i>=0;--i) {
+            if (unlikely(key >= keys[i*stride])) return i;
+        }
+        assert(false); return -1;
+    }
+    int scanRight(const K * const keys, const int stride, const int from, const int numKeys, const K& key) {
+        for (int i=from;i<numKeys;++i) {
+            if (unlikely(key < keys[i*stride])) return i;
+        }
+        assert(false); return numKeys;
+    }
+};
+
+template <typename K>
+class FixedPointInterpolator : public Interpolator<K> {
+    static_assert(std::is_integral<K>::value, "FixedPointInterpolator requires integral keys");
+public:
+    // floor(numKeys * 2^63 / (maxKey - minKey)), so guess() never exceeds the exact quotient
+    // (Q63 keeps the precision for key ranges far wider than 2^32; only numKeys == 2 with
+    //  consecutive keys reaches 2^64, and rounding that down keeps the guess below numKeys)
+    uint64_t factor(const K& minKey, const K& maxKey, const int numKeys) {
+        if (!(minKey < maxKey)) return 0;
+        unsigned __int128 f = (((unsigned __int128) numKeys) << 63) / (uint64_t) (maxKey - minKey);
+        return (f > (unsigned __int128) UINT64_MAX) ? UINT64_MAX : (uint64_t) f;
+    }
+    int guess(const K& key, const K& minKey, const K& maxKey, const int numKeys, const uint64_t factor) {
+        return (int) ((((unsigned __int128) (uint64_t) (key - minKey)) * factor) >> 63);
+    }
+
+    int scanLeft(const K * const keys, const int stride, int from, const K& key) {
+#if defined __AVX512F__ || defined __AVX2__
+        if (sizeof(K) == 8 && std::is_signed<K>::value && stride == 1) {
+#   if defined __AVX512F__
+            const __m512i k = _mm512_set1_epi64((long long) key);
+            for (; from >= 7; from -= 8) {
+                // lanes with keys[i] <= key
+                __mmask8 le = _mm512_cmple_epi64_mask(_mm512_loadu_si512((const void *) (keys+from-7)), k);
+                if (le) return from-7 + (31 - __builtin_clz((unsigned) le));
+            }
+#   else
+            const __m256i k = _mm256_set1_epi64x((long long) key);
+            for (; from >= 3; from -= 4) {
+                __m256i gt = _mm256_cmpgt_epi64(_mm256_loadu_si256((const __m256i *) (keys+from-3)), k);
+                unsigned le = ~(unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(gt)) & 0xF;
+                if (le) return from-3 + (31 - __builtin_clz(le));
+            }
+#   endif
+        }
+#endif
+        return Interpolator<K>::scanLeft(keys, stride, from, key);
+    }
+
+    int scanRight(const K * const keys, const int stride, int from, const int numKeys, const K& key) {
+#if defined __AVX512F__ || defined __AVX2__
+        if (sizeof(K) == 8 && std::is_signed<K>::value && stride == 1) {
+#   if defined __AVX512F__
+            const __m512i k = _mm512_set1_epi64((long long) key);
+            for (; from+8 <= numKeys; from += 8) {
+                __mmask8 gt = _mm512_cmpgt_epi64_mask(_mm512_loadu_si512((const void *) (keys+from)), k);
+                if (gt) return from + __builtin_ctz((unsigned) gt);
+            }
+#   else
+            const __m256i k = _mm256_set1_epi64x((long long) key);
+            for (; from+4 <= numKeys; from += 4) {
+                __m256i gt = _mm256_cmpgt_epi64(_mm256_loadu_si256((const __m256i *) (keys+from)), k);
+                unsigned mask = (unsigned) _mm256_movemask_pd(_mm256_castsi256_pd(gt));
+                if (mask) return from + __builtin_ctz(mask);
+            }
+#   endif
+        }
+#endif
+        return Interpolator<K>::scanRight(keys, stride, from, numKeys, key);
+    }
+};
+
+#endif /* IST_SEARCH_KERNELS_H */
@@ -307,13 +307,49 @@ namespace ART_OLC {
     }
 
     N *N::setLeaf(TID tid) {
+        assert((tid & (static_cast<uint64_t>(1) << 62)) == 0);
         return reinterpret_cast<N *>(tid | (static_cast<uint64_t>(1) << 63));
     }
 
+    bool N::isInlineLeaf(const N *n) {
+        return (reinterpret_cast<uint64_t>(n) & (static_cast<uint64_t>(3) << 62)) == (static_cast<uint64_t>(3) << 62);
+    }
+
+    N *N::setInlineLeaf(Leaf *leaf) {
+        return reinterpret_cast<N *>(reinterpret_cast<uint64_t>(leaf) | (static_cast<uint64_t>(3) << 62));
+    }
+
+    Leaf *N::getInlineLeaf(const N *n) {
+        return reinterpret_cast<Leaf *>(reinterpret_cast<uint64_t>(n) & ((static_cast<uint64_t>(1) << 62) - 1));
+    }
+
     TID N::getLeaf(const N *n) {
+        if (isInlineLeaf(n)) {
+            return getInlineLeaf(n)->value;
+        }
         return (reinterpret_cast<uint64_t>(n) & ((static_cast<uint64_t>(1) << 63) - 1));
     }
 
+    void Leaf::set(const Key &k, TID tid) {
+        assert(fits(k));
+        value = tid;
+        keyLength = k.getKeyLen();
+        if (keyLength > 0) {
+            memcpy(key, &k[0], keyLength);
+        }
+    }
+
+    bool Leaf::matches(const Key &k) const {
+        if (k.getKeyLen() != keyLength) {
+            return false;
+        }
+        return keyLength == 0 || memcmp(key, &k[0], keyLength) == 0;
+    }
+
+    void Leaf::loadKey(Key &k) const {
+        k.set(reinterpret_cast<const char *>(key), keyLength);
+    }
+
     std::tuple<N *, uint8_t> N::getSecondChild(N *node, const uint8_t key) {
         switch (node->getType()) {
             case NTypes::N4: {
@@ -327,25 +363,31 @@ namespace ART_OLC {
         }
     }
 
-    TID N::getAnyChildTid(const N *n, bool &needRestart) {
+    const N *N::getAnyChildLeaf(const N *n, bool &needRestart) {
         const N *nextNode = n;
 
         while (true) {
             const N *node = nextNode;
             auto v = node->readLockOrRestart(needRestart);
-            if (needRestart) return 0;
+            if (needRestart) return nullptr;
 
             nextNode = getAnyChild(node);
             node->readUnlockOrRestart(v, needRestart);
-            if (needRestart) return 0;
+            if (needRestart) return nullptr;
 
             assert(nextNode != nullptr);
             if (isLeaf(nextNode)) {
-                return getLeaf(nextNode);
+                return nextNode;
             }
         }
     }
 
+    TID N::getAnyChildTid(const N *n, bool &needRestart) {
+        const N *leaf = getAnyChildLeaf(n, needRestart);
+        if (needRestart) return 0;
+        return getLeaf(leaf);
+    }
+
     uint64_t N::getChildren(const N *node, uint8_t start, uint8_t end, std::tuple<uint8_t, N *> children[],
                         uint32_t &childrenCount) {
         switch (node->getType()) {
@@ -28,10 +28,24 @@ namespace ART_OLC {
         N256 = 3
     };
 
-    static constexpr uint32_t maxStoredPrefixLength = 11;
+#ifndef ART_MAX_STORED_PREFIX_LENGTH
+#define ART_MAX_STORED_PREFIX_LENGTH 11
+#endif
+
+#ifndef ART_MAX_INLINE_KEY_LENGTH
+#define ART_MAX_INLINE_KEY_LENGTH 23
+#endif
+
+    /*
+     * prefix bytes beyond maxStoredPrefixLength are not stored in the node,
+     * they are checked optimistically and reconstructed from any leaf below it
+     */
+    static constexpr uint32_t maxStoredPrefixLength = ART_MAX_STORED_PREFIX_LENGTH;
 
     using Prefix = uint8_t[maxStoredPrefixLength];
 
+    class Leaf;
+
     class N {
     protected:
         N(NTypes type) {
@@ -106,14 +120,27 @@ namespace ART_OLC {
 
         uint32_t getPrefixLength() const;
 
+        /*
+         * a leaf is either a tagged TID (bit 63) whose key is reconstructed with the
+         * loadKey callback, or a tagged pointer (bits 63 and 62) to an inline Leaf
+         * that stores a short key next to its TID. TIDs must therefore fit in 62 bits.
+         */
         static TID getLeaf(const N *n);
 
         static bool isLeaf(const N *n);
 
         static N *setLeaf(TID tid);
 
+        static bool isInlineLeaf(const N *n);
+
+        static N *setInlineLeaf(Leaf *leaf);
+
+        static Leaf *getInlineLeaf(const N *n);
+
         static N *getAnyChild(const N *n);
 
+        static const N *getAnyChildLeaf(const N *n, bool &needRestart);
+
         static TID getAnyChildTid(const N *n, bool &needRestart);
 
         static std::tuple<N *, uint8_t> getSecondChild(N *node, const uint8_t k);
@@ -272,5 +299,31 @@ namespace ART_OLC {
         uint64_t getChildren(uint8_t start, uint8_t end, std::tuple<uint8_t, N *> *&children,
                          uint32_t &childrenCount) const;
     };
+
+    /*
+     * leaf that keeps a key of up to maxKeyLength bytes inline, so lookups can
+     * verify the key without calling loadKey. it is immutable once published:
+     * replacing the TID installs a new leaf.
+     */
+    class Leaf {
+    public:
+        static constexpr uint32_t maxKeyLength = ART_MAX_INLINE_KEY_LENGTH;
+
+        TID value = 0;
+        uint8_t keyLength = 0;
+        uint8_t key[maxKeyLength];
+
+        Leaf() { }
+
+        static bool fits(const Key &k) {
+            return k.getKeyLen() <= maxKeyLength;
+        }
+
+        void set(const Key &k, TID tid);
+
+        bool matches(const Key &k) const;
+
+        void loadKey(Key &k) const;
+    };
 }
 #endif //ART_OPTIMISTIC_LOCK_COUPLING_N_H
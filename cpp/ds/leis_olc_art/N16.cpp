@@ -86,17 +86,14 @@ namespace ART_OLC {
         v = readLockOrRestart(needRestart);
         if (needRestart) goto restart;
         childrenCount = 0;
-        auto startPos = getChildPos(start);
-        auto endPos = getChildPos(end);
-        if (startPos == nullptr) {
-            startPos = this->children;
-        }
-        if (endPos == nullptr) {
-            endPos = this->children + (count - 1);
-        }
-        for (auto p = startPos; p <= endPos; ++p) {
-            children[childrenCount] = std::make_tuple(flipSign(keys[p - this->children]), *p);
-            childrenCount++;
+        // keys are kept sorted, but start and end need not be present in the node,
+        // so filter every slot instead of looking up the boundary positions
+        for (uint32_t i = 0; i < count; ++i) {
+            const uint8_t key = flipSign(this->keys[i]);
+            if (key >= start && key <= end) {
+                children[childrenCount] = std::make_tuple(key, this->children[i]);
+                childrenCount++;
+            }
         }
         readUnlockOrRestart(v, needRestart);
         if (needRestart) goto restart;
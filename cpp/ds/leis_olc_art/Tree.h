@@ -26,6 +26,35 @@ namespace ART_OLC {
 
         LoadKeyFunction loadKey;
 
+        const bool inlineLeaves;
+
+        enum class ScanResult : uint8_t {
+            Continue,
+            Full,
+            Restart
+        };
+
+        bool insertInternal(const int threadID, const Key &k, TID tid, bool replace, TID &previous);
+
+        N *newLeaf(const int threadID, const Key &k, TID tid);
+
+        void deallocateLeaf(const int threadID, N *leaf);
+
+        void retireLeaf(const int threadID, N *leaf);
+
+        static void loadLeafKey(const N *leaf, Key &key, LoadKeyFunction loadKey);
+
+        ScanResult scanRange(const N *node, const N *parentNode, uint64_t parentVersion, uint32_t level,
+                             bool onStart, bool onEnd, const Key &start, bool startExclusive, const Key &end,
+                             TID result[], std::size_t resultSize, std::size_t &resultsFound,
+                             const N *&lastLeaf, const N *&toContinue) const;
+
+        ScanResult scanLeaf(const N *leaf, bool onStart, bool onEnd, const Key &start, bool startExclusive, const Key &end,
+                            TID result[], std::size_t resultSize, std::size_t &resultsFound,
+                            const N *&lastLeaf, const N *&toContinue) const;
+
+        static int compareKeys(const Key &a, const Key &b);
+
     public:
         enum class CheckPrefixResult : uint8_t {
             Match,
@@ -60,12 +89,24 @@ namespace ART_OLC {
         static PCEqualsResults checkPrefixEquals(const N* n, uint32_t &level, const Key &start, const Key &end, LoadKeyFunction loadKey, bool &needRestart);
 
     public:
+        struct NodeCounts {
+            size_t n4 = 0;
+            size_t n16 = 0;
+            size_t n48 = 0;
+            size_t n256 = 0;
+            size_t tidLeaves = 0;
+            size_t inlineLeaves = 0;
+        };
 
-        Tree(const int numThreads, LoadKeyFunction loadKey);
+        /**
+         * if inlineLeaves is set, keys of at most Leaf::maxKeyLength bytes are stored in
+         * inline leaves, so lookups and structural changes never call loadKey for them
+         */
+        Tree(const int numThreads, LoadKeyFunction loadKey, bool inlineLeaves = false);
 
         Tree(const Tree &) = delete;
 
-        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey) { }
+        Tree(Tree &&t) : root(t.root), loadKey(t.loadKey), inlineLeaves(t.inlineLeaves) { }
 
         ~Tree();
 
@@ -79,17 +120,39 @@ namespace ART_OLC {
 
         bool insert(const int threadID, const Key &k, TID tid);
 
+        /**
+         * inserts (k, tid), replacing the tid stored for k if it is already present.
+         * returns true if k was not present; otherwise, previous is set to the replaced tid.
+         */
+        bool insertOrReplace(const int threadID, const Key &k, TID tid, TID &previous);
+
+        /**
+         * copies the tids of all keys in [start, end] into result, in key order.
+         * if more than resultSize keys are in range, the scan stops after resultSize
+         * results, continueKey is set to the first key that was not copied and true is returned.
+         */
+        bool lookupRange(const int threadID, const Key &start, const Key &end, Key &continueKey,
+                         TID result[], std::size_t resultSize, std::size_t &resultsFound) const;
+
         bool remove(const int threadID, const Key &k, TID tid);
 
         N* alloc(const int threadID, NTypes type);
 
+        /**
+         * counts nodes by type. must only be called while no other thread modifies the tree.
+         */
+        NodeCounts getNodeCounts() const;
+
+        void countNodes(const N *node, NodeCounts &counts) const;
+
         N* const getRoot() {
             return root;
         }
     };
 
     template <class RecordManager>
-    Tree<RecordManager>::Tree(const int numThreads, LoadKeyFunction loadKey) : recmgr(new RecordManager(numThreads)), loadKey(loadKey) {
+    Tree<RecordManager>::Tree(const int numThreads, LoadKeyFunction loadKey, bool inlineLeaves)
+            : recmgr(new RecordManager(numThreads)), loadKey(loadKey), inlineLeaves(inlineLeaves) {
         const int threadID = 0;
         initThread(threadID);
         root = recmgr->template allocate<N256>(threadID);
@@ -107,6 +170,9 @@ namespace ART_OLC {
     template <class RecordManager>
     void Tree<RecordManager>::cleanup(N* node) {
         if (N::isLeaf(node)) {
+            if (N::isInlineLeaf(node)) {
+                recmgr->deallocate(0, N::getInlineLeaf(node));
+            }
             return;
         }
         switch (node->getType()) {
@@ -199,6 +265,10 @@ namespace ART_OLC {
                         parentNode->readUnlockOrRestart(v, needRestart);
                         if (needRestart) goto restart;
 
+                        if (N::isInlineLeaf(node)) {
+                            const Leaf *leaf = N::getInlineLeaf(node);
+                            return leaf->matches(k) ? leaf->value : 0;
+                        }
                         TID tid = N::getLeaf(node);
                         if (level < k.getKeyLen() - 1 || optimisticPrefixMatch) {
                             return checkKey(tid, k);
@@ -230,6 +300,20 @@ namespace ART_OLC {
 
     template <class RecordManager>
     bool Tree<RecordManager>::insert(const int threadID, const Key &k, TID tid) {
+        TID previous;
+        return insertInternal(threadID, k, tid, false, previous);
+    }
+
+    template <class RecordManager>
+    bool Tree<RecordManager>::insertOrReplace(const int threadID, const Key &k, TID tid, TID &previous) {
+        return insertInternal(threadID, k, tid, true, previous);
+    }
+
+    template <class RecordManager>
+    bool Tree<RecordManager>::insertInternal(const int threadID, const Key &k, TID tid, bool replace, TID &previous) {
+        // created once, before the first attempt, so restarts do not allocate again
+        N *leaf = newLeaf(threadID, k, tid);
+
         restart:
         auto guard = recmgr->getGuard(threadID);
         bool needRestart = false;
@@ -270,7 +354,7 @@ namespace ART_OLC {
                     newNode->setPrefix(node->getPrefix(), nextLevel - level);
 
                     // 2)  add node and (tid, *k) as children
-                    newNode->insert(k[nextLevel], N::setLeaf(tid)); // Anubhav: Looks like k has to be malloc'd
+                    newNode->insert(k[nextLevel], leaf); // Anubhav: Looks like k has to be malloc'd
                     newNode->insert(nonMatchingKey, node);
 
                     // 3) upgradeToWriteLockOrRestart, update parentNode to point to the new node, unlock
@@ -294,7 +378,7 @@ namespace ART_OLC {
             if (needRestart) goto restart;
 
             if (nextNode == nullptr) {
-                N::insertAndUnlock(threadID, recmgr, node, v, parentNode, parentVersion, parentKey, nodeKey, N::setLeaf(tid), needRestart);
+                N::insertAndUnlock(threadID, recmgr, node, v, parentNode, parentVersion, parentKey, nodeKey, leaf, needRestart);
                 if (needRestart) goto restart;
                 return true;
             }
@@ -305,16 +389,33 @@ namespace ART_OLC {
             }
 
             if (N::isLeaf(nextNode)) {
-                if (N::getLeaf(nextNode) == tid) {
+                // (a replace must swap the leaf even if it stores the same tid)
+                if (!replace && !N::isInlineLeaf(nextNode) && N::getLeaf(nextNode) == tid) {
+                    previous = tid;
+                    deallocateLeaf(threadID, leaf);
+                    return false;
+                }
+
+                Key key;
+                loadLeafKey(nextNode, key, loadKey);
+                if (key == k) {
+                    previous = N::getLeaf(nextNode);
+                    if (!replace) {
+                        deallocateLeaf(threadID, leaf);
+                        return false;
+                    }
+                    node->upgradeToWriteLockOrRestart(v, needRestart);
+                    if (needRestart) goto restart;
+
+                    N::change(node, k[level], leaf);
+                    node->writeUnlock();
+                    retireLeaf(threadID, nextNode);
                     return false;
                 }
 
                 node->upgradeToWriteLockOrRestart(v, needRestart);
                 if (needRestart) goto restart;
 
-                Key key;
-                loadKey(N::getLeaf(nextNode), key);
-
                 level++;
                 uint32_t prefixLength = 0;
                 // Anubhav: Are key and k null-terminated? If not, isn't this unsafe array access?
@@ -324,7 +425,7 @@ namespace ART_OLC {
 
                 N4* n4 = recmgr->template allocate<N4>(threadID);
                 n4->setPrefix(&k[level], prefixLength);
-                n4->insert(k[level + prefixLength], N::setLeaf(tid));
+                n4->insert(k[level + prefixLength], leaf);
                 n4->insert(key[level + prefixLength], nextNode);
                 N::change(node, k[level - 1], n4);
                 node->writeUnlock();
@@ -375,7 +476,8 @@ namespace ART_OLC {
                         return false;
                     }
                     if (N::isLeaf(nextNode)) {
-                        if (N::getLeaf(nextNode) != tid) {
+                        if (N::isInlineLeaf(nextNode) ? !N::getInlineLeaf(nextNode)->matches(k)
+                                                      : N::getLeaf(nextNode) != tid) {
                             return false;
                         }
                         assert(parentNode == nullptr || node->getCount() != 1);
@@ -421,6 +523,7 @@ namespace ART_OLC {
                             N::removeAndUnlock(threadID, recmgr, node, v, k[level], parentNode, parentVersion, parentKey, needRestart);
                             if (needRestart) goto restart;
                         }
+                        retireLeaf(threadID, nextNode);
                         return true;
                     }
                     level++;
@@ -430,6 +533,202 @@ namespace ART_OLC {
         }
     }
 
+    template <class RecordManager>
+    bool Tree<RecordManager>::lookupRange(const int threadID, const Key &start, const Key &end, Key &continueKey,
+                                          TID result[], std::size_t resultSize, std::size_t &resultsFound) const {
+        resultsFound = 0;
+        if (resultSize == 0 || compareKeys(start, end) > 0) {
+            return false;
+        }
+
+        // after a failed validation the scan is resumed from the root, strictly after the last copied key,
+        // so results that were already produced are kept and never duplicated
+        Key resumeKey;
+        bool resume = false;
+        const N *lastLeaf = nullptr;
+        const N *toContinue = nullptr;
+
+        restart:
+        auto guard = recmgr->getGuard(threadID);
+        const Key &from = resume ? resumeKey : start;
+        switch (scanRange(root, nullptr, 0, 0, true, true, from, resume, end,
+                          result, resultSize, resultsFound, lastLeaf, toContinue)) {
+            case ScanResult::Restart:
+                // lastLeaf is still protected by the guard here
+                if (lastLeaf != nullptr) {
+                    loadLeafKey(lastLeaf, resumeKey, loadKey);
+                    resume = true;
+                }
+                goto restart;
+            case ScanResult::Full:
+                loadLeafKey(toContinue, continueKey, loadKey);
+                return true;
+            case ScanResult::Continue:
+                break;
+        }
+        return false;
+    }
+
+    template <class RecordManager>
+    typename Tree<RecordManager>::ScanResult Tree<RecordManager>::scanRange(
+            const N *node, const N *parentNode, uint64_t parentVersion, uint32_t level,
+            bool onStart, bool onEnd, const Key &start, bool startExclusive, const Key &end,
+            TID result[], std::size_t resultSize, std::size_t &resultsFound,
+            const N *&lastLeaf, const N *&toContinue) const {
+        bool needRestart = false;
+        uint64_t v = node->readLockOrRestart(needRestart);
+        if (needRestart) return ScanResult::Restart;
+
+        // lock coupling: node must still be the child of parentNode when we start reading it
+        if (parentNode != nullptr) {
+            parentNode->readUnlockOrRestart(parentVersion, needRestart);
+            if (needRestart) return ScanResult::Restart;
+        }
+
+        // prune the subtree using the compressed prefix, while it lies on a range boundary
+        if (onStart) {
+            uint32_t startLevel = level;
+            auto res = checkPrefixCompare(node, start, 0, startLevel, loadKey, needRestart);
+            if (needRestart) return ScanResult::Restart;
+            if (res == PCCompareResults::Smaller) return ScanResult::Continue;
+            if (res == PCCompareResults::Bigger) onStart = false;
+        }
+        if (onEnd) {
+            uint32_t endLevel = level;
+            auto res = checkPrefixCompare(node, end, 255, endLevel, loadKey, needRestart);
+            if (needRestart) return ScanResult::Restart;
+            if (res == PCCompareResults::Bigger) return ScanResult::Continue;
+            if (res == PCCompareResults::Smaller) onEnd = false;
+        }
+        level += node->getPrefixLength();
+
+        uint8_t lo = (onStart && start.getKeyLen() > level) ? start[level] : 0;
+        uint8_t hi = (onEnd && end.getKeyLen() > level) ? end[level] : 255;
+        std::tuple<uint8_t, N *> children[256];
+        uint32_t childrenCount = 0;
+        if (N::getChildren(node, lo, hi, children, childrenCount) != v) {
+            return ScanResult::Restart;
+        }
+
+        for (uint32_t i = 0; i < childrenCount; ++i) {
+            const uint8_t childKey = std::get<0>(children[i]);
+            const N *child = std::get<1>(children[i]);
+            const bool childOnStart = onStart && childKey == lo;
+            const bool childOnEnd = onEnd && childKey == hi;
+            ScanResult res;
+            if (N::isLeaf(child)) {
+                res = scanLeaf(child, childOnStart, childOnEnd, start, startExclusive, end,
+                               result, resultSize, resultsFound, lastLeaf, toContinue);
+            } else {
+                res = scanRange(child, node, v, level + 1, childOnStart, childOnEnd, start, startExclusive, end,
+                                result, resultSize, resultsFound, lastLeaf, toContinue);
+            }
+            if (res != ScanResult::Continue) return res;
+        }
+        return ScanResult::Continue;
+    }
+
+    template <class RecordManager>
+    typename Tree<RecordManager>::ScanResult Tree<RecordManager>::scanLeaf(
+            const N *leaf, bool onStart, bool onEnd, const Key &start, bool startExclusive, const Key &end,
+            TID result[], std::size_t resultSize, std::size_t &resultsFound,
+            const N *&lastLeaf, const N *&toContinue) const {
+        // leaves are stored at their first distinguishing byte, so a leaf on a boundary
+        // has to be compared against the full bound
+        if (onStart || onEnd) {
+            Key kt;
+            loadLeafKey(leaf, kt, loadKey);
+            if (onStart) {
+                int c = compareKeys(kt, start);
+                if (c < 0 || (c == 0 && startExclusive)) return ScanResult::Continue;
+            }
+            if (onEnd && compareKeys(kt, end) > 0) return ScanResult::Continue;
+        }
+        if (resultsFound == resultSize) {
+            toContinue = leaf;
+            return ScanResult::Full;
+        }
+        result[resultsFound++] = N::getLeaf(leaf);
+        lastLeaf = leaf;
+        return ScanResult::Continue;
+    }
+
+    template <class RecordManager>
+    int Tree<RecordManager>::compareKeys(const Key &a, const Key &b) {
+        const uint32_t len = std::min(a.getKeyLen(), b.getKeyLen());
+        for (uint32_t i = 0; i < len; ++i) {
+            if (a[i] != b[i]) {
+                return a[i] < b[i] ? -1 : 1;
+            }
+        }
+        if (a.getKeyLen() == b.getKeyLen()) return 0;
+        return a.getKeyLen() < b.getKeyLen() ? -1 : 1;
+    }
+
+    template <class RecordManager>
+    N *Tree<RecordManager>::newLeaf(const int threadID, const Key &k, TID tid) {
+        if (!inlineLeaves || !Leaf::fits(k)) {
+            return N::setLeaf(tid);
+        }
+        Leaf *leaf = recmgr->template allocate<Leaf>(threadID);
+        leaf->set(k, tid);
+        return N::setInlineLeaf(leaf);
+    }
+
+    template <class RecordManager>
+    void Tree<RecordManager>::deallocateLeaf(const int threadID, N *leaf) {
+        if (N::isInlineLeaf(leaf)) {
+            recmgr->deallocate(threadID, N::getInlineLeaf(leaf));
+        }
+    }
+
+    template <class RecordManager>
+    void Tree<RecordManager>::retireLeaf(const int threadID, N *leaf) {
+        if (N::isInlineLeaf(leaf)) {
+            recmgr->retire(threadID, N::getInlineLeaf(leaf));
+        }
+    }
+
+    template <class RecordManager>
+    void Tree<RecordManager>::loadLeafKey(const N *leaf, Key &key, LoadKeyFunction loadKey) {
+        if (N::isInlineLeaf(leaf)) {
+            N::getInlineLeaf(leaf)->loadKey(key);
+        } else {
+            loadKey(N::getLeaf(leaf), key);
+        }
+    }
+
+    template <class RecordManager>
+    typename Tree<RecordManager>::NodeCounts Tree<RecordManager>::getNodeCounts() const {
+        NodeCounts counts;
+        countNodes(root, counts);
+        return counts;
+    }
+
+    template <class RecordManager>
+    void Tree<RecordManager>::countNodes(const N *node, NodeCounts &counts) const {
+        if (N::isLeaf(node)) {
+            if (N::isInlineLeaf(node)) {
+                counts.inlineLeaves++;
+            } else {
+                counts.tidLeaves++;
+            }
+            return;
+        }
+        switch (node->getType()) {
+            case NTypes::N4: counts.n4++; break;
+            case NTypes::N16: counts.n16++; break;
+            case NTypes::N48: counts.n48++; break;
+            case NTypes::N256: counts.n256++; break;
+        }
+        std::tuple<uint8_t, N *> children[256];
+        uint32_t childrenCount = 0;
+        N::getChildren(node, 0u, 255u, children, childrenCount);
+        for (uint32_t i = 0; i < childrenCount; ++i) {
+            countNodes(std::get<1>(children[i]), counts);
+        }
+    }
+
     template <class RecordManager>
     N* Tree<RecordManager>::alloc(const int threadID, NTypes type) {
         switch (type) {
@@ -474,18 +773,18 @@ namespace ART_OLC {
             Key kt;
             for (uint32_t i = 0; i < n->getPrefixLength(); ++i) {
                 if (i == maxStoredPrefixLength) {
-                    auto anyTID = N::getAnyChildTid(n, needRestart);
+                    auto anyLeaf = N::getAnyChildLeaf(n, needRestart);
                     if (needRestart) return CheckPrefixPessimisticResult::Match;
-                    loadKey(anyTID, kt);
+                    loadLeafKey(anyLeaf, kt, loadKey);
                 }
                 uint8_t curKey = i >= maxStoredPrefixLength ? kt[level] : n->getPrefix()[i];
                 if (curKey != k[level]) {
                     nonMatchingKey = curKey;
                     if (n->getPrefixLength() > maxStoredPrefixLength) {
                         if (i < maxStoredPrefixLength) {
-                            auto anyTID = N::getAnyChildTid(n, needRestart);
+                            auto anyLeaf = N::getAnyChildLeaf(n, needRestart);
                             if (needRestart) return CheckPrefixPessimisticResult::Match;
-                            loadKey(anyTID, kt);
+                            loadLeafKey(anyLeaf, kt, loadKey);
                         }
                         memcpy(nonMatchingPrefix, &kt[0] + level + 1, std::min((n->getPrefixLength() - (level - prevLevel) - 1),
                                                                            maxStoredPrefixLength));
@@ -507,9 +806,9 @@ namespace ART_OLC {
             Key kt;
             for (uint32_t i = 0; i < n->getPrefixLength(); ++i) {
                 if (i == maxStoredPrefixLength) {
-                    auto anyTID = N::getAnyChildTid(n, needRestart);
+                    auto anyLeaf = N::getAnyChildLeaf(n, needRestart);
                     if (needRestart) return PCCompareResults::Equal;
-                    loadKey(anyTID, kt);
+                    loadLeafKey(anyLeaf, kt, loadKey);
                 }
                 uint8_t kLevel = (k.getKeyLen() > level) ? k[level] : fillKey;
 
@@ -532,9 +831,9 @@ namespace ART_OLC {
             Key kt;
             for (uint32_t i = 0; i < n->getPrefixLength(); ++i) {
                 if (i == maxStoredPrefixLength) {
-                    auto anyTID = N::getAnyChildTid(n, needRestart);
+                    auto anyLeaf = N::getAnyChildLeaf(n, needRestart);
                     if (needRestart) return PCEqualsResults::BothMatch;
-                    loadKey(anyTID, kt);
+                    loadLeafKey(anyLeaf, kt, loadKey);
                 }
                 uint8_t startLevel = (start.getKeyLen() > level) ? start[level] : 0;
                 uint8_t endLevel = (end.getKeyLen() > level) ? end[level] : 255;
@@ -18,9 +18,23 @@ using namespace std;
 #include "Tree.h"
 #include "N.h"
 
-#define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, ART_OLC::N4, ART_OLC::N16, ART_OLC::N48, ART_OLC::N256>
+#define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, ART_OLC::N4, ART_OLC::N16, ART_OLC::N48, ART_OLC::N256, ART_OLC::Leaf>
 #define DATA_STRUCTURE_T ART_OLC::Tree<RECORD_MANAGER_T>
 
+#ifndef RANGE_QUERY_CHUNK
+#define RANGE_QUERY_CHUNK 256
+#endif
+
+/**
+ * compile with -DART_INLINE_LEAVES to store keys of up to ART_MAX_INLINE_KEY_LENGTH bytes
+ * in inline leaves instead of reconstructing them from the TID with loadKey
+ */
+#ifdef ART_INLINE_LEAVES
+#define ART_USE_INLINE_LEAVES true
+#else
+#define ART_USE_INLINE_LEAVES false
+#endif
+
 
 void loadKey(TID tid, Key &key) {
     // Store the key of the tuple into the key vector
@@ -42,7 +56,7 @@ public:
                const V& VALUE_RESERVED,
                Random64 * const unused2)
             : NO_VALUE(VALUE_RESERVED)
-            , ds(new DATA_STRUCTURE_T(NUM_THREADS, loadKey))
+            , ds(new DATA_STRUCTURE_T(NUM_THREADS, loadKey, ART_USE_INLINE_LEAVES))
     { }
 
     ~ds_adapter() {
@@ -62,7 +76,11 @@ public:
     }
 
     V insert(const int threadID, const K& key, const V& val) {
-        setbench_error("insert-replace functionality not implemented for this data structure");
+        Key treeKey;
+        loadKey(key, treeKey);
+        TID previous;
+        if (ds->insertOrReplace(threadID, treeKey, key, previous)) return NO_VALUE;
+        return (V)previous;
     }
 
     V insertIfAbsent(const int threadID, const K& key, const V& val) {
@@ -90,14 +108,55 @@ public:
     }
 
     int rangeQuery(const int threadID, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
-        setbench_error("not implemented");
+        if (lo > hi) return 0;
+        // the tree produces tids, so scan in chunks and convert each chunk into keys and values
+        TID tids[RANGE_QUERY_CHUNK];
+        Key start, end, continueKey;
+        loadKey(lo, start);
+        loadKey(hi, end);
+        int count = 0;
+        while (true) {
+            size_t found = 0;
+            bool more = ds->lookupRange(threadID, start, end, continueKey, tids, RANGE_QUERY_CHUNK, found);
+            for (size_t i = 0; i < found; ++i) {
+                resultKeys[count] = (K)tids[i];
+                resultValues[count] = (V)tids[i];
+                ++count;
+            }
+            if (!more) break;
+            start.set(reinterpret_cast<const char *>(&continueKey[0]), continueKey.getKeyLen());
+        }
+        return count;
     }
 
     void printSummary() {
 //        ds->printDebuggingDetails();
+        printNodeMix();
     }
 
     void printObjectSizes() {
+        std::cout<<"size_n4="<<sizeof(ART_OLC::N4)<<std::endl;
+        std::cout<<"size_n16="<<sizeof(ART_OLC::N16)<<std::endl;
+        std::cout<<"size_n48="<<sizeof(ART_OLC::N48)<<std::endl;
+        std::cout<<"size_n256="<<sizeof(ART_OLC::N256)<<std::endl;
+        std::cout<<"size_inline_leaf="<<sizeof(ART_OLC::Leaf)<<std::endl;
+        std::cout<<"inline_leaves="<<ART_USE_INLINE_LEAVES<<std::endl;
+        std::cout<<"max_inline_key_length="<<ART_OLC::Leaf::maxKeyLength<<std::endl;
+        std::cout<<"max_stored_prefix_length="<<ART_OLC::maxStoredPrefixLength<<std::endl;
+    }
+
+    void printNodeMix() {
+        auto counts = ds->getNodeCounts();
+        size_t bytes = counts.n4 * sizeof(ART_OLC::N4) + counts.n16 * sizeof(ART_OLC::N16)
+                     + counts.n48 * sizeof(ART_OLC::N48) + counts.n256 * sizeof(ART_OLC::N256)
+                     + counts.inlineLeaves * sizeof(ART_OLC::Leaf);
+        std::cout<<"node_mix_n4="<<counts.n4<<std::endl;
+        std::cout<<"node_mix_n16="<<counts.n16<<std::endl;
+        std::cout<<"node_mix_n48="<<counts.n48<<std::endl;
+        std::cout<<"node_mix_n256="<<counts.n256<<std::endl;
+        std::cout<<"node_mix_tid_leaves="<<counts.tidLeaves<<std::endl;
+        std::cout<<"node_mix_inline_leaves="<<counts.inlineLeaves<<std::endl;
+        std::cout<<"node_mix_total_bytes="<<bytes<<std::endl;
     }
 
     bool validateStructure() {
@@ -13,6 +13,7 @@
 #include <iostream>
 #include <csignal>
 #include "errors.h"
+#include "ds_parameters.h"
 #include "record_manager.h"
 #ifdef USE_TREE_STATS
 #   include "tree_stats.h"
@@ -31,6 +32,53 @@ private:
     const V NO_VALUE;
     DATA_STRUCTURE_T * const ds;
 
+    /**
+     * kcas.backend selects how each KCAS is executed when compiled with KCAS_HTM:
+     * "htm" (kcas.htmAttempts transactions, then the lock-free algorithm),
+     * "adaptive" (the same, backing off from HTM after fallbacks, see kcas_htm_policy.h)
+     * or "lockfree" (descriptors only). Other KCAS_TYPEs only support "lockfree".
+     */
+    static void configureKCAS() {
+        const std::string backend = ds_parameters::get<std::string>("kcas.backend", KCAS_TYPE == std::string("KCAS_HTM") ? "htm" : "lockfree");
+        if (backend != "htm" && backend != "adaptive" && backend != "lockfree") {
+            setbench_error("kcas.backend must be one of htm, adaptive, lockfree");
+        }
+#if defined KCAS_HTM
+        kcas_htm_policy policy;
+        policy.htmAttempts = ds_parameters::get<int>("kcas.htmAttempts", policy.htmAttempts);
+        policy.adaptive = (backend == "adaptive");
+        policy.maxSkip = ds_parameters::get<int>("kcas.maxSkip", policy.maxSkip);
+        if (policy.htmAttempts < 0 || policy.maxSkip < 1) {
+            setbench_error("kcas.htmAttempts must be non-negative and kcas.maxSkip positive");
+        }
+        if (backend == "lockfree") policy.htmAttempts = 0;
+        kcas::setHtmPolicy(policy);
+#else
+        if (backend != "lockfree") {
+            setbench_error("kcas.backend=" << backend << " requires compiling with KCAS_HTM (this binary uses " << KCAS_TYPE << ")");
+        }
+#endif
+    }
+
+    static kcas_avl_rebalance_policy rebalancePolicyFromParameters() {
+        kcas_avl_rebalance_policy policy;
+        policy.relaxed = ds_parameters::get<bool>("kcasavl.relaxedRebalancing", policy.relaxed);
+        policy.maxPending = ds_parameters::get<int>("kcasavl.maxPendingRebalances", policy.maxPending);
+        policy.maxDepth = ds_parameters::get<int>("kcasavl.relaxedMaxDepth", policy.maxDepth);
+        if (policy.maxPending < 1 || policy.maxPending > MAX_PENDING_REBALANCES) {
+            setbench_error("kcasavl.maxPendingRebalances must be between 1 and " << MAX_PENDING_REBALANCES);
+        }
+        if (policy.maxDepth < 1 || policy.maxDepth >= MAX_PATH_SIZE - 1) {
+            setbench_error("kcasavl.relaxedMaxDepth must be between 1 and " << (MAX_PATH_SIZE - 2));
+        }
+        return policy;
+    }
+
+    static DATA_STRUCTURE_T * createDataStructure(const int NUM_THREADS, const K& KEY_MIN, const K& KEY_MAX) {
+        configureKCAS();
+        return new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, rebalancePolicyFromParameters());
+    }
+
 public:
     ds_adapter(const int NUM_THREADS,
                const K& KEY_MIN,
@@ -38,7 +86,7 @@ public:
                const V& VALUE_RESERVED,
                Random64 * const unused2)
     : NO_VALUE(VALUE_RESERVED)
-    , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX))
+    , ds(createDataStructure(NUM_THREADS, KEY_MIN, KEY_MAX))
     { }
 
     ~ds_adapter() {
@@ -79,6 +127,18 @@ public:
         setbench_error("not implemented");
     }
     void printSummary() {
+#if defined KCAS_HTM
+        const kcas_htm_policy &policy = kcas::getHtmPolicy();
+        std::cout<<"kcas_htm_attempts="<<policy.htmAttempts<<std::endl;
+        std::cout<<"kcas_htm_adaptive="<<policy.adaptive<<std::endl;
+        std::cout<<"kcas_rtm_supported="<<kcas_htm_policy::rtmSupported()<<std::endl;
+#endif
+        const kcas_avl_rebalance_policy rebalancePolicy = rebalancePolicyFromParameters();
+        std::cout<<"relaxed_rebalancing="<<rebalancePolicy.relaxed<<std::endl;
+        if (rebalancePolicy.relaxed) {
+            std::cout<<"max_pending_rebalances="<<rebalancePolicy.maxPending<<std::endl;
+            std::cout<<"relaxed_max_depth="<<rebalancePolicy.maxDepth<<std::endl;
+        }
         ds->printDebuggingDetails();
     }
     bool validateStructure() {
@@ -16,11 +16,127 @@
 using namespace std;
 
 #define MAX_THREADS 200
+#ifndef MAX_PATH_SIZE
 #define MAX_PATH_SIZE 64
+#endif
+#define MAX_PENDING_REBALANCES 64
 #define PADDING_BYTES 128
 
 #define IS_MARKED(word) (word & 0x1)
 
+#define KCAS_RETRY_HISTOGRAM_SIZE 64
+
+// KCAS_AVL_DEPTH_STATS (opt-in, since it adds stores to every search) adds the
+// depth of the keys found by contains() to the KEY_DEPTH_TOTAL_STAT totals
+#ifdef KCAS_AVL_DEPTH_STATS
+#   ifndef KEY_DEPTH_TOTAL_STAT
+#       error KCAS_AVL_DEPTH_STATS needs KEY_DEPTH_TOTAL_STAT
+#   endif
+#   define KCAS_AVL_TRACKS_SEARCH_DEPTH true
+#else
+#   define KCAS_AVL_TRACKS_SEARCH_DEPTH false
+#endif
+
+// KCAS_AVL_KCAS_STATS (opt-in, since it adds GSTATS updates to every KCAS)
+// fills the kcas_* stats below (widths, failures and HTM outcomes by type)
+
+/**
+ * kinds of KCAS operations performed by the tree (index of the kcas_*_by_type stats)
+ */
+enum KCASType: int {
+    KCAS_INSERT = 0,
+    KCAS_ERASE = 1,
+    KCAS_FIX_HEIGHT = 2,
+    KCAS_ROTATE = 3,
+    KCAS_DOUBLE_ROTATE = 4,
+    KCAS_NUM_TYPES = 5
+};
+
+#include "key_stats.h"
+
+/**
+ * Rebalancing of the tree after updates.
+ *
+ * In strict mode (the default) every update calls fixHeightAndRebalance on its
+ * way out, so heights and balance are fixed before the update returns.
+ *
+ * In relaxed mode an update only records the key of the node where its
+ * rebalancing would start, and the thread fixes all of its recorded keys in
+ * one pass once maxPending of them accumulated (and when it leaves the data
+ * structure). Fixes that start below a common ancestor then stop at the first
+ * ancestor whose height is already correct, so a hot region pays for its
+ * ancestors' height updates once per batch instead of once per update.
+ *
+ * The height violation is bounded: an insert whose new node would be deeper
+ * than maxDepth rebalances immediately, so deferred inserts never create
+ * nodes below maxDepth (which must leave room for the path of a strict AVL
+ * tree below MAX_PATH_SIZE), and each thread has at most maxPending deferred
+ * updates whose heights are not yet propagated.
+ */
+struct kcas_avl_rebalance_policy {
+    bool relaxed;
+    int maxPending;     // relaxed mode only, at most MAX_PENDING_REBALANCES
+    int maxDepth;       // relaxed mode only
+
+    kcas_avl_rebalance_policy()
+    : relaxed(false), maxPending(16), maxDepth(MAX_PATH_SIZE / 2) {}
+};
+
+#ifdef GSTATS_HANDLE_STATS
+#   ifndef __AND
+#      define __AND ,
+#   endif
+#   define GSTATS_HANDLE_STATS_SIGOUIN_INT_BST_KCAS(gstats_handle_stat) \
+        gstats_handle_stat(LONG_LONG, kcas_width, MAX_KCAS+1, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, kcas_executes_by_type, KCAS_NUM_TYPES, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, kcas_failures_by_type, KCAS_NUM_TYPES, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, kcas_failures_per_update, KCAS_RETRY_HISTOGRAM_SIZE, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, kcas_htm_commits_by_type, KCAS_NUM_TYPES, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, kcas_fallbacks_by_type, KCAS_NUM_TYPES, { \
+                gstats_output_item(PRINT_RAW, SUM, BY_INDEX) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_kcas_htm_skipped, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_kcas_htm_abort_conflict, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_kcas_htm_abort_capacity, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_kcas_htm_abort_descriptor, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_kcas_htm_abort_other, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_deferred_rebalances, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_merged_rebalances, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_rebalance_batches, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+        gstats_handle_stat(LONG_LONG, num_depth_bound_rebalances, 1, { \
+                gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+        }) \
+
+    // define a variable for each stat above
+    GSTATS_HANDLE_STATS_SIGOUIN_INT_BST_KCAS(__DECLARE_EXTERN_STAT_ID);
+#endif
+
 template<typename K, typename V>
 struct Node {
     casword<K> key;
@@ -61,6 +177,18 @@ private:
         volatile char padding[PADDING_BYTES];
     };
 
+    struct ThreadData {
+        int failures;       // failed KCAS operations in the current update (including its rebalancing)
+        int searchDepth;    // depth of the last node visited by the last search (root->left has depth 0), only set if relaxed or with KCAS_AVL_DEPTH_STATS
+        int numPending;
+        K pending[MAX_PENDING_REBALANCES]; // relaxed mode: keys of the nodes where deferred rebalancing starts
+#ifdef KCAS_AVL_DEPTH_STATS
+        int64_t depthSum;
+        int64_t depthCnt;
+#endif
+        volatile char padding[PADDING_BYTES];
+    };
+
 
     volatile char padding0[PADDING_BYTES];
     //Debugging, used to validate that no thread's parent can't be NULL, save for the root
@@ -68,6 +196,7 @@ private:
     const int numThreads;
     const int minKey;
     const long long maxKey;
+    const kcas_avl_rebalance_policy rebalancePolicy;
     volatile char padding4[PADDING_BYTES];
     Node<K, V> * root;
     volatile char padding5[PADDING_BYTES];
@@ -75,10 +204,12 @@ private:
     volatile char padding7[PADDING_BYTES];
     PathContainer paths[MAX_THREADS];
     volatile char padding8[PADDING_BYTES];
+    ThreadData threadData[MAX_THREADS];
+    volatile char padding9[PADDING_BYTES];
 
 public:
 
-    InternalKCAS(const int _numThreads, const int _minKey, const long long _maxKey);
+    InternalKCAS(const int _numThreads, const int _minKey, const long long _maxKey, const kcas_avl_rebalance_policy _rebalancePolicy = kcas_avl_rebalance_policy());
 
     ~InternalKCAS();
 
@@ -134,6 +265,14 @@ private:
     void fixHeightAndRebalance(const int tid, Node<K, V> * node);
 
     int fixHeight(const int tid, ObservedNode &observedNode);
+
+    bool executeKCAS(const int tid, const KCASType type);
+
+    void recordUpdate(const int tid);
+
+    void rebalance(const int tid, Node<K, V> * node);
+
+    void rebalancePending(const int tid);
 };
 
 template<class RecordManager, typename K, typename V>
@@ -152,9 +291,10 @@ Node<K, V> * InternalKCAS<RecordManager, K, V>::createNode(const int tid, Node<K
 }
 
 template<class RecordManager, typename K, typename V>
-InternalKCAS<RecordManager, K, V>::InternalKCAS(const int _numThreads, const int _minKey, const long long _maxKey)
-: numThreads(_numThreads), minKey(_minKey), maxKey(_maxKey), recmgr(new RecordManager(numThreads)) {
+InternalKCAS<RecordManager, K, V>::InternalKCAS(const int _numThreads, const int _minKey, const long long _maxKey, const kcas_avl_rebalance_policy _rebalancePolicy)
+: numThreads(_numThreads), minKey(_minKey), maxKey(_maxKey), rebalancePolicy(_rebalancePolicy), recmgr(new RecordManager(numThreads)) {
     assert(_numThreads < MAX_THREADS);
+    assert(rebalancePolicy.maxPending >= 1 && rebalancePolicy.maxPending <= MAX_PENDING_REBALANCES);
     int tid = 0;
     initThread(tid);
     root = createNode(0, NULL, (maxKey + 1 & 0x00FFFFFFFFFFFFFF), NULL);
@@ -178,13 +318,116 @@ inline Node<K, V> * InternalKCAS<RecordManager, K, V>::getRoot() {
 template<class RecordManager, typename K, typename V>
 void InternalKCAS<RecordManager, K, V>::initThread(const int tid) {
     recmgr->initThread(tid);
+    threadData[tid].failures = 0;
+    threadData[tid].numPending = 0;
+#ifdef KCAS_AVL_DEPTH_STATS
+    threadData[tid].depthSum = 0;
+    threadData[tid].depthCnt = 0;
+#endif
 }
 
 template<class RecordManager, typename K, typename V>
 void InternalKCAS<RecordManager, K, V>::deinitThread(const int tid) {
+    if (threadData[tid].numPending > 0) {
+        rebalancePending(tid);
+    }
+#ifdef KCAS_AVL_DEPTH_STATS
+    // publish this thread's depth statistics (the global counters are read after the run)
+    __sync_fetch_and_add(&key_depth_total_sum__, threadData[tid].depthSum);
+    __sync_fetch_and_add(&key_depth_total_cnt__, threadData[tid].depthCnt);
+    threadData[tid].depthSum = 0;
+    threadData[tid].depthCnt = 0;
+#endif
     recmgr->deinitThread(tid);
 }
 
+template<class RecordManager, typename K, typename V>
+inline bool InternalKCAS<RecordManager, K, V>::executeKCAS(const int tid, const KCASType type) {
+#ifdef KCAS_AVL_KCAS_STATS
+    const int width = kcas::getDescriptor()->numEntries;
+#endif
+    const bool result = kcas::execute();
+#ifdef KCAS_AVL_KCAS_STATS
+    GSTATS_ADD_IX(tid, kcas_width, 1, width);
+    GSTATS_ADD_IX(tid, kcas_executes_by_type, 1, type);
+    if (!result) {
+        ++threadData[tid].failures;
+        GSTATS_ADD_IX(tid, kcas_failures_by_type, 1, type);
+    }
+#if defined KCAS_HTM
+    const kcas_execute_stats &htm = kcas::lastExecuteStats();
+    if (htm.committedInHtm) GSTATS_ADD_IX(tid, kcas_htm_commits_by_type, 1, type);
+    if (htm.fellBack) GSTATS_ADD_IX(tid, kcas_fallbacks_by_type, 1, type);
+    if (htm.skippedHtm) GSTATS_ADD(tid, num_kcas_htm_skipped, 1);
+    GSTATS_ADD(tid, num_kcas_htm_abort_conflict, htm.abortsConflict);
+    GSTATS_ADD(tid, num_kcas_htm_abort_capacity, htm.abortsCapacity);
+    GSTATS_ADD(tid, num_kcas_htm_abort_descriptor, htm.abortsDescriptor);
+    GSTATS_ADD(tid, num_kcas_htm_abort_other, htm.abortsOther);
+#endif
+#endif /* KCAS_AVL_KCAS_STATS */
+    return result;
+}
+
+template<class RecordManager, typename K, typename V>
+inline void InternalKCAS<RecordManager, K, V>::recordUpdate(const int tid) {
+#ifdef KCAS_AVL_KCAS_STATS
+    const int failures = threadData[tid].failures;
+    GSTATS_ADD_IX(tid, kcas_failures_per_update, 1, (failures < KCAS_RETRY_HISTOGRAM_SIZE) ? failures : KCAS_RETRY_HISTOGRAM_SIZE - 1);
+    threadData[tid].failures = 0;
+#endif
+}
+
+/* rebalance(const int tid, Node<K, V> * node)
+ * Rebalances the tree from node up after an update, now (strict mode) or in the
+ * thread's next batch (relaxed mode). Must be called inside the update's guard.
+ */
+template<class RecordManager, typename K, typename V>
+inline void InternalKCAS<RecordManager, K, V>::rebalance(const int tid, Node<K, V> * node) {
+    if (!rebalancePolicy.relaxed) {
+        fixHeightAndRebalance(tid, node);
+        return;
+    }
+    if (node == root) return;
+
+    ThreadData &data = threadData[tid];
+    const K key = node->key;
+    for (int i = 0; i < data.numPending; ++i) {
+        if (data.pending[i] == key) {
+            GSTATS_ADD(tid, num_merged_rebalances, 1);
+            return;
+        }
+    }
+    if (data.numPending == MAX_PENDING_REBALANCES) {
+        fixHeightAndRebalance(tid, node);
+        return;
+    }
+    data.pending[data.numPending++] = key;
+    GSTATS_ADD(tid, num_deferred_rebalances, 1);
+}
+
+/* rebalancePending(const int tid)
+ * Runs the deferred rebalancing of this thread. The recorded nodes may have
+ * been deleted since, so each one is found again by its key; if it is gone,
+ * rebalancing starts where the search for it ended (its deletion recorded its
+ * own rebalancing for the nodes above). Must be called outside of a guard.
+ */
+template<class RecordManager, typename K, typename V>
+void InternalKCAS<RecordManager, K, V>::rebalancePending(const int tid) {
+    ThreadData &data = threadData[tid];
+    auto guard = recmgr->getGuard(tid);
+    GSTATS_ADD(tid, num_rebalance_batches, 1);
+    for (int i = 0; i < data.numPending; ++i) {
+        ObservedNode oParent;
+        ObservedNode oNode;
+        int res;
+        while ((res = search(tid, oParent, oNode, data.pending[i])) == RetCode::RETRY) {
+            /* keep trying until we get a result */
+        }
+        fixHeightAndRebalance(tid, (res == RetCode::SUCCESS) ? oNode.node : oParent.node);
+    }
+    data.numPending = 0;
+}
+
 template<class RecordManager, typename K, typename V>
 int InternalKCAS<RecordManager, K, V>::getHeight(Node<K, V> * node) {
     return node == NULL ? 0 : node->height;
@@ -234,6 +477,12 @@ inline bool InternalKCAS<RecordManager, K, V>::contains(const int tid, const K &
     while ((result = search(tid, oParent, oNode, key)) == RetCode::RETRY) {
         /* keep trying until we get a result */
     }
+#ifdef KCAS_AVL_DEPTH_STATS
+    if (result == RetCode::SUCCESS) {
+        threadData[tid].depthSum += threadData[tid].searchDepth;
+        ++threadData[tid].depthCnt;
+    }
+#endif
     return result == RetCode::SUCCESS;
 }
 
@@ -263,6 +512,7 @@ int InternalKCAS<RecordManager, K, V>::search(const int tid, ObservedNode &oPare
         //We have hit a terminal node without finding our key, must validate
         if (node == NULL) {
             if (validatePath(tid, currSize, key, path)) {
+                if (KCAS_AVL_TRACKS_SEARCH_DEPTH || rebalancePolicy.relaxed) threadData[tid].searchDepth = currSize - 2;
                 oParent = path[currSize - 1];
                 return RetCode::FAILURE;
             } else {
@@ -284,6 +534,7 @@ int InternalKCAS<RecordManager, K, V>::search(const int tid, ObservedNode &oPare
             node = node->left;
         }            //no validation required on finding a key
         else {
+            if (KCAS_AVL_TRACKS_SEARCH_DEPTH || rebalancePolicy.relaxed) threadData[tid].searchDepth = currSize - 2;
             oParent = path[currSize - 2];
             oNode = path[currSize - 1];
             return RetCode::SUCCESS;
@@ -317,6 +568,10 @@ inline V InternalKCAS<RecordManager, K, V>::insertIfAbsent(const int tid, const
     ObservedNode oParent;
     ObservedNode oNode;
 
+    if (threadData[tid].numPending >= rebalancePolicy.maxPending) {
+        rebalancePending(tid);
+    }
+
     while (true) {
         auto guard = recmgr->getGuard(tid);
 
@@ -326,11 +581,13 @@ inline V InternalKCAS<RecordManager, K, V>::insertIfAbsent(const int tid, const
         }
 
         if (res == RetCode::SUCCESS) {
+            recordUpdate(tid);
             return (V)oNode.node->value;
         }
 
         assert(res == RetCode::FAILURE);
         if (internalInsert(tid, oParent, key, value)) {
+            recordUpdate(tid);
             return 0;
         }
     }
@@ -360,8 +617,14 @@ int InternalKCAS<RecordManager, K, V>::internalInsert(const int tid, ObservedNod
 
     kcas::add(&parent->vNumMark, oParent.oVNumMark, oParent.oVNumMark + 2);
 
-    if (kcas::execute()) {
-        fixHeightAndRebalance(tid, parent);
+    if (executeKCAS(tid, KCAS_INSERT)) {
+        // the new node is at depth searchDepth + 1
+        if (rebalancePolicy.relaxed && threadData[tid].searchDepth + 1 > rebalancePolicy.maxDepth) {
+            GSTATS_ADD(tid, num_depth_bound_rebalances, 1);
+            fixHeightAndRebalance(tid, parent);
+        } else {
+            rebalance(tid, parent);
+        }
         return RetCode::SUCCESS;
     }
 
@@ -375,6 +638,10 @@ inline V InternalKCAS<RecordManager, K, V>::erase(const int tid, const K &key) {
     ObservedNode oParent;
     ObservedNode oNode;
 
+    if (threadData[tid].numPending >= rebalancePolicy.maxPending) {
+        rebalancePending(tid);
+    }
+
     while (true) {
         auto guard = recmgr->getGuard(tid);
 
@@ -384,11 +651,13 @@ inline V InternalKCAS<RecordManager, K, V>::erase(const int tid, const K &key) {
         }
 
         if (res == RetCode::FAILURE) {
+            recordUpdate(tid);
             return 0;
         }
 
         assert(res == RetCode::SUCCESS);
         if ((res = internalErase(tid, oParent, oNode, key))) {
+            recordUpdate(tid);
             return (V)oNode.node->value;
         }
     }
@@ -425,10 +694,10 @@ int InternalKCAS<RecordManager, K, V>::internalErase(const int tid, ObservedNode
             &node->vNumMark, oNode.oVNumMark, oNode.oVNumMark + 3
         );
 
-        if (kcas::execute()) {
+        if (executeKCAS(tid, KCAS_ERASE)) {
             assert(IS_MARKED(node->vNumMark));
             recmgr->retire(tid, node);
-            fixHeightAndRebalance(tid, parent);
+            rebalance(tid, parent);
 
             return RetCode::SUCCESS;
         }
@@ -473,10 +742,10 @@ int InternalKCAS<RecordManager, K, V>::internalErase(const int tid, ObservedNode
             &parent->vNumMark, oParent.oVNumMark, oParent.oVNumMark + 2
         );
 
-        if (kcas::execute()) {
+        if (executeKCAS(tid, KCAS_ERASE)) {
             assert(IS_MARKED(node->vNumMark));
             recmgr->retire(tid, node);
-            fixHeightAndRebalance(tid, parent);
+            rebalance(tid, parent);
 
             return RetCode::SUCCESS;
         }
@@ -554,11 +823,11 @@ int InternalKCAS<RecordManager, K, V>::internalErase(const int tid, ObservedNode
             kcas::add(&node->vNumMark, oNode.oVNumMark, oNode.oVNumMark + 2);
         }
 
-        if (kcas::execute()) {
+        if (executeKCAS(tid, KCAS_ERASE)) {
             assert(IS_MARKED(succ->vNumMark));
             recmgr->retire(tid, succ);
             //successor's parent is the only node that's height will have been impacted
-            fixHeightAndRebalance(tid, succParent);
+            rebalance(tid, succParent);
             return RetCode::SUCCESS;
         }
 
@@ -740,7 +1009,7 @@ int InternalKCAS<RecordManager, K, V>::fixHeight(const int tid, ObservedNode &oN
         &node->vNumMark, oNode.oVNumMark, oNode.oVNumMark + 2
     );
 
-    if (kcas::execute()) {
+    if (executeKCAS(tid, KCAS_FIX_HEIGHT)) {
         return RetCode::SUCCESS_WITH_HEIGHT_UPDATE;
     }
 
@@ -804,7 +1073,7 @@ int InternalKCAS<RecordManager, K, V>::rotateRight(const int tid, ObservedNode &
         &left->vNumMark, oLeft.oVNumMark, oLeft.oVNumMark + 2
     );
 
-    if (kcas::execute()) return RetCode::SUCCESS;
+    if (executeKCAS(tid, KCAS_ROTATE)) return RetCode::SUCCESS;
     return RetCode::FAILURE;
 }
 
@@ -866,7 +1135,7 @@ int InternalKCAS<RecordManager, K, V>::rotateLeft(const int tid, ObservedNode &o
         &right->vNumMark, oRight.oVNumMark, oRight.oVNumMark + 2
     );
 
-    if (kcas::execute()) return RetCode::SUCCESS;
+    if (executeKCAS(tid, KCAS_ROTATE)) return RetCode::SUCCESS;
     return RetCode::FAILURE;
 }
 
@@ -944,7 +1213,7 @@ int InternalKCAS<RecordManager, K, V>::rotateLeftRight(const int tid, ObservedNo
         &left->vNumMark, oLeft.oVNumMark, oLeft.oVNumMark + 2
     );
 
-    if (kcas::execute()) return RetCode::SUCCESS;
+    if (executeKCAS(tid, KCAS_DOUBLE_ROTATE)) return RetCode::SUCCESS;
     return RetCode::FAILURE;
 }
 
@@ -1027,7 +1296,7 @@ int InternalKCAS<RecordManager, K, V>::rotateRightLeft(const int tid, ObservedNo
     );
 
 
-    if (kcas::execute()) return RetCode::SUCCESS;
+    if (executeKCAS(tid, KCAS_DOUBLE_ROTATE)) return RetCode::SUCCESS;
     return RetCode::FAILURE;
 }
 
@@ -12,12 +12,13 @@ using namespace std;
 
 #include "errors.h"
 #include "record_manager.h"
+#include "ds_parameters.h"
 #ifdef USE_TREE_STATS
 #   include "tree_stats.h"
 #endif
 #include "ca_tree.h"
 
-#define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, RouteNode<K,V>, BaseNode<K,V>>
+#define RECORD_MANAGER_T record_manager<Reclaim, Alloc, Pool, RouteNode<K,V>, BaseNode<K,V>, AVLNode<K,V>>
 #define DATA_STRUCTURE_T CATree<RECORD_MANAGER_T, K, V>
 
 
@@ -34,8 +35,22 @@ public:
                const V& VALUE_RESERVED,
                Random64 * const unused2)
             : NO_VALUE(VALUE_RESERVED)
-            , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, OrderedSetType::AVL))
-    { }
+            , ds(new DATA_STRUCTURE_T(NUM_THREADS, KEY_MIN, KEY_MAX, OrderedSetType::AVL,
+                    ds_parameters::get<int>("catree.optimisticAttempts", 2)))
+    {
+        ContentionPolicy * policy = ds->getContentionPolicy();
+        policy->highContentionLimit = ds_parameters::get<int>("catree.highContentionLimit", policy->highContentionLimit);
+        policy->lowContentionLimit = ds_parameters::get<int>("catree.lowContentionLimit", policy->lowContentionLimit);
+        policy->failureContrib = ds_parameters::get<int>("catree.failureContrib", policy->failureContrib);
+        policy->successContrib = ds_parameters::get<int>("catree.successContrib", policy->successContrib);
+        policy->rangeQueryContrib = ds_parameters::get<int>("catree.rangeQueryContrib", policy->rangeQueryContrib);
+        policy->adaptiveLimits = ds_parameters::get<bool>("catree.adaptiveLimits", policy->adaptiveLimits);
+        policy->oscillationWindow = ds_parameters::get<int>("catree.oscillationWindow", policy->oscillationWindow);
+        policy->maxLimitScale = ds_parameters::get<int>("catree.maxLimitScale", policy->maxLimitScale);
+        if (policy->highContentionLimit <= 0 || policy->lowContentionLimit >= 0 || policy->maxLimitScale < 1) {
+            setbench_error("catree.highContentionLimit must be positive, catree.lowContentionLimit negative and catree.maxLimitScale at least 1");
+        }
+    }
 
     ~ds_adapter() {
         delete ds;
@@ -74,11 +89,12 @@ public:
     }
 
     int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
-        setbench_error("not implemented");
+        return ds->rangeQuery(tid, lo, hi, resultKeys, resultValues);
     }
 
     void printSummary() {
 //        ds->printDebuggingDetails();
+        ds->printSummary();
     }
 
     void printObjectSizes() {
@@ -88,6 +104,9 @@ public:
         std::cout<<"sizes: BaseNode="
                  <<(sizeof(BaseNode<K, V>))
                  <<std::endl;
+        std::cout<<"sizes: AVLNode="
+                 <<(sizeof(AVLNode<K, V>))
+                 <<std::endl;
     }
 
     bool validateStructure() {
@@ -28,26 +28,38 @@
  */
 using namespace std;
 
+/* Bound on the length of an optimistic search; a longer walk means the tree
+   changed underneath the reader */
+#ifndef AVL_MAX_OPTIMISTIC_DEPTH
+#define AVL_MAX_OPTIMISTIC_DEPTH 128
+#endif
+
+/**
+ * Nodes are allocated and retired through the record manager so that
+ * optimistic readers, which do not hold the base node lock, never touch
+ * freed memory.
+ */
 template <typename K, typename V>
+struct AVLNode {
+    K key;
+    AVLNode * left;
+    AVLNode * right;
+    AVLNode * parent;
+    int balance;
+    V val;
+};
+
+template <class RecordManager, typename K, typename V>
 class AVLTree : public IOSet {
 private:
-    struct Node {
-        K key;
-        Node * left;
-        Node * right;
-        Node * parent;
-        int balance;
-        V val;
-        
-        Node(K _key, V _val, Node * _parent, Node * _left, Node * _right) :
-            key(_key), val(_val), parent(_parent), left(_left), right(_right), balance(0) {
-            
-        }
-    };
+    typedef AVLNode<K, V> Node;
     
+    RecordManager * const recmgr;
     Node * root;
     const V NO_VALUE = (V) 0;
     
+    Node * newNode(const int tid, K key, V val, Node * parent);
+    
     /* AVL Tree maintenance and balancing methods */
     int computeHeight();
     pair<K,V> minKey();
@@ -57,7 +69,7 @@ private:
     void rotateRight(Node * prevNode);
     void rotateDoubleRight(Node * prevNode);
     void rotateDoubleLeft(Node * prevNode);
-    bool replaceWithRightmost(Node * toReplaceInNode);
+    bool replaceWithRightmost(const int tid, Node * toReplaceInNode);
     bool deleteBalanceLeft(Node * currentNode);
     bool deleteBalanceRight(Node * currentNode);
     
@@ -69,22 +81,27 @@ private:
     size_t sumOfKeysHelper(Node * node);
     void printBFSOrder(Node * node);
     
+    int rangeQueryHelper(Node * node, const K & lo, const K & hi, K * const resultKeys, V * const resultValues, int size);
+    
     /* Memory reclamation */
-    void freeTraversal(Node * node);
+    void freeTraversal(const int tid, Node * node);
     
 public:
    
-    AVLTree();
+    AVLTree(RecordManager * recmgr);
     ~AVLTree();
     
     /* Dictionary operations  */
     virtual V find(const int tid, const K & key);
+    virtual V findOptimistic(const int tid, const K & key, bool & ok);
     virtual V insert(const int tid, const K & key, const V& val);
     virtual V erase(const int tid, const K & key);
     
     /* Set operations */
     IOSet * join(const int tid, IOSet * rightTree);
     std::tuple<K, IOSet *, IOSet *> split(const int tid);
+    int rangeQuery(const int tid, const K & lo, const K & hi, K * const resultKeys, V * const resultValues);
+    void clear(const int tid);
     
     /* Useful methods */
     bool isEmpty();
@@ -98,8 +115,8 @@ public:
     
 };
 
-template <typename K, typename V>
-int AVLTree<K, V>::computeHeight() {
+template <class RecordManager, typename K, typename V>
+int AVLTree<RecordManager, K, V>::computeHeight() {
     if (root == NULL) {
         return 0;
     }
@@ -119,8 +136,8 @@ int AVLTree<K, V>::computeHeight() {
     }
 }
 
-template <typename K, typename V>
-pair<K,V> AVLTree<K, V>::minKey() {
+template <class RecordManager, typename K, typename V>
+pair<K,V> AVLTree<RecordManager, K, V>::minKey() {
     Node * currentNode = root;
     while (currentNode->left != NULL) {
         currentNode = currentNode->left;
@@ -133,8 +150,8 @@ pair<K,V> AVLTree<K, V>::minKey() {
     }
 }
 
-template <typename K, typename V>
-pair<K,V> AVLTree<K, V>::maxKey() {
+template <class RecordManager, typename K, typename V>
+pair<K,V> AVLTree<RecordManager, K, V>::maxKey() {
     Node * currentNode = root;
     while (currentNode->right != NULL) {
         currentNode = currentNode->right;
@@ -147,8 +164,8 @@ pair<K,V> AVLTree<K, V>::maxKey() {
     }
 }
 
-template <typename K, typename V>
-typename AVLTree<K, V>::Node * AVLTree<K, V>::getAVLNode(const K & key) {
+template <class RecordManager, typename K, typename V>
+typename AVLTree<RecordManager, K, V>::Node * AVLTree<RecordManager, K, V>::getAVLNode(const K & key) {
     Node * currentNode = root;
     while (currentNode != NULL) {
         K nodeKey = currentNode->key;
@@ -165,8 +182,8 @@ typename AVLTree<K, V>::Node * AVLTree<K, V>::getAVLNode(const K & key) {
     return NULL;
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::rotateLeft(Node* prevNode) {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::rotateLeft(Node* prevNode) {
     /* Single left rotation */
     Node * leftChild = prevNode->left;
     Node * prevNodeParent = prevNode->parent;
@@ -190,8 +207,8 @@ void AVLTree<K, V>::rotateLeft(Node* prevNode) {
     leftChild->balance = 0;
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::rotateRight(Node * prevNode) {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::rotateRight(Node * prevNode) {
     /* Single right rotation */
     Node * rightChild = prevNode->right;
     Node * prevNodeParent = prevNode->parent;
@@ -217,8 +234,8 @@ void AVLTree<K, V>::rotateRight(Node * prevNode) {
    
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::rotateDoubleRight(Node * prevNode) {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::rotateDoubleRight(Node * prevNode) {
     Node * prevNodeParent = prevNode->parent;
     Node * leftChild = prevNode->left;
     Node * leftChildRightChild = leftChild->right;
@@ -256,8 +273,8 @@ void AVLTree<K, V>::rotateDoubleRight(Node * prevNode) {
     leftChildRightChild->balance = 0;   
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::rotateDoubleLeft(Node* prevNode) {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::rotateDoubleLeft(Node* prevNode) {
     Node * prevNodeParent = prevNode->parent;
     Node * rightChild = prevNode->right;
     Node * rightChildLeftChild = rightChild->left;
@@ -293,8 +310,8 @@ void AVLTree<K, V>::rotateDoubleLeft(Node* prevNode) {
     rightChildLeftChild->balance = 0;
 }
 
-template <typename K, typename V>
-bool AVLTree<K, V>::replaceWithRightmost(Node * toReplaceInNode) {
+template <class RecordManager, typename K, typename V>
+bool AVLTree<RecordManager, K, V>::replaceWithRightmost(const int tid, Node * toReplaceInNode) {
     Node * currentNode = toReplaceInNode->left;
     int replacePos = 0;
     while (currentNode->right != NULL) {
@@ -316,7 +333,7 @@ bool AVLTree<K, V>::replaceWithRightmost(Node * toReplaceInNode) {
 
     // currentNode is now unlinked
     Node* tmp = currentNode->parent;
-    delete(currentNode);
+    recmgr->retire(tid, currentNode);
     
     bool continueBalance = true;
     currentNode = tmp;
@@ -330,8 +347,8 @@ bool AVLTree<K, V>::replaceWithRightmost(Node * toReplaceInNode) {
     return continueBalance;
 }
 
-template <typename K, typename V>
-bool AVLTree<K, V>::deleteBalanceLeft(Node * currentNode) {
+template <class RecordManager, typename K, typename V>
+bool AVLTree<RecordManager, K, V>::deleteBalanceLeft(Node * currentNode) {
     bool continueBalance = true;
     if (currentNode->balance == -1) {
         currentNode->balance = 0;
@@ -385,8 +402,8 @@ bool AVLTree<K, V>::deleteBalanceLeft(Node * currentNode) {
     return continueBalance;
 }
 
-template <typename K, typename V>
-bool AVLTree<K, V>::deleteBalanceRight(Node * currentNode) {
+template <class RecordManager, typename K, typename V>
+bool AVLTree<RecordManager, K, V>::deleteBalanceRight(Node * currentNode) {
     bool continueBalance = true;
     if (currentNode->balance == 1) {
         currentNode->balance = 0;
@@ -440,41 +457,91 @@ bool AVLTree<K, V>::deleteBalanceRight(Node * currentNode) {
     return continueBalance;
 }
 
-template <typename K, typename V>
-AVLTree<K, V>::AVLTree() {
+template <class RecordManager, typename K, typename V>
+AVLTree<RecordManager, K, V>::AVLTree(RecordManager * _recmgr) : recmgr(_recmgr) {
     root = NULL;
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::freeTraversal(Node * node) {
+template <class RecordManager, typename K, typename V>
+typename AVLTree<RecordManager, K, V>::Node * AVLTree<RecordManager, K, V>::newNode(const int tid, K key, V val, Node * parent) {
+    Node * node = recmgr->template allocate<Node>(tid);
+    node->key = key;
+    node->val = val;
+    node->parent = parent;
+    node->left = NULL;
+    node->right = NULL;
+    node->balance = 0;
+    return node;
+}
+
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::freeTraversal(const int tid, Node * node) {
     assert(node != NULL);
     if ( node->left != NULL )
-        freeTraversal(node->left);
+        freeTraversal(tid, node->left);
     
     if ( node->right != NULL)
-        freeTraversal(node->right);
+        freeTraversal(tid, node->right);
     
-    delete(node);
+    recmgr->deallocate(tid, node);
 }
 
-template <typename K, typename V>
-AVLTree<K, V>::~AVLTree() {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::clear(const int tid) {
     if (root != NULL) {
-        freeTraversal(root);
+        freeTraversal(tid, root);
+        root = NULL;
     }
 }
 
+template <class RecordManager, typename K, typename V>
+AVLTree<RecordManager, K, V>::~AVLTree() {
+    /* sets are emptied by split/join before their base node is retired,
+       and cleared explicitly at teardown */
+    assert(root == NULL);
+}
 
-template <typename K, typename V>
-V AVLTree<K, V>::find(const int tid, const K & key) {
+
+template <class RecordManager, typename K, typename V>
+V AVLTree<RecordManager, K, V>::find(const int tid, const K & key) {
     Node* node = getAVLNode(key);
     if (node == nullptr) return NO_VALUE;
     return node->val;
 }
 
+/**
+ * Same search as find, but may run concurrently with an update of this set by
+ * the lock holder. The result is only meaningful if the caller validates that
+ * no update happened meanwhile; a walk that does not terminate in time (e.g.,
+ * because of a rotation under the reader) reports ok == false.
+ */
+template <class RecordManager, typename K, typename V>
+V AVLTree<RecordManager, K, V>::findOptimistic(const int tid, const K & key, bool & ok) {
+    Node * currentNode = __atomic_load_n(&root, __ATOMIC_ACQUIRE);
+    for (int depth = 0; currentNode != NULL; ++depth) {
+        if (depth > AVL_MAX_OPTIMISTIC_DEPTH) {
+            ok = false;
+            return NO_VALUE;
+        }
+        K currentKey = currentNode->key;
+        if (key < currentKey) {
+            currentNode = __atomic_load_n(&currentNode->left, __ATOMIC_ACQUIRE);
+        }
+        else if (key > currentKey) {
+            currentNode = __atomic_load_n(&currentNode->right, __ATOMIC_ACQUIRE);
+        }
+        else {
+            ok = true;
+            return currentNode->val;
+        }
+    }
+    ok = true;
+    return NO_VALUE;
+}
+
 /* Semantics: Only insert if key is absent */
-template <typename K, typename V>
-V AVLTree<K, V>::insert(const int tid, const K & key, const V& val) {
+template <class RecordManager, typename K, typename V>
+V AVLTree<RecordManager, K, V>::insert(const int tid, const K & key, const V& val) {
     Node * prevNode = NULL;
     Node * currentNode = root;
     bool dirLeft = true;
@@ -499,7 +566,7 @@ V AVLTree<K, V>::insert(const int tid, const K & key, const V& val) {
     
     /* Unique key, create new node and insert */
     
-    currentNode = new Node(key, val, prevNode, NULL, NULL);
+    currentNode = newNode(tid, key, val, prevNode);
 
     if (prevNode == NULL) {
         root = currentNode;
@@ -558,8 +625,8 @@ V AVLTree<K, V>::insert(const int tid, const K & key, const V& val) {
     return NO_VALUE;
 }
 
-template <typename K, typename V>
-V AVLTree<K, V>::erase(const int tid, const K & key) {   
+template <class RecordManager, typename K, typename V>
+V AVLTree<RecordManager, K, V>::erase(const int tid, const K & key) {   
     bool dirLeft = true;
     Node * currentNode = root;
     while (currentNode != NULL) {
@@ -599,7 +666,7 @@ V AVLTree<K, V>::erase(const int tid, const K & key) {
             currentNode->right->parent = prevNode;
         }
         Node* tmp = currentNode->right;
-        delete(currentNode);
+        recmgr->retire(tid, currentNode);
         currentNode = tmp;
     }
     else if (currentNode->right == NULL) {
@@ -617,24 +684,24 @@ V AVLTree<K, V>::erase(const int tid, const K & key) {
             currentNode->left->parent = prevNode;
         }
         Node* tmp = currentNode->left;
-        delete(currentNode);
+        recmgr->retire(tid, currentNode);
         currentNode = tmp;
     }
     else {
         // replaceWithRightmost frees the deleted node
         if (prevNode == NULL) {
-            continueFix = replaceWithRightmost(currentNode);
+            continueFix = replaceWithRightmost(tid, currentNode);
             currentNode = root->left;
             prevNode = root;
         }
         else if (prevNode->left == currentNode) {
-            continueFix = replaceWithRightmost(currentNode);
+            continueFix = replaceWithRightmost(tid, currentNode);
             prevNode = prevNode->left;
             currentNode = prevNode->left;
             dirLeft = true;
         }
         else {
-            continueFix = replaceWithRightmost(currentNode);
+            continueFix = replaceWithRightmost(tid, currentNode);
             prevNode = prevNode->right;
             currentNode = prevNode->left;
             dirLeft = true;
@@ -693,15 +760,15 @@ V AVLTree<K, V>::erase(const int tid, const K & key) {
     return retval;
 }
 
-template <typename K, typename V>
-IOSet * AVLTree<K, V>::join(const int tid, IOSet * rightSet) {
+template <class RecordManager, typename K, typename V>
+IOSet * AVLTree<RecordManager, K, V>::join(const int tid, IOSet * rightSet) {
     /* Assumption: rightTree's smallest key > this tree's largest key */
     AVLTree * const rightTree = dynamic_cast<AVLTree *>(rightSet);
     if (rightTree == nullptr) {
         assert(false); /* incorrect type */
     }
     
-    AVLTree * newTree = new AVLTree();
+    AVLTree * newTree = new AVLTree(recmgr);
     Node * prevNode = NULL;
     Node * currentNode = NULL;
     
@@ -732,7 +799,7 @@ IOSet * AVLTree<K, V>::join(const int tid, IOSet * rightSet) {
         assert(minKey.first != INVALID_KEY); /* minKey == NULL only if rightTree is empty */
         
         rightTree->erase(tid, minKey.first);
-        Node * newRoot = new Node(minKey.first, minKey.second, NULL, NULL, NULL);
+        Node * newRoot = newNode(tid, minKey.first, minKey.second, NULL);
         int newRightHeight = rightTree->computeHeight();
         
         prevNode = NULL;
@@ -779,7 +846,7 @@ IOSet * AVLTree<K, V>::join(const int tid, IOSet * rightSet) {
         pair<K,V> maxKey = leftTree->maxKey();
         assert(maxKey.first != INVALID_KEY); /* minKey == NULL only if righTree is empty */
         leftTree->erase(tid, maxKey.first);
-        Node * newRoot = new Node(maxKey.first, maxKey.second, NULL, NULL, NULL);
+        Node * newRoot = newNode(tid, maxKey.first, maxKey.second, NULL);
         int newLeftHeight = leftTree->computeHeight();
         
         prevNode = NULL;
@@ -869,8 +936,8 @@ IOSet * AVLTree<K, V>::join(const int tid, IOSet * rightSet) {
     return newTree;
 }
 
-template <typename K, typename V>
-std::tuple<K, IOSet *, IOSet *> AVLTree<K, V>::split(const int tid) {
+template <class RecordManager, typename K, typename V>
+std::tuple<K, IOSet *, IOSet *> AVLTree<RecordManager, K, V>::split(const int tid) {
     Node * leftRoot = NULL;
     Node * rightRoot = NULL;
     
@@ -913,15 +980,15 @@ std::tuple<K, IOSet *, IOSet *> AVLTree<K, V>::split(const int tid) {
             Node * oldRoot = root;
             root = root->right;
             root->parent = NULL;   
-            delete(oldRoot);
+            recmgr->retire(tid, oldRoot);
             insert(tid, splitKey, splitVal);
             rightRoot = root;
             
         }
     }
-    AVLTree * leftTree = new AVLTree();
+    AVLTree * leftTree = new AVLTree(recmgr);
     leftTree->root = leftRoot;
-    AVLTree * rightTree = new AVLTree();
+    AVLTree * rightTree = new AVLTree(recmgr);
     rightTree->root = rightRoot;
      
     // Don't accidently delete the data of the returned trees
@@ -929,37 +996,58 @@ std::tuple<K, IOSet *, IOSet *> AVLTree<K, V>::split(const int tid) {
     return std::make_tuple(splitKey, leftTree, rightTree);
 }
 
-template <typename K, typename V>
-bool AVLTree<K, V>::isEmpty() {
+template <class RecordManager, typename K, typename V>
+int AVLTree<RecordManager, K, V>::rangeQueryHelper(Node * node, const K & lo, const K & hi, K * const resultKeys, V * const resultValues, int size) {
+    if (node == NULL)
+        return size;
+    if (lo < node->key)
+        size = rangeQueryHelper(node->left, lo, hi, resultKeys, resultValues, size);
+    if (lo <= node->key && node->key <= hi) {
+        resultKeys[size] = node->key;
+        resultValues[size] = node->val;
+        ++size;
+    }
+    if (node->key < hi)
+        size = rangeQueryHelper(node->right, lo, hi, resultKeys, resultValues, size);
+    return size;
+}
+
+template <class RecordManager, typename K, typename V>
+int AVLTree<RecordManager, K, V>::rangeQuery(const int tid, const K & lo, const K & hi, K * const resultKeys, V * const resultValues) {
+    return rangeQueryHelper(root, lo, hi, resultKeys, resultValues, 0);
+}
+
+template <class RecordManager, typename K, typename V>
+bool AVLTree<RecordManager, K, V>::isEmpty() {
     return root == NULL;
 }
 
-template <typename K, typename V>
-size_t AVLTree<K, V>::sumOfKeysHelper(Node * node) {
+template <class RecordManager, typename K, typename V>
+size_t AVLTree<RecordManager, K, V>::sumOfKeysHelper(Node * node) {
     if (node == NULL)
         return 0;
     return node->key + sumOfKeysHelper(node->left) + sumOfKeysHelper(node->right);
 }
 
-template <typename K, typename V>
-size_t AVLTree<K, V>::sumOfKeys() {
+template <class RecordManager, typename K, typename V>
+size_t AVLTree<RecordManager, K, V>::sumOfKeys() {
     return sumOfKeysHelper(root);
 }
 
-template <typename K, typename V>
-size_t AVLTree<K, V>::numKeysHelper(Node * node) {
+template <class RecordManager, typename K, typename V>
+size_t AVLTree<RecordManager, K, V>::numKeysHelper(Node * node) {
     if (node == NULL)
         return 0;
     return 1 + numKeysHelper(node->left) + numKeysHelper(node->right);
 }
 
-template <typename K, typename V>
-size_t AVLTree<K, V>::numKeys() {
+template <class RecordManager, typename K, typename V>
+size_t AVLTree<RecordManager, K, V>::numKeys() {
     return numKeysHelper(root);
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::printInOrderTraversal(Node * node) {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::printInOrderTraversal(Node * node) {
     if (node->left != NULL)
         printInOrderTraversal(node->left);
     
@@ -969,15 +1057,15 @@ void AVLTree<K, V>::printInOrderTraversal(Node * node) {
         printInOrderTraversal(node->right);
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::printInOrderTraversal() {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::printInOrderTraversal() {
     printf("start-");
     printInOrderTraversal(root);
     printf("end\n");
 }
 
-template <typename K, typename V>
-bool AVLTree<K, V>::doesAVLHold(Node * node) {
+template <class RecordManager, typename K, typename V>
+bool AVLTree<RecordManager, K, V>::doesAVLHold(Node * node) {
     bool holds = true;
     if ( node != NULL ) {
         if (node->left != NULL)
@@ -991,13 +1079,13 @@ bool AVLTree<K, V>::doesAVLHold(Node * node) {
     return holds;  
 }
 
-template <typename K, typename V>
-bool AVLTree<K, V>::checkAVL( ) {
+template <class RecordManager, typename K, typename V>
+bool AVLTree<RecordManager, K, V>::checkAVL( ) {
     return doesAVLHold(root);
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::printBFSOrder(Node * node) {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::printBFSOrder(Node * node) {
     if (node != NULL) {
         queue<Node *> q;;
         q.push(node);
@@ -1016,8 +1104,8 @@ void AVLTree<K, V>::printBFSOrder(Node * node) {
     }
 }
 
-template <typename K, typename V>
-void AVLTree<K, V>::printBFSOrder() {
+template <class RecordManager, typename K, typename V>
+void AVLTree<RecordManager, K, V>::printBFSOrder() {
     printBFSOrder(root);
 }
 
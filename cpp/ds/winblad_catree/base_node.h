@@ -14,11 +14,68 @@
 #ifndef BASE_NODE_H
 #define BASE_NODE_H
 
+#include <atomic>
+#include <algorithm>
 #include "route_node.h"
-#include "avl_tree.h"
+#include "util.h"
 
 #define BaseNodePtr BaseNode<K, V>*
 
+/**
+ * Statistics lock heuristics shared by all base nodes of one CA tree.
+ *
+ * The limits are the configured ones multiplied by a common scale. With
+ * adaptiveLimits, the scale doubles whenever an adaptation hits a base node
+ * that was created only oscillationWindow lock acquisitions ago (i.e., a
+ * split being undone by a join, or vice versa), and decays by one whenever an
+ * adaptation hits a long-lived base node.
+ */
+struct ContentionPolicy {
+    int highContentionLimit;
+    int lowContentionLimit;
+    int failureContrib;
+    int successContrib;
+    int rangeQueryContrib;
+    bool adaptiveLimits;
+    int oscillationWindow;
+    int maxLimitScale;
+    volatile char padding0[PADDING_BYTES];
+    std::atomic<int> limitScale;
+    std::atomic<long long> numSplits;
+    std::atomic<long long> numJoins;
+    std::atomic<long long> numOscillations;
+    volatile char padding1[PADDING_BYTES];
+
+    ContentionPolicy() : highContentionLimit(1000), lowContentionLimit(-1000)
+            , failureContrib(250), successContrib(1), rangeQueryContrib(100)
+            , adaptiveLimits(false), oscillationWindow(1000), maxLimitScale(64)
+            , limitScale(1), numSplits(0), numJoins(0), numOscillations(0) {}
+
+    int getHighContentionLimit() {
+        return highContentionLimit * limitScale.load(std::memory_order_relaxed);
+    }
+
+    int getLowContentionLimit() {
+        return lowContentionLimit * limitScale.load(std::memory_order_relaxed);
+    }
+
+    /* lockCount: lock acquisitions of the adapted base node since its creation */
+    void onAdaptation(bool isSplit, long long lockCount) {
+        (isSplit ? numSplits : numJoins).fetch_add(1, std::memory_order_relaxed);
+        if (!adaptiveLimits) return;
+        int scale = limitScale.load(std::memory_order_relaxed);
+        if (lockCount < oscillationWindow) {
+            numOscillations.fetch_add(1, std::memory_order_relaxed);
+            if (scale < maxLimitScale) {
+                limitScale.compare_exchange_strong(scale, std::min(2 * scale, maxLimitScale));
+            }
+        }
+        else if (scale > 1) {
+            limitScale.compare_exchange_strong(scale, scale - 1);
+        }
+    }
+};
+
 template <typename K, typename V>
 class BaseNode : public CA_Node {
 private:
@@ -27,16 +84,19 @@ private:
     /* For statistic locking */
     std::mutex m;
     int statLockStatistics;
+    long long lockCount;
     volatile int owner = -1;
     volatile bool valid;
 
+    /* Odd while the lock is held; optimistic readers validate against it */
+    std::atomic<uint64_t> version;
+
     RouteNodePtr volatile parent;
 
-    /* Contention heuristics */
-    static const int STAT_LOCK_HIGH_CONTENTION_LIMIT = 1000;
-    static const int STAT_LOCK_LOW_CONTENTION_LIMIT = -1000;
-    static const int STAT_LOCK_FAILURE_CONTRIB = 250;
-    static const int STAT_LOCK_SUCCESS_CONTRIB = 1;
+    ContentionPolicy * policy;
+    
+    void beginWrite();
+    void endWrite();
     
 public:
 
@@ -44,6 +104,7 @@ public:
     ~BaseNode();
     void setParent(RouteNodePtr newParent);
     RouteNodePtr getParent();
+    void setPolicy(ContentionPolicy * policy);
     
     /* Valid Status functions */
     bool isValid(const int tid) override;
@@ -55,11 +116,18 @@ public:
     bool tryLock(const int tid);
     int getStatistics();
     void resetStatistics();
+    void addStatistics(int contrib);
+    long long getLockCount();
     int getHighContentionLimit();
     int getLowContentionLimit();
     bool isHighContentionLimitReached();
     bool isLowContentionLimitReached();
     
+    /* Optimistic (lock-free) reads */
+    bool readBegin(uint64_t & observedVersion);
+    bool readValidate(uint64_t observedVersion);
+    bool isValidOptimistic();
+    
     /* */
     void setOrderedSet(IOSet * set);
     IOSet * getOrderedSet();
@@ -70,12 +138,21 @@ BaseNode<K, V>::BaseNode() {
     valid = true;
     isBaseNode = true;
     statLockStatistics = 0;
+    lockCount = 0;
+    version = 0;
     parent = NULL; 
+    set = NULL;
+    policy = NULL;
 }
 
 template <typename K, typename V>
 BaseNode<K, V>::~BaseNode() {
-    delete ((AVLTree<K,V>*)set);
+    delete set;
+}
+
+template <typename K, typename V>
+void BaseNode<K, V>::setPolicy(ContentionPolicy * policy) {
+    this->policy = policy;
 }
 
 template <typename K, typename V>
@@ -118,12 +195,27 @@ bool BaseNode<K, V>::isValid(const int tid) {
 /**
  * Statistic Lock Methods
  * 
+ * Every critical section is also a seqlock write section, so optimistic
+ * readers see an odd version while the set may be changing.
  */
+template <typename K, typename V>
+void BaseNode<K, V>::beginWrite() {
+    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+}
+
+template <typename K, typename V>
+void BaseNode<K, V>::endWrite() {
+    version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
 template <typename K, typename V>
 bool BaseNode<K, V>::tryLock(const int tid) {
     if (m.try_lock()) {
         assert(owner == -1);
         owner = tid;
+        beginWrite();
+        ++lockCount;
         return true;
     }
     return false;
@@ -134,18 +226,23 @@ void BaseNode<K, V>::lock(const int tid) {
     if ( m.try_lock() ) {
         assert(owner == -1);
         owner = tid;
-        statLockStatistics -= STAT_LOCK_SUCCESS_CONTRIB;
+        beginWrite();
+        ++lockCount;
+        statLockStatistics -= policy->successContrib;
         return;
     }
     m.lock(); /* Wait and lock */
     assert(owner == -1);
     owner = tid;
-    statLockStatistics += STAT_LOCK_FAILURE_CONTRIB;
+    beginWrite();
+    ++lockCount;
+    statLockStatistics += policy->failureContrib;
 }
 
 template <typename K, typename V>
 void BaseNode<K, V>::unlock(const int tid) {
     assert(owner == tid);
+    endWrite();
     owner = -1;
     m.unlock();
 }
@@ -160,24 +257,56 @@ void BaseNode<K, V>::resetStatistics() {
     statLockStatistics = 0;
 }
 
+template <typename K, typename V>
+void BaseNode<K, V>::addStatistics(int contrib) {
+    statLockStatistics += contrib;
+}
+
+template <typename K, typename V>
+long long BaseNode<K, V>::getLockCount() {
+    return lockCount;
+}
+
 template <typename K, typename V>
 int BaseNode<K, V>::getHighContentionLimit() {
-    return STAT_LOCK_HIGH_CONTENTION_LIMIT;
+    return policy->getHighContentionLimit();
 }
 
 template <typename K, typename V>
 int BaseNode<K, V>::getLowContentionLimit() {
-    return STAT_LOCK_LOW_CONTENTION_LIMIT;
+    return policy->getLowContentionLimit();
 }
 
 template <typename K, typename V>
 bool BaseNode<K, V>::isHighContentionLimitReached() {
-    return statLockStatistics > STAT_LOCK_HIGH_CONTENTION_LIMIT;
+    return statLockStatistics > policy->getHighContentionLimit();
 }
 
 template <typename K, typename V>
 bool BaseNode<K, V>::isLowContentionLimitReached() {
-    return statLockStatistics < STAT_LOCK_LOW_CONTENTION_LIMIT;
+    return statLockStatistics < policy->getLowContentionLimit();
+}
+
+/**
+ * Optimistic read methods
+ */
+template <typename K, typename V>
+bool BaseNode<K, V>::readBegin(uint64_t & observedVersion) {
+    observedVersion = version.load(std::memory_order_acquire);
+    return (observedVersion & 1) == 0;
+}
+
+template <typename K, typename V>
+bool BaseNode<K, V>::readValidate(uint64_t observedVersion) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version.load(std::memory_order_relaxed) == observedVersion;
+}
+
+/* Nodes are only invalidated under the lock, so a validated read of this flag
+   is consistent with the rest of the read section */
+template <typename K, typename V>
+bool BaseNode<K, V>::isValidOptimistic() {
+    return valid;
 }
 
 
@@ -17,6 +17,7 @@
 #include "base_node.h"
 #include "util.h"
 #include <queue>        /* used in BFS */
+#include <vector>
 #include "avl_tree.h"
 // #include "linkedlist.h"
 // #include "redblack_tree.h"
@@ -34,6 +35,9 @@ private:
     volatile char padding1[PADDING_BYTES];
     CA_Node* volatile root;
     volatile char padding2[PADDING_BYTES];
+    ContentionPolicy policy;
+    /* number of lock-free attempts before find falls back to the base node lock */
+    const int optimisticAttempts;
 
     /* Contention Adapting */
     void highContentionSplit(const int tid, BaseNodePtr baseNode);
@@ -41,7 +45,9 @@ private:
     void adaptIfNeeded(const int tid, BaseNodePtr baseNode);
     
     /* Helpers */
+    BaseNodePtr newBaseNode(const int tid, IOSet * set);
     BaseNodePtr getBaseNode(const K & key);
+    BaseNodePtr getBaseNode(const K & key, K & upperBound, bool & hasUpperBound);
     BaseNodePtr leftmostBaseNode(CA_Node * node);
     BaseNodePtr rightmostBaseNode(CA_Node * node);
     RouteNodePtr parentOf(RouteNodePtr node);
@@ -51,15 +57,20 @@ private:
     void freeSubtree(const int tid, CA_Node* node);
     
 public:
-    CATree(int totalThreads, K minKey, K maxKey, OrderedSetType type);
+    CATree(int totalThreads, K minKey, K maxKey, OrderedSetType type, int optimisticAttempts = 2);
     ~CATree();
     
     /* Set Operations */
     V find(const int tid, const K & key);
     V insert(const int tid, const K & key, const V& val);
     V erase(const int tid, const K & key);
+    int rangeQuery(const int tid, const K & lo, const K & hi, K * const resultKeys, V * const resultValues);
+    
+    /* Configure before the first operation */
+    ContentionPolicy * getContentionPolicy();
     
     void printDebuggingDetails();
+    void printSummary();
     long getSumOfKeys();
     CA_Node* getRoot();
 
@@ -69,15 +80,14 @@ public:
 };
 
 template <class RecordManager, typename K, typename V>
-CATree<RecordManager, K, V>::CATree(int _numThreads, K _minKey, K _maxKey, OrderedSetType type): 
-    numThreads(_numThreads), minKey(_minKey), maxKey(_maxKey), recmgr(new RecordManager(numThreads)) {
+CATree<RecordManager, K, V>::CATree(int _numThreads, K _minKey, K _maxKey, OrderedSetType type, int _optimisticAttempts): 
+    numThreads(_numThreads), minKey(_minKey), maxKey(_maxKey), recmgr(new RecordManager(numThreads)), optimisticAttempts(_optimisticAttempts) {
     const int tid = 0;
     initThread(tid);
-    BaseNodePtr baseRoot = recmgr->template allocate<BaseNode<K, V>>(tid);
     IOSet * set;
     switch ( type ) {
         case OrderedSetType::AVL:
-            set = new AVLTree<K, V>();
+            set = new AVLTree<RecordManager, K, V>(recmgr);
             cout << "using AVL TREE" << endl;
             break;
         // case OrderedSetType::LINKEDLIST:
@@ -92,8 +102,7 @@ CATree<RecordManager, K, V>::CATree(int _numThreads, K _minKey, K _maxKey, Order
             assert(false);
             break;
     }
-    baseRoot->setOrderedSet(set);
-    root = baseRoot;
+    root = newBaseNode(tid, set);
 }
 
 template <class RecordManager, typename K, typename V>
@@ -115,10 +124,25 @@ void CATree<RecordManager, K, V>::freeSubtree(const int tid, CA_Node* node) {
         recmgr->deallocate(tid, r);
     }
     else {
-        recmgr->deallocate(tid, (BaseNodePtr)node);
+        BaseNodePtr b = (BaseNodePtr) node;
+        b->getOrderedSet()->clear(tid);
+        recmgr->deallocate(tid, b);
     }
 }
 
+template <class RecordManager, typename K, typename V>
+BaseNodePtr CATree<RecordManager, K, V>::newBaseNode(const int tid, IOSet * set) {
+    BaseNodePtr baseNode = recmgr->template allocate<BaseNode<K, V>>(tid);
+    baseNode->setPolicy(&policy);
+    baseNode->setOrderedSet(set);
+    return baseNode;
+}
+
+template <class RecordManager, typename K, typename V>
+ContentionPolicy * CATree<RecordManager, K, V>::getContentionPolicy() {
+    return &policy;
+}
+
 template <class RecordManager, typename K, typename V>
 BaseNodePtr CATree<RecordManager, K, V>::getBaseNode(const K & key) {
     CA_Node * currNode = root;
@@ -134,6 +158,33 @@ BaseNodePtr CATree<RecordManager, K, V>::getBaseNode(const K & key) {
     return (BaseNodePtr)currNode;
 }
 
+/**
+ * Also returns the smallest route key greater than key on the search path,
+ * which is the upper bound of the returned base node's key range once that
+ * base node is locked and valid. The minimum (rather than the last left turn)
+ * stays correct if the search passes a route node that is being unlinked.
+ */
+template <class RecordManager, typename K, typename V>
+BaseNodePtr CATree<RecordManager, K, V>::getBaseNode(const K & key, K & upperBound, bool & hasUpperBound) {
+    hasUpperBound = false;
+    CA_Node * currNode = root;
+    while (!currNode->isBaseNode) {
+        RouteNodePtr currNodeR = (RouteNodePtr) currNode;
+        K routeKey = currNodeR->getKey();
+        if ( key < routeKey ) {
+            if (!hasUpperBound || routeKey < upperBound) {
+                upperBound = routeKey;
+                hasUpperBound = true;
+            }
+            currNode = currNodeR->getLeft();
+        }
+        else {
+            currNode = currNodeR->getRight();
+        }
+    }
+    return (BaseNodePtr)currNode;
+}
+
 template <class RecordManager, typename K, typename V>
 BaseNodePtr CATree<RecordManager, K, V>::leftmostBaseNode(CA_Node * node) {
     CA_Node * currNode = node;
@@ -212,9 +263,9 @@ void CATree<RecordManager, K, V>::lowContentionJoin(const int tid, BaseNodePtr b
             neighborSet->printKeys();
 #endif
             IOSet * joinedSet = baseSet->join(tid, neighborSet);
+            policy.onAdaptation(false, std::min(baseNode->getLockCount(), neighborBase->getLockCount()));
                         
-            BaseNodePtr newBase = recmgr->template allocate<BaseNode<K, V>>(tid);
-            newBase->setOrderedSet(joinedSet);
+            BaseNodePtr newBase = newBaseNode(tid, joinedSet);
             parent->lock(tid);
             RouteNodePtr gparent = NULL;
             
@@ -299,8 +350,8 @@ void CATree<RecordManager, K, V>::lowContentionJoin(const int tid, BaseNodePtr b
             neighborSet->printKeys();
 #endif            
             IOSet * joinedSet = neighborSet->join(tid, baseSet);
-            BaseNodePtr newBase = recmgr->template allocate<BaseNode<K, V>>(tid);
-            newBase->setOrderedSet(joinedSet);
+            policy.onAdaptation(false, std::min(baseNode->getLockCount(), neighborBase->getLockCount()));
+            BaseNodePtr newBase = newBaseNode(tid, joinedSet);
             parent->lock(tid);
             RouteNodePtr gparent = NULL;
             
@@ -387,10 +438,9 @@ void CATree<RecordManager, K, V>::highContentionSplit(int tid, BaseNodePtr baseN
         return;
     }
 
-    BaseNodePtr newLeftBase = recmgr->template allocate<BaseNode<K, V>>(tid);
-    BaseNodePtr newRightBase = recmgr->template allocate<BaseNode<K, V>>(tid);
-    newLeftBase->setOrderedSet(leftSet);
-    newRightBase->setOrderedSet(rightSet);
+    policy.onAdaptation(true, baseNode->getLockCount());
+    BaseNodePtr newLeftBase = newBaseNode(tid, leftSet);
+    BaseNodePtr newRightBase = newBaseNode(tid, rightSet);
     
 #if DEBUG_PRINT
     cout << "Left List: ";
@@ -431,9 +481,25 @@ void CATree<RecordManager, K, V>::highContentionSplit(int tid, BaseNodePtr baseN
  */
 template <class RecordManager, typename K, typename V>
 V CATree<RecordManager, K, V>::find(const int tid, const K & key) {
-    while (true) {
+    /* Seqlock-validated lookup: does not touch the statistics lock, so
+       read-mostly base nodes neither serialize nor look contended */
+    for (int attempt = 0; attempt < optimisticAttempts; ++attempt) {
         auto guard = recmgr->getGuard(tid, true);
         BaseNodePtr baseNode = getBaseNode(key);
+        uint64_t version;
+        if (!baseNode->readBegin(version) || !baseNode->isValidOptimistic()) {
+            continue;
+        }
+        bool ok;
+        V result = baseNode->getOrderedSet()->findOptimistic(tid, key, ok);
+        if (ok && baseNode->readValidate(version)) {
+            return result;
+        }
+    }
+    
+    while (true) {
+        auto guard = recmgr->getGuard(tid);
+        BaseNodePtr baseNode = getBaseNode(key);
         baseNode->lock(tid);
         
         if (baseNode->isValid(tid) == false) {
@@ -453,7 +519,7 @@ V CATree<RecordManager, K, V>::insert(const int tid, const K & key, const V & va
     assert( (key >= minKey) && (key <= maxKey) );
     
     while (true) {
-        auto guard = recmgr->getGuard(tid, true);
+        auto guard = recmgr->getGuard(tid);
         BaseNodePtr baseNode = getBaseNode(key);
         baseNode->lock(tid);
         
@@ -473,7 +539,7 @@ template <class RecordManager, typename K, typename V>
 V CATree<RecordManager, K, V>::erase(const int tid, const K & key) {
     assert( (key >= minKey) && (key <= maxKey) );
     while (true) {
-        auto guard = recmgr->getGuard(tid, true);
+        auto guard = recmgr->getGuard(tid);
         BaseNodePtr baseNode = getBaseNode(key);
         baseNode->lock(tid);
         
@@ -489,6 +555,65 @@ V CATree<RecordManager, K, V>::erase(const int tid, const K & key) {
     }
 }
 
+/**
+ * Locks the base nodes covering [lo, hi] in key order, which makes the result
+ * atomic. Locking in key order cannot deadlock: single-key operations hold one
+ * base node, and joins only tryLock their neighbor.
+ */
+template <class RecordManager, typename K, typename V>
+int CATree<RecordManager, K, V>::rangeQuery(const int tid, const K & lo, const K & hi, K * const resultKeys, V * const resultValues) {
+    auto guard = recmgr->getGuard(tid);
+    std::vector<BaseNodePtr> lockedBaseNodes;
+    K searchKey = lo;
+    while (true) {
+        K upperBound;
+        bool hasUpperBound;
+        BaseNodePtr baseNode = getBaseNode(searchKey, upperBound, hasUpperBound);
+        baseNode->lock(tid);
+        if (baseNode->isValid(tid) == false) {
+            baseNode->unlock(tid);
+            continue;
+        }
+        /* the range of a locked, valid base node is fixed, but the bound seen
+           before locking may predate a split of this base node */
+        if (getBaseNode(searchKey, upperBound, hasUpperBound) != baseNode) {
+            baseNode->unlock(tid);
+            continue;
+        }
+        assert(lockedBaseNodes.empty() || lockedBaseNodes.back() != baseNode);
+        lockedBaseNodes.push_back(baseNode);
+        if (!hasUpperBound || hi < upperBound) {
+            break;
+        }
+        searchKey = upperBound;
+    }
+    
+    int size = 0;
+    for (BaseNodePtr baseNode : lockedBaseNodes) {
+        size += baseNode->getOrderedSet()->rangeQuery(tid, lo, hi, resultKeys + size, resultValues + size);
+    }
+    
+    /* Range queries that span several base nodes push them towards joining */
+    const bool spansBaseNodes = lockedBaseNodes.size() > 1;
+    for (auto it = lockedBaseNodes.rbegin(); it != lockedBaseNodes.rend(); ++it) {
+        if (spansBaseNodes) {
+            (*it)->addStatistics(-policy.rangeQueryContrib);
+        }
+        (*it)->unlock(tid);
+    }
+    return size;
+}
+
+template <class RecordManager, typename K, typename V>
+void CATree<RecordManager, K, V>::printSummary() {
+    cout << "catree_high_contention_limit=" << policy.getHighContentionLimit() << endl;
+    cout << "catree_low_contention_limit=" << policy.getLowContentionLimit() << endl;
+    cout << "catree_limit_scale=" << policy.limitScale << endl;
+    cout << "catree_num_splits=" << policy.numSplits << endl;
+    cout << "catree_num_joins=" << policy.numJoins << endl;
+    cout << "catree_num_oscillations=" << policy.numOscillations << endl;
+}
+
 template <class RecordManager, typename K, typename V>
 void CATree<RecordManager, K, V>::printDebuggingDetails() {
     /* Tree walk the CA Tree and count the number of Base Nodes and Route Nodes */
@@ -16,7 +16,11 @@
 template <typename K, typename V>
 class IOrderedSet {
 public:
+    virtual ~IOrderedSet() {}
     virtual V find(const int tid, const K & key) = 0;
+    /* Lookup without the base node lock. Sets that cannot be traversed
+       concurrently with updates report ok == false */
+    virtual V findOptimistic(const int tid, const K & key, bool & ok) { ok = false; return (V) 0; }
     virtual V insert(const int tid, const K & key, const V& val) = 0;
     virtual V erase(const int tid, const K & key) = 0;
     //virtual void printKeys() = 0;
@@ -24,6 +28,10 @@ public:
     virtual size_t sumOfKeys() = 0;
     virtual IOSet * join(const int tid, IOSet * rightSet) = 0;
     virtual std::tuple<K, IOSet *, IOSet *> split(const int tid) = 0;
+    /* Appends the keys in [lo, hi] in ascending order, returns the number appended */
+    virtual int rangeQuery(const int tid, const K & lo, const K & hi, K * const resultKeys, V * const resultValues) { assert(false); return 0; }
+    /* Frees all keys. Sets that reclaim nodes through the record manager need the tid */
+    virtual void clear(const int tid) {}
 };
 
 class CA_Node {
@@ -2,10 +2,7 @@
 
 #include <algorithm>
 
-#ifdef KEY_SEARCH_TOTAL_STAT
-extern int64_t key_search_total_iters_cnt__;
-extern int64_t key_search_total_cnt__;
-#endif
+#include "../../../common/key_stats.h"
 
 template<typename Key, typename Value, int kMaxKeys>
 struct BTreeNode {
@@ -12,15 +12,9 @@
 
 #include "gsat_node_handler.h"
 
-#ifdef KEY_DEPTH_TOTAL_STAT
-extern int64_t key_depth_total_sum__;
-extern int64_t key_depth_total_cnt__;
-#endif
+#include "../../../common/key_stats.h"
 
-#ifdef KEY_DEPTH_STAT
-extern int64_t* key_depth_sum__;
-extern int64_t* key_depth_cnt__;
-#endif
+#include "../../../common/key_depth_latency.h"
 
 #define KEY_FOUND (index != node->rep_size && node->rep[index] == key)
 
@@ -80,7 +74,9 @@ public:
 
         Value result = no_value_;
 
+        KEY_DEPTH_LATENCY_BEGIN();
         while (node) {
+            KEY_DEPTH_LATENCY_TOUCH(node);
             if (node->Access() && !rebuild_node) {
                 rebuild_node = node;
                 rebuild_node_at = node_at;
@@ -135,7 +131,9 @@ public:
 
         Value result = no_value_;
 
+        KEY_DEPTH_LATENCY_BEGIN();
         while (true) {
+            KEY_DEPTH_LATENCY_TOUCH(node);
             ++node->total_asize;
 
             if (node->Access() && !rebuild_node) {
@@ -194,7 +192,9 @@ public:
 
         Value result = no_value_;
 
+        KEY_DEPTH_LATENCY_BEGIN();
         while (node) {
+            KEY_DEPTH_LATENCY_TOUCH(node);
             if (node->Access() && !rebuild_node) {
                 rebuild_node = node;
                 rebuild_node_at = node_at;
@@ -5,10 +5,7 @@
 
 #include "id.h"
 
-#ifdef KEY_SEARCH_TOTAL_STAT
-extern int64_t key_search_total_iters_cnt__;
-extern int64_t key_search_total_cnt__;
-#endif
+#include "../../../common/key_stats.h"
 
 template<typename Key, typename Value>
 struct ISTNode {
@@ -4,10 +4,7 @@
 #include "../ist/id.h"
 #include <cmath>
 
-#ifdef KEY_SEARCH_TOTAL_STAT
-extern int64_t key_search_total_iters_cnt__;
-extern int64_t key_search_total_cnt__;
-#endif
+#include "../../../common/key_stats.h"
 
 #ifndef ALPHA
 #define ALPHA 0.5 // can be arbitrary between [0.5, 1)
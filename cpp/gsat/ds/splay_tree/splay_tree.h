@@ -8,15 +8,7 @@
 #include "splay_node.h"
 #include "splay_node_handler.h"
 
-#ifdef KEY_DEPTH_TOTAL_STAT
-extern int64_t key_depth_total_sum__;
-extern int64_t key_depth_total_cnt__;
-#endif
-
-#ifdef KEY_DEPTH_STAT
-extern int64_t* key_depth_sum__;
-extern int64_t* key_depth_cnt__;
-#endif
+#include "../../../common/key_stats.h"
 
 template <typename Key, typename Value>
 class SplayTree {
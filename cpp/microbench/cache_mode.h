@@ -0,0 +1,111 @@
+/**
+ * State of the caches at the start of the test stage (-cache-mode <mode>).
+ *
+ * By default the test stage starts right after the prefill (or warm up)
+ * stage, so it starts with whatever that stage left in the caches and the
+ * TLBs. The modes make that state explicit:
+ *   - cold: the nodes of the data structure are flushed with clflush, from
+ *     every cache of the machine, through a traversal of their node handlers
+ *     (so the cold mode needs a USE_TREE_STATS build, and a data structure
+ *     with a node handler). Then each thread of the test stage, bound to its
+ *     core, writes and flushes its own buffer, which evicts everything else
+ *     from the private caches and the TLBs of that core: the buffers add up
+ *     to CACHE_FLUSH_LLC_MULTIPLE times the last level cache, and each of
+ *     them has at least CACHE_FLUSH_LLC_MULTIPLE times the L2 cache and
+ *     CACHE_FLUSH_MIN_THREAD_BYTES, in small pages (many more than the TLBs
+ *     have entries). Finally the page cache is dropped (this needs root;
+ *     otherwise it is skipped with a warning);
+ *   - warm: every key of the range is searched once by the threads of the
+ *     test stage (bound as in the test stage), each over its own contiguous
+ *     part of the range;
+ *   - both: the benchmark runs twice with the same seed, warm and then cold,
+ *     and the throughputs are compared (cold relative to warm).
+ *
+ * The cost of the first touches is spread over the whole test stage, so it
+ * shows best with a short test stage or with -sample-interval.
+ */
+
+#ifndef SETBENCH_CACHE_MODE_H
+#define SETBENCH_CACHE_MODE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <x86intrin.h>
+#include "errors.h"
+#include "plaf.h"
+
+#ifndef CACHE_FLUSH_LLC_MULTIPLE
+#define CACHE_FLUSH_LLC_MULTIPLE 4
+#endif
+#ifndef CACHE_FLUSH_MIN_THREAD_BYTES
+#define CACHE_FLUSH_MIN_THREAD_BYTES (16 << 20)
+#endif
+
+enum class CacheMode {
+    DEFAULT, COLD, WARM
+};
+
+std::string cacheModeToString(CacheMode mode) {
+    switch (mode) {
+        case CacheMode::COLD:
+            return "cold";
+        case CacheMode::WARM:
+            return "warm";
+        default:
+            return "default";
+    }
+}
+
+// the modes to run, in order ("both" is warm, then cold)
+std::vector<CacheMode> parseCacheModes(const std::string &name) {
+    if (name == "cold") return {CacheMode::COLD};
+    if (name == "warm") return {CacheMode::WARM};
+    if (name == "both") return {CacheMode::WARM, CacheMode::COLD};
+    if (name == "default") return {CacheMode::DEFAULT};
+    setbench_error("unknown cache mode " << name << " (expected cold, warm, both or default)");
+}
+
+size_t lastLevelCacheBytes() {
+    long bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (bytes <= 0) bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return (bytes > 0) ? bytes : (32 << 20);
+}
+
+// of the buffer that each thread sweeps
+size_t minThreadSweepBytes() {
+    long l2Bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2Bytes <= 0) l2Bytes = 1 << 20;
+    return std::max((size_t) CACHE_FLUSH_LLC_MULTIPLE * l2Bytes, (size_t) CACHE_FLUSH_MIN_THREAD_BYTES);
+}
+
+void sweepCaches(size_t bytes) {
+    char *buffer = (char *) mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buffer == MAP_FAILED) {
+        setbench_error("cache sweep: could not map " << bytes << " bytes");
+    }
+    // (small pages, so that the buffer also evicts the TLBs)
+    madvise(buffer, bytes, MADV_NOHUGEPAGE);
+    for (size_t i = 0; i < bytes; i += BYTES_IN_CACHE_LINE) {
+        buffer[i] = (char) i;
+    }
+    // (so that the test stage does not start by writing the buffer back)
+    for (size_t i = 0; i < bytes; i += BYTES_IN_CACHE_LINE) {
+        _mm_clflush(buffer + i);
+    }
+    _mm_mfence();
+    munmap(buffer, bytes);
+}
+
+bool dropPageCache() {
+    sync();
+    FILE *f = fopen("/proc/sys/vm/drop_caches", "w");
+    if (f == NULL) return false;
+    bool dropped = fputs("3", f) >= 0;
+    return (fclose(f) == 0) && dropped;
+}
+
+#endif //SETBENCH_CACHE_MODE_H
@@ -32,6 +32,9 @@
             gstats_output_item(PRINT_RAW, SUM, BY_THREAD) \
       __AND gstats_output_item(PRINT_RAW, SUM, TOTAL) \
     }) \
+    gstats_handle_stat(LONG_LONG, num_rq_keys, 1, { \
+            gstats_output_item(PRINT_RAW, SUM, TOTAL) \
+    }) \
     gstats_handle_stat(LONG_LONG, num_successful_inserts, 1, { \
             gstats_output_item(PRINT_RAW, SUM, BY_THREAD) \
       __AND gstats_output_item(PRINT_RAW, SUM, TOTAL) \
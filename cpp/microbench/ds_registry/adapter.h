@@ -0,0 +1,264 @@
+/**
+ * Adapter of the registry build (make registry): the adapters of several data
+ * structures are compiled into one binary, and -ds <name> selects the one a
+ * run uses.
+ *
+ * The Makefile generates ds_registry_list.h, which includes the adapter of
+ * each data structure of REGISTRY_DATA_STRUCTURES in its own namespace
+ * (ds_registry_<name>), and defines DS_REGISTRY_FOR_EACH(F) as F(<name>) for
+ * each of them. This ds_adapter has the interface of the other adapters, and
+ * forwards every call with std::visit to a pointer to the adapter of the
+ * selected data structure: visit instantiates the call for each adapter type,
+ * so the hot operations are direct (inlinable) calls of the concrete adapter
+ * behind a single jump on the index of the selected data structure.
+ *
+ * The headers that the data structures share are included below, before
+ * the namespaces, so that their include guards keep a single global copy.
+ * Data structures whose own headers share include guards (e.g., the variants
+ * of one tree) cannot be in the same registry build.
+ *
+ * The registry adapter supports the aggregate and visitor range queries
+ * (DS_ADAPTER_SUPPORTS_RQ_AGGREGATE and DS_ADAPTER_SUPPORTS_RQ_VISIT) for
+ * every data structure: each of them calls rangeQueryAggregate or
+ * rangeQueryVisit of the selected adapter if it has them, and otherwise
+ * materializes the range with its rangeQuery, into per-thread arrays.
+ */
+
+#ifndef DS_REGISTRY_ADAPTER_H
+#define DS_REGISTRY_ADAPTER_H
+
+#include <bits/stdc++.h>
+#include <immintrin.h>
+#include <x86intrin.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef USE_LIBNUMA
+#   include <numa.h>
+#endif
+#include "errors.h"
+#include "plaf.h"
+#include "record_manager.h"
+#include "locks_impl.h"
+#include "rwlock.h"
+#include "prefetching.h"
+#include "descriptors.h"
+#include "scx_provider.h"
+#include "dcss_impl.h"
+#include "multi_counter.h"
+#include "random_xoshiro256p.h"
+#include "ds_parameters.h"
+#include "rq_provider.h"
+#include "rq_aggregate.h"
+#include "key_depth_latency.h"
+#include "key_stats.h"
+#ifdef USE_TREE_STATS
+#   define TREE_STATS_BYTES_AT_DEPTH
+#   include "tree_stats.h"
+#endif
+
+// the IDs of the GSTATS trackers of a data structure are declared out of its namespace,
+// where main.cpp defines them
+#pragma push_macro("__DECLARE_EXTERN_STAT_ID")
+#undef __DECLARE_EXTERN_STAT_ID
+#define __DECLARE_EXTERN_STAT_ID(data_type, stat_name_token, stat_capacity, stats_output_items) \
+    } extern int stat_name_token; namespace DS_REGISTRY_NAMESPACE {
+#include "ds_registry_list.h" /* generated by the Makefile */
+#pragma pop_macro("__DECLARE_EXTERN_STAT_ID")
+
+namespace ds_registry {
+#define DS_REGISTRY_NAME(name) #name,
+    inline const std::vector<std::string> names = { DS_REGISTRY_FOR_EACH(DS_REGISTRY_NAME) };
+#undef DS_REGISTRY_NAME
+
+    // index in names of the data structure that the next ds_adapter creates
+    inline size_t selected = 0;
+
+    inline size_t indexOf(const std::string & name) {
+        for (size_t i = 0; i < names.size(); ++i) {
+            if (names[i] == name) return i;
+        }
+        std::string available;
+        for (auto & n : names) available += " " + n;
+        setbench_error("data structure " << name << " is not in this registry build (available:" << available << ")");
+    }
+
+    inline void select(const std::string & name) {
+        selected = indexOf(name);
+    }
+
+    // (the first type is a placeholder, so that DS_REGISTRY_FOR_EACH can put a comma before every adapter type)
+    template <typename Placeholder, typename... Adapters>
+    using adapter_variant = std::variant<Adapters *...>;
+
+    // whether an adapter has rangeQueryAggregate / rangeQueryVisit
+    template <typename Adapter, typename K, typename = void>
+    struct has_rq_aggregate : std::false_type {};
+    template <typename Adapter, typename K>
+    struct has_rq_aggregate<Adapter, K, std::void_t<decltype(std::declval<Adapter &>().rangeQueryAggregate(
+            0, std::declval<const K &>(), std::declval<const K &>()))>> : std::true_type {};
+
+    template <typename Adapter, typename K, typename = void>
+    struct has_rq_visit : std::false_type {};
+    template <typename Adapter, typename K>
+    struct has_rq_visit<Adapter, K, std::void_t<decltype(std::declval<Adapter &>().rangeQueryVisit(
+            0, std::declval<const K &>(), std::declval<const K &>(), std::declval<rq_aggregate<K> &>()))>> : std::true_type {};
+
+#ifdef USE_TREE_STATS
+    // the TreeStats of the data structures are templates of their node handlers
+    class tree_stats {
+    public:
+        virtual ~tree_stats() {}
+        virtual std::string toString() = 0;
+        virtual size_t getKeys() = 0;
+        virtual size_t getSumOfKeys() = 0;
+        virtual size_t getSampleWalks() = 0;
+    };
+
+    template <typename TreeStatsT>
+    class tree_stats_of : public tree_stats {
+        TreeStatsT * const stats;
+    public:
+        tree_stats_of(TreeStatsT * const _stats) : stats(_stats) {}
+        ~tree_stats_of() { delete stats; }
+        std::string toString() { return stats->toString(); }
+        size_t getKeys() { return stats->getKeys(); }
+        size_t getSumOfKeys() { return stats->getSumOfKeys(); }
+        size_t getSampleWalks() { return stats->getSampleWalks(); }
+    };
+#endif
+}
+
+template <typename K, typename V, class Reclaim = reclaimer_debra<K>, class Alloc = allocator_new<K>, class Pool = pool_none<K>>
+class ds_adapter {
+private:
+#define DS_REGISTRY_ADAPTER_T(name) , ds_registry_##name::ds_adapter<K, V, Reclaim, Alloc, Pool>
+    typedef ds_registry::adapter_variant<void DS_REGISTRY_FOR_EACH(DS_REGISTRY_ADAPTER_T)> variant_t;
+#undef DS_REGISTRY_ADAPTER_T
+
+    const variant_t ds;
+
+    template <typename Adapter, typename Visitor>
+    static void visitRange(Adapter * const adapter, const int tid, const K& lo, const K& hi, Visitor& visit) {
+        if constexpr (ds_registry::has_rq_visit<Adapter, K>::value) {
+            adapter->rangeQueryVisit(tid, lo, hi, visit);
+        } else {
+            visitByRangeQuery(adapter, tid, lo, hi, visit);
+        }
+    }
+
+    // (the range has at most hi - lo + 1 keys, but rangeQuery may use up to a node more of the arrays)
+    template <typename Adapter, typename Visitor>
+    static void visitByRangeQuery(Adapter * const adapter, const int tid, const K& lo, const K& hi, Visitor& visit) {
+        static thread_local std::vector<K> keys;
+        static thread_local std::vector<V> values;
+        const size_t capacity = (size_t) (hi - lo + 1) + MAX_KEYS_PER_NODE;
+        if (keys.size() < capacity) {
+            keys.resize(capacity);
+            values.resize(capacity);
+        }
+        const int n = adapter->rangeQuery(tid, lo, hi, keys.data(), values.data());
+        for (int i = 0; i < n; ++i) {
+            visit(keys[i], values[i]);
+        }
+    }
+
+    template <size_t I = 0>
+    static variant_t create(const size_t index, const int NUM_THREADS, const K& KEY_ANY, const K& KEY_MAX, const V& NO_VALUE, Random64 * const rngs) {
+        if constexpr (I < std::variant_size_v<variant_t>) {
+            if (index != I) {
+                return create<I + 1>(index, NUM_THREADS, KEY_ANY, KEY_MAX, NO_VALUE, rngs);
+            }
+            typedef std::remove_pointer_t<std::variant_alternative_t<I, variant_t>> adapter_t;
+            return variant_t(std::in_place_index<I>, new adapter_t(NUM_THREADS, KEY_ANY, KEY_MAX, NO_VALUE, rngs));
+        } else {
+            setbench_error("no data structure with index " << index << " in this registry build");
+        }
+    }
+
+public:
+    ds_adapter(const int NUM_THREADS,
+               const K& KEY_ANY,
+               const K& KEY_MAX,
+               const V& NO_VALUE,
+               Random64 * const rngs)
+    : ds(create(ds_registry::selected, NUM_THREADS, KEY_ANY, KEY_MAX, NO_VALUE, rngs))
+    {}
+
+    ~ds_adapter() {
+        std::visit([](auto adapter) { delete adapter; }, ds);
+    }
+
+    V getNoValue() {
+        return std::visit([](auto adapter) -> V { return (V) adapter->getNoValue(); }, ds);
+    }
+
+    void initThread(const int tid) {
+        std::visit([&](auto adapter) { adapter->initThread(tid); }, ds);
+    }
+    void deinitThread(const int tid) {
+        std::visit([&](auto adapter) { adapter->deinitThread(tid); }, ds);
+    }
+
+    bool contains(const int tid, const K& key) {
+        return std::visit([&](auto adapter) -> bool { return adapter->contains(tid, key); }, ds);
+    }
+    V insert(const int tid, const K& key, const V& val) {
+        return std::visit([&](auto adapter) -> V { return (V) adapter->insert(tid, key, val); }, ds);
+    }
+    V insertIfAbsent(const int tid, const K& key, const V& val) {
+        return std::visit([&](auto adapter) -> V { return (V) adapter->insertIfAbsent(tid, key, val); }, ds);
+    }
+    V erase(const int tid, const K& key) {
+        return std::visit([&](auto adapter) -> V { return (V) adapter->erase(tid, key); }, ds);
+    }
+    V find(const int tid, const K& key) {
+        return std::visit([&](auto adapter) -> V { return (V) adapter->find(tid, key); }, ds);
+    }
+    int rangeQuery(const int tid, const K& lo, const K& hi, K * const resultKeys, V * const resultValues) {
+        return std::visit([&](auto adapter) -> int { return adapter->rangeQuery(tid, lo, hi, resultKeys, resultValues); }, ds);
+    }
+
+    #define DS_ADAPTER_SUPPORTS_RQ_AGGREGATE
+    #define DS_ADAPTER_SUPPORTS_RQ_VISIT
+    rq_aggregate<K> rangeQueryAggregate(const int tid, const K& lo, const K& hi) {
+        return std::visit([&](auto adapter) -> rq_aggregate<K> {
+            typedef std::remove_pointer_t<decltype(adapter)> adapter_t;
+            if constexpr (ds_registry::has_rq_aggregate<adapter_t, K>::value) {
+                return adapter->rangeQueryAggregate(tid, lo, hi);
+            } else {
+                rq_aggregate<K> aggregate;
+                visitRange(adapter, tid, lo, hi, aggregate);
+                return aggregate;
+            }
+        }, ds);
+    }
+    template <typename Visitor>
+    void rangeQueryVisit(const int tid, const K& lo, const K& hi, Visitor& visit) {
+        std::visit([&](auto adapter) { visitRange(adapter, tid, lo, hi, visit); }, ds);
+    }
+
+    void printSummary() {
+        std::visit([](auto adapter) { adapter->printSummary(); }, ds);
+    }
+    bool validateStructure() {
+        return std::visit([](auto adapter) -> bool { return adapter->validateStructure(); }, ds);
+    }
+    void printObjectSizes() {
+        std::visit([](auto adapter) { adapter->printObjectSizes(); }, ds);
+    }
+    void debugGCSingleThreaded() {
+        std::visit([](auto adapter) { adapter->debugGCSingleThreaded(); }, ds);
+    }
+
+#ifdef USE_TREE_STATS
+    ds_registry::tree_stats * createTreeStats(const K& _minKey, const K& _maxKey) {
+        return std::visit([&](auto adapter) -> ds_registry::tree_stats * {
+            auto stats = adapter->createTreeStats(_minKey, _maxKey);
+            if (stats == NULL) return NULL;
+            return new ds_registry::tree_stats_of<std::remove_pointer_t<decltype(stats)>>(stats);
+        }, ds);
+    }
+#endif
+};
+
+#endif /* DS_REGISTRY_ADAPTER_H */
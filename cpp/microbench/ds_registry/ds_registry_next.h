@@ -0,0 +1,15 @@
+/**
+ * Included by ds_registry_list.h after the adapter of each data structure of
+ * a registry build (see adapter.h), so that the next adapter can be included
+ * and define its macros (no include guard on purpose).
+ */
+
+#undef DS_ADAPTER_H
+#undef NODE_T
+#undef RECORD_MANAGER_T
+#undef DATA_STRUCTURE_T
+#undef DS_ADAPTER_SUPPORTS_RQ_AGGREGATE
+#undef DS_ADAPTER_SUPPORTS_RQ_VISIT
+#undef DS_ADAPTER_SUPPORTS_RQ_SNAPSHOT
+#undef DS_ADAPTER_SUPPORTS_TERMINAL_ITERATE
+#undef DS_REGISTRY_NAMESPACE
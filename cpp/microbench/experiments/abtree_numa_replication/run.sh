@@ -0,0 +1,144 @@
+#!/bin/bash
+
+#########################################################################
+#### NUMA replication of the top levels of brown_ext_abtree_lf
+#### (-ds-param abtree.replicaLevels=<k>), on a search-heavy and an
+#### update-heavy workload, with threads scattered over the sockets.
+####
+#### build the binary first with: cd ../.. ; make brown_ext_abtree_lf.debra -j
+####
+#### if perf can count them, every run also counts the cross-socket
+#### traffic with the uncore UPI (or QPI) counters, or else the remote
+#### cache hits and remote DRAM accesses of the cores. the table at the
+#### end (also in table.txt) has, per (workload, levels):
+####   total_thr         operations per second
+####   replica_hits      operations that started below the replicated levels
+####   replica_rebuilds  replicas rebuilt because the top levels changed
+####   remote_per_op     cross-socket events (see above) per operation
+#########################################################################
+
+t=10000
+num_trials=3
+k=2000000
+levels="0 1 2 3"
+workloads="search update"
+binary=../../bin/brown_ext_abtree_lf.debra
+
+## if user provides any argument, then we are running in TESTING mode, with 100ms runs
+if [ "$1" != "" ]; then
+    echo "*** WARNING *** running in TESTING mode (100ms runs; one trial)"
+    t=100
+    num_trials=1
+fi
+
+if [ ! -x "$binary" ]; then
+    echo "$binary not found"
+    exit 1
+fi
+
+nthreads=`cd .. ; ./get_thread_count_max.sh`
+
+## the first event list that perf can count (system wide, since the uncore is shared)
+perf_events=""
+for events in \
+        "uncore_upi/event=0x2,umask=0xf/" \
+        "uncore_qpi/event=0x2,umask=0xf/" \
+        "offcore_response.demand_data_rd.l3_miss.remote_hitm,offcore_response.demand_data_rd.l3_miss.remote_dram" \
+        "mem_load_l3_miss_retired.remote_hitm,mem_load_l3_miss_retired.remote_dram" ; do
+    if perf stat -a -x, -e "$events" true > /dev/null 2>&1 ; then
+        perf_events="$events"
+        break
+    fi
+done
+if [ "$perf_events" == "" ]; then
+    echo "perf cannot count cross-socket events here: remote_per_op will be 0"
+fi
+
+exp="`pwd | rev | cut -d'/' -f1 | rev`"
+mkdir $exp 2>/dev/null
+
+## $1 = file, $2 = insert ratio, $3 = remove ratio
+write_test_json() {
+    cat > $1 <<END
+{
+    "stopCondition": { "ClassName": "Timer", "workTime": $t },
+    "threadLoopBuilders": [
+        {
+            "quantity": $nthreads,
+            "pinPolicy": "Scatter",
+            "threadLoopBuilder": {
+                "ClassName": "DefaultThreadLoopBuilder",
+                "argsGeneratorBuilder": {
+                    "ClassName": "DefaultArgsGeneratorBuilder",
+                    "dataMapBuilder": { "ClassName": "IdDataMapBuilder", "id": 0 },
+                    "distributionBuilder": { "ClassName": "UniformDistributionBuilder" }
+                },
+                "parameters": { "insertRatio": $2, "removeRatio": $3, "rqRatio": 0.0 }
+            }
+        }
+    ]
+}
+END
+}
+
+## $1 = step file
+get() {
+    grep -m1 "^$2=" $1 | cut -d"=" -f2
+}
+
+started=`date`
+step=0
+rm -f $exp/summary.txt
+for ((trial=0;trial<num_trials;++trial)) ; do
+    for workload in $workloads ; do
+        for level in $levels ; do
+            step=$((step+1))
+            f="$exp/step$step"
+            if [ "$workload" == "search" ]; then
+                write_test_json $f.test.json 0.01 0.01
+            else
+                write_test_json $f.test.json 0.25 0.25
+            fi
+            cmd="$binary -range $k -create-default-prefill -test $f.test.json -ds-param abtree.replicaLevels=$level -result-file $f.result.json"
+            if [ "$perf_events" != "" ]; then
+                cmd="perf stat -a -x, -o $f.perf -e $perf_events $cmd"
+            fi
+            echo "cmd=$cmd" > $f.txt
+            echo "workload=$workload" >> $f.txt
+            echo "replica_levels=$level" >> $f.txt
+            eval $cmd >> $f.txt 2>&1
+            if [ "$?" -ne "0" ]; then
+                cat $f.txt
+            fi
+            remote=0
+            if [ -e $f.perf ]; then
+                ## sum of the counts of all events (and all uncore units)
+                remote=`grep -v "^#" $f.perf | awk -F, '$1 ~ /^[0-9]+$/ { s += $1 } END { print s+0 }'`
+            fi
+            hits=`get $f.txt abtree_replica_hits` ; hits=${hits:-0}
+            rebuilds=`get $f.txt abtree_replica_rebuilds` ; rebuilds=${rebuilds:-0}
+            echo "$trial $workload $level `get $f.txt total_throughput` $hits $rebuilds $remote `get $f.txt total_ops`" >> $exp/summary.txt
+            echo "step $step: workload=$workload replica_levels=$level `grep -m1 total_throughput= $f.txt`"
+        done
+    done
+done
+
+## one row per (workload, levels), averaged over the trials
+awk '
+    {
+        key = $2" "$3
+        if (!(key in n)) order[++rows] = key
+        thr[key] += $4; hits[key] += $5; rebuilds[key] += $6
+        if ($8 > 0) remote[key] += $7 / $8
+        n[key]++
+    }
+    END {
+        printf "%-10s %8s %14s %14s %16s %14s\n", "workload", "levels", "total_thr", "replica_hits", "replica_rebuilds", "remote_per_op"
+        for (i = 1; i <= rows; ++i) {
+            key = order[i]; split(key, f, " ")
+            printf "%-10s %8s %14d %14d %16d %14.3f\n", f[1], f[2], thr[key] / n[key], hits[key] / n[key], rebuilds[key] / n[key], remote[key] / n[key]
+        }
+    }' $exp/summary.txt | tee table.txt
+
+echo "started: $started" | tee "time_started.txt"
+echo "finished:" `date` | tee "time_finished.txt"
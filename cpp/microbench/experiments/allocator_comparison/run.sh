@@ -0,0 +1,125 @@
+#!/bin/bash
+
+#########################################################################
+#### Allocators loaded with LD_PRELOAD (the libs in cpp/lib), with and
+#### without the per-thread NUMA-local pool (common/pool_numa.h), on an
+#### update-heavy workload that uses every thread.
+####
+#### build the binaries first with:
+####     cd ../.. ; make ds-reclaim ds-reclaim-pool POOLS=numa -j
+####
+#### the table at the end (also in table.txt) has, per (ds, allocator, pool):
+####   total_thr         operations per second
+####   maxres_mb         maximum resident set size
+#########################################################################
+
+t=10000
+num_trials=3
+k=2000000
+algorithms="brown_ext_abtree_lf brown_ext_ist_lf"
+allocators="glibc jemalloc tcmalloc hoard mimalloc supermalloc"
+pools="none numa"
+## the IST allocates its nodes itself (see ds/brown_ext_ist_lf/ist_node_placement.h),
+## so the pool would not recycle them: it only runs without the pool
+pool_algorithms="brown_ext_abtree_lf"
+
+## if user provides any argument, then we are running in TESTING mode, with 100ms runs
+if [ "$1" != "" ]; then
+    echo "*** WARNING *** running in TESTING mode (100ms runs; one trial)"
+    t=100
+    num_trials=1
+fi
+
+nthreads=`cd .. ; ./get_thread_count_max.sh`
+
+exp="`pwd | rev | cut -d'/' -f1 | rev`"
+mkdir $exp 2>/dev/null
+
+cat > $exp/test.json <<END
+{
+    "stopCondition": { "ClassName": "Timer", "workTime": $t },
+    "threadLoopBuilders": [
+        {
+            "quantity": $nthreads,
+            "pinPolicy": "NumaFill",
+            "threadLoopBuilder": {
+                "ClassName": "DefaultThreadLoopBuilder",
+                "argsGeneratorBuilder": {
+                    "ClassName": "DefaultArgsGeneratorBuilder",
+                    "dataMapBuilder": { "ClassName": "IdDataMapBuilder", "id": 0 },
+                    "distributionBuilder": { "ClassName": "UniformDistributionBuilder" }
+                },
+                "parameters": { "insertRatio": 0.5, "removeRatio": 0.5, "rqRatio": 0.0 }
+            }
+        }
+    ]
+}
+END
+
+## $1 = step file
+get() {
+    grep -m1 "^$2=" $1 | cut -d"=" -f2
+}
+
+started=`date`
+step=0
+rm -f $exp/summary.txt
+for ((trial=0;trial<num_trials;++trial)) ; do
+    for alg in $algorithms ; do
+        for pool in $pools ; do
+            binary=../../bin/$alg.debra
+            if [ "$pool" != "none" ]; then
+                if [[ " $pool_algorithms " != *" $alg "* ]]; then
+                    continue
+                fi
+                binary=$binary.p$pool
+            fi
+            if [ ! -x "$binary" ]; then
+                echo "skipping $alg with pool $pool: $binary not found"
+                continue
+            fi
+            for alloc in $allocators ; do
+                preload=""
+                if [ "$alloc" != "glibc" ]; then
+                    preload=../../../lib/lib$alloc.so
+                    if [ ! -e "$preload" ]; then
+                        echo "skipping $alloc: $preload not found"
+                        continue
+                    fi
+                fi
+                step=$((step+1))
+                f="$exp/step$step"
+                cmd="LD_PRELOAD=$preload /usr/bin/time $binary -range $k -create-default-prefill -test $exp/test.json -result-file $f.result.json"
+                echo "cmd=$cmd" > $f.txt
+                echo "allocator=$alloc" >> $f.txt
+                echo "pool=$pool" >> $f.txt
+                eval $cmd >> $f.txt 2>&1
+                if [ "$?" -ne "0" ]; then
+                    cat $f.txt
+                fi
+                maxres=`../grep_maxres.sh $f.txt 2> /dev/null`
+                echo "maxresident_mb=$maxres" >> $f.txt
+                echo "$trial $alg $alloc $pool `get $f.txt total_throughput` ${maxres:-0}" >> $exp/summary.txt
+                echo "step $step: alg=$alg allocator=$alloc pool=$pool `grep -m1 total_throughput= $f.txt`"
+            done
+        done
+    done
+done
+
+## one row per (ds, allocator, pool), averaged over the trials
+awk '
+    {
+        key = $2" "$3" "$4
+        if (!(key in n)) order[++rows] = key
+        thr[key] += $5; maxres[key] += $6; n[key]++
+    }
+    END {
+        printf "%-24s %-12s %-6s %14s %10s\n", "ds", "allocator", "pool", "total_thr", "maxres_mb"
+        for (i = 1; i <= rows; ++i) {
+            key = order[i]; split(key, f, " ")
+            printf "%-24s %-12s %-6s %14d %10d\n", f[1], f[2], f[3], thr[key] / n[key], maxres[key] / n[key]
+        }
+    }' $exp/summary.txt | tee table.txt
+
+echo "started: $started" | tee "time_started.txt"
+echo "finished:" `date` | tee "time_finished.txt"
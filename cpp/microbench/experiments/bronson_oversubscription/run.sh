@@ -0,0 +1,80 @@
+#!/bin/bash
+
+#########################################################################
+#### Bronson AVL with 1x and 2x as many threads as cores,
+#### comparing unbounded spinning on rotating nodes with
+#### bounded spin/yield plus the reader bypass
+#########################################################################
+
+t=10000
+num_trials=3
+key_range_sizes="2000000"
+oversubscription_factors="1 2"
+binary=../../bin/bronson_pext_bst_occ.debra
+
+modes="spin bypass"
+mode_args_spin=""
+mode_args_bypass="-ds-param bronson.readerBypass=true -ds-param bronson.spinCount=100 -ds-param bronson.yieldCount=10"
+
+cores=`cd .. ; expr $(./get_numsockets.sh) \* $(./get_cores_per_socket.sh)`
+
+## if user provides any argument, then we are running in TESTING mode, with 100ms runs
+if [ "$1" != "" ]; then
+    echo "*** WARNING *** running in TESTING mode (100ms runs; one trial)"
+    t=100
+    num_trials=1
+fi
+
+exp="`pwd | rev | cut -d'/' -f1 | rev`"
+mkdir $exp 2>/dev/null
+
+## test stage: zipfian keys, 50% updates, unpinned threads (the OS has to time-slice them)
+write_test_json() {
+    cat > $1 <<END
+{
+    "stopCondition": { "ClassName": "Timer", "workTime": $t },
+    "threadLoopBuilders": [
+        {
+            "quantity": $2,
+            "threadLoopBuilder": {
+                "ClassName": "DefaultThreadLoopBuilder",
+                "argsGeneratorBuilder": {
+                    "ClassName": "DefaultArgsGeneratorBuilder",
+                    "dataMapBuilder": { "ClassName": "ArrayDataMapBuilder", "id": 0 },
+                    "distributionBuilder": { "ClassName": "ZipfianDistributionBuilder", "alpha": 1.0 }
+                },
+                "parameters": { "insertRatio": 0.25, "removeRatio": 0.25, "rqRatio": 0.0 }
+            }
+        }
+    ]
+}
+END
+}
+
+started=`date`
+step=0
+for ((trial=0;trial<num_trials;++trial)) ; do
+    for k in $key_range_sizes ; do
+        for factor in $oversubscription_factors ; do
+            n=`expr $factor \* $cores`
+            for mode in $modes ; do
+                step=$((step+1))
+                f="$exp/step$step"
+                write_test_json $f.test.json $n
+                mode_args_var="mode_args_$mode"
+                cmd="$binary -range $k -create-default-prefill -test $f.test.json -result-file $f.result.json ${!mode_args_var}"
+                echo "cmd=$cmd" > $f.txt
+                echo "oversubscription_factor=$factor" >> $f.txt
+                echo "mode=$mode" >> $f.txt
+                eval $cmd >> $f.txt 2>&1
+                if [ "$?" -ne "0" ]; then
+                    cat $f.txt
+                fi
+                echo "step $step: n=$n factor=$factor mode=$mode `grep -m1 total_throughput= $f.txt`"
+            done
+        done
+    done
+done
+
+echo "started: $started" | tee "time_started.txt"
+echo "finished:" `date` | tee "time_finished.txt"
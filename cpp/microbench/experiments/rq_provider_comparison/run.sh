@@ -0,0 +1,146 @@
+#!/bin/bash
+
+#########################################################################
+#### Range query providers (common/rq/rq_provider.h) of the RQ trees,
+#### with range sizes from 1 to 10^6 keys.
+####
+#### build the binaries first with: cd ../.. ; make rq-providers -j
+####
+#### half of the cores run updates, the other half run only range queries.
+#### every (tree, provider) pair is also run without the range query
+#### threads, which is the baseline of its update slowdown.
+#### the table at the end (also in table.txt) has, per range size:
+####   rq_throughput     range queries per second
+####   rq_key_thr        keys returned by range queries per second
+####   ns_per_key        range query thread time per returned key
+####   update_thr        updates per second
+####   update_slowdown   baseline update_thr / update_thr
+#########################################################################
+
+t=10000
+num_trials=1
+k=2000000
+rq_sizes="1 10 100 1000 10000 100000 1000000"
+algorithms="brown_ext_abtree_rq_lf brown_ext_bslack_rq_lf brown_ext_bst_rq_lf"
+providers="LOCKFREE RWLOCK HTM_RWLOCK SNAPCOLLECTOR UNSAFE"
+
+## a size of "log" draws the size of every range query log-uniformly from [1, 10^6]
+rq_sizes="$rq_sizes log"
+
+cores=`cd .. ; expr $(./get_numsockets.sh) \* $(./get_cores_per_socket.sh)`
+nupdaters=`expr $cores / 2`
+if [ "$nupdaters" -lt "1" ]; then nupdaters=1; fi
+nrq=`expr $cores - $nupdaters`
+if [ "$nrq" -lt "1" ]; then nrq=1; fi
+
+## if user provides any argument, then we are running in TESTING mode, with 100ms runs
+if [ "$1" != "" ]; then
+    echo "*** WARNING *** running in TESTING mode (100ms runs; one trial)"
+    t=100
+    num_trials=1
+fi
+
+exp="`pwd | rev | cut -d'/' -f1 | rev`"
+mkdir $exp 2>/dev/null
+
+## $1 = file, $2 = number of range query threads, $3 = size distribution, $4 = min size, $5 = max size
+write_test_json() {
+    rq_builder=""
+    if [ "$2" -gt "0" ]; then
+        rq_builder=",
+        {
+            \"quantity\": $2,
+            \"threadLoopBuilder\": {
+                \"ClassName\": \"DefaultThreadLoopBuilder\",
+                \"argsGeneratorBuilder\": {
+                    \"ClassName\": \"RangeQueryArgsGeneratorBuilder\",
+                    \"dataMapBuilder\": { \"ClassName\": \"IdDataMapBuilder\", \"id\": 1 },
+                    \"distributionBuilder\": { \"ClassName\": \"UniformDistributionBuilder\" },
+                    \"sizeDistribution\": \"$3\", \"minSize\": $4, \"maxSize\": $5
+                },
+                \"parameters\": { \"insertRatio\": 0.0, \"removeRatio\": 0.0, \"rqRatio\": 1.0 }
+            }
+        }"
+    fi
+    cat > $1 <<END
+{
+    "stopCondition": { "ClassName": "Timer", "workTime": $t },
+    "threadLoopBuilders": [
+        {
+            "quantity": $nupdaters,
+            "threadLoopBuilder": {
+                "ClassName": "DefaultThreadLoopBuilder",
+                "argsGeneratorBuilder": {
+                    "ClassName": "DefaultArgsGeneratorBuilder",
+                    "dataMapBuilder": { "ClassName": "IdDataMapBuilder", "id": 0 },
+                    "distributionBuilder": { "ClassName": "UniformDistributionBuilder" }
+                },
+                "parameters": { "insertRatio": 0.5, "removeRatio": 0.5, "rqRatio": 0.0 }
+            }
+        }$rq_builder
+    ]
+}
+END
+}
+
+## $1 = step file
+get() {
+    grep -m1 "^$2=" $1 | cut -d"=" -f2
+}
+
+started=`date`
+step=0
+rm -f $exp/summary.txt
+for ((trial=0;trial<num_trials;++trial)) ; do
+    for alg in $algorithms ; do
+        for provider in $providers ; do
+            binary=../../bin/$alg.debra.rq_$provider
+            if [ ! -x "$binary" ]; then
+                echo "skipping $alg with $provider: $binary not found"
+                continue
+            fi
+            for size in baseline $rq_sizes ; do
+                step=$((step+1))
+                f="$exp/step$step"
+                if [ "$size" == "baseline" ]; then
+                    write_test_json $f.test.json 0
+                elif [ "$size" == "log" ]; then
+                    write_test_json $f.test.json $nrq LogUniform 1 1000000
+                else
+                    write_test_json $f.test.json $nrq Fixed $size $size
+                fi
+                cmd="$binary -range $k -create-default-prefill -test $f.test.json -result-file $f.result.json"
+                echo "cmd=$cmd" > $f.txt
+                echo "provider=$provider" >> $f.txt
+                echo "rq_size=$size" >> $f.txt
+                eval $cmd >> $f.txt 2>&1
+                if [ "$?" -ne "0" ]; then
+                    cat $f.txt
+                fi
+                echo "$trial $alg $provider $size `get $f.txt rq_throughput` `get $f.txt rq_key_throughput` `get $f.txt update_throughput`" >> $exp/summary.txt
+                echo "step $step: alg=$alg provider=$provider rq_size=$size `grep -m1 total_throughput= $f.txt`"
+            done
+        done
+    done
+done
+
+## one row per (tree, provider, size), averaged over the trials
+awk -v nrq=$nrq '
+    $4 == "baseline" { base[$2" "$3] += $7; nbase[$2" "$3]++; next }
+    {
+        key = $2" "$3" "$4
+        if (!(key in n)) order[++rows] = key
+        rq[key] += $5; rqk[key] += $6; upd[key] += $7; n[key]++
+    }
+    END {
+        printf "%-24s %-14s %8s %14s %14s %12s %14s %16s\n", "ds", "provider", "rq_size", "rq_throughput", "rq_key_thr", "ns_per_key", "update_thr", "update_slowdown"
+        for (i = 1; i <= rows; ++i) {
+            key = order[i]; split(key, f, " ")
+            r = rq[key] / n[key]; rk = rqk[key] / n[key]; u = upd[key] / n[key]
+            b = (nbase[f[1]" "f[2]] ? base[f[1]" "f[2]] / nbase[f[1]" "f[2]] : 0)
+            printf "%-24s %-14s %8s %14d %14d %12.2f %14d %16.2f\n", f[1], f[2], f[3], r, rk, (rk > 0 ? nrq * 1e9 / rk : 0), u, (u > 0 ? b / u : 0)
+        }
+    }' $exp/summary.txt | tee table.txt
+
+echo "started: $started" | tee "time_started.txt"
+echo "finished:" `date` | tee "time_finished.txt"
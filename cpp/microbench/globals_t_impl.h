@@ -26,6 +26,8 @@ typedef long long test_type;
 #include "workloads/bench_parameters.h"
 #include "adapter.h"
 #include "globals_t.h"
+#include "run_sampler.h"
+#include "cache_mode.h"
 
 struct globals_t {
     PAD;
@@ -64,15 +66,32 @@ struct globals_t {
     PAD;
     volatile bool debug_print;
     PAD;
+    long long sampleIntervalMillis; // 0 = no sampling
+    std::vector<RunSample> samples; // of the test stage
+    PAD;
+    CacheMode cacheMode; // of the caches at the start of the test stage
+    size_t cacheFlushBytes; // of the sweep of the cold cache mode
+    PAD;
 
     globals_t(BenchParameters * _benchParameters)
             : NO_VALUE(NULL), KEY_MIN(0) /*std::numeric_limits<test_type>::min()+1)*/
             , KEY_MAX(_benchParameters->range + 1), PREFILL_INTERVAL_MILLIS(200),
               benchParameters(_benchParameters) {
         debug_print = 0;
-        srand(time(0));
+        sampleIntervalMillis = 0;
+        cacheMode = CacheMode::DEFAULT;
+        cacheFlushBytes = CACHE_FLUSH_LLC_MULTIPLE * lastLevelCacheBytes();
+        reset();
+    }
+
+    // prepares another run with the same parameters (and so with the same operations per thread)
+    void reset() {
+        // everything random in a run is derived from the seed of the bench parameters
+        // (rand() is seeded as well, for the data structures that use it)
+        Random64 seeds(benchParameters->seed);
+        srand(seeds.next());
         for (int i = 0; i < MAX_THREADS_POW2; ++i) {
-            rngs[i].setSeed(rand());
+            rngs[i].setSeed(seeds.next());
         }
 
         start = false;
@@ -82,6 +101,7 @@ struct globals_t {
         garbage = 0;
         curKeySum = 0;
         curSize = 0;
+        samples.clear();
     }
 
     void enable_debug_print() {
@@ -54,9 +54,15 @@ int64_t* key_depth_sum__ = nullptr;
 int64_t* key_depth_cnt__ = nullptr;
 #endif
 
+#ifdef KEY_DEPTH_LATENCY_STAT
+#include "key_depth_latency.h"
+#endif
+
 #ifdef KEY_SEARCH_TOTAL_STAT
 int64_t key_search_total_iters_cnt__;
 int64_t key_search_total_cnt__;
+int64_t key_search_total_probe_distance__;
+int64_t key_search_total_probe_cnt__;
 #endif
 
 
@@ -139,6 +145,12 @@ GSTATS_DECLARE_ALL_STAT_IDS;
 #ifdef GSTATS_HANDLE_STATS_BROWN_EXT_IST_LF
 GSTATS_HANDLE_STATS_BROWN_EXT_IST_LF(__DECLARE_STAT_ID);
 #endif
+#ifdef GSTATS_HANDLE_STATS_BRONSON_COMBINING
+GSTATS_HANDLE_STATS_BRONSON_COMBINING(__DECLARE_STAT_ID);
+#endif
+#ifdef GSTATS_HANDLE_STATS_SIGOUIN_INT_BST_KCAS
+GSTATS_HANDLE_STATS_SIGOUIN_INT_BST_KCAS(__DECLARE_STAT_ID);
+#endif
 #ifdef GSTATS_HANDLE_STATS_POOL_NUMA
 GSTATS_HANDLE_STATS_POOL_NUMA(__DECLARE_STAT_ID);
 #endif
@@ -199,7 +211,7 @@ Statistic getStatistic(long long elapsedMillis) {
     return Statistic(elapsedMillis / 1000.);
 }
 
-void execute(globals_t *g, Parameters *parameters) {
+void execute(globals_t *g, Parameters *parameters, bool sample = false) {
 
     std::thread **threads = new std::thread *[MAX_THREADS_POW2];
     ThreadLoop **threadLoops = parameters->getWorkload(g, g->rngs);
@@ -233,6 +245,10 @@ void execute(globals_t *g, Parameters *parameters) {
     g->start = true;
     SOFTWARE_BARRIER;
 
+    if (sample && g->sampleIntervalMillis > 0) {
+        sampleRun(g->samples, g->running, g->startTime, g->sampleIntervalMillis);
+    }
+
     for (size_t i = 0; i < parameters->getNumThreads(); ++i) {
         threads[i]->join();
     }
@@ -301,6 +317,105 @@ void execute(globals_t *g, Parameters *parameters) {
     g->done = false;
 }
 
+// runs f(tid) on each thread of the test stage, bound as in the test stage
+template<typename F>
+void runOnTestThreads(globals_t *g, F f) {
+    Parameters *test = g->benchParameters->test;
+    const int numThreads = test->getNumThreads();
+
+    binding_setCustom(test->getPin());
+    bindThreads(numThreads);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < numThreads; ++i) {
+        threads.emplace_back([i, &f]() {
+            tid = i;
+            binding_bindThread(tid);
+            f(tid);
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    binding_deinit();
+}
+
+// searches every key of the range once, with the threads of the test stage
+void warmCaches(globals_t *g) {
+    const int numThreads = g->benchParameters->test->getNumThreads();
+    const long long range = g->benchParameters->range;
+    std::atomic<long long> found(0);
+
+    runOnTestThreads(g, [g, numThreads, range, &found](const int tid) {
+        __RLU_INIT_THREAD;
+        __RCU_INIT_THREAD;
+        g->dsAdapter->initThread(tid);
+        long long myFound = 0;
+        const test_type lo = 1 + range * tid / numThreads;
+        const test_type hi = 1 + range * (tid + 1) / numThreads;
+        for (test_type key = lo; key < hi; ++key) {
+            myFound += g->dsAdapter->contains(tid, key);
+        }
+        found += myFound;
+        g->dsAdapter->deinitThread(tid);
+        __RCU_DEINIT_THREAD;
+        __RLU_DEINIT_THREAD;
+    });
+
+    std::cout << "warm read pass found " << found << " keys" << std::endl;
+}
+
+// evicts the data structure from the caches and the TLBs, and drops the page cache
+void coolCaches(globals_t *g) {
+#ifdef USE_TREE_STATS
+    // (the nodes are flushed by a traversal of all of them, even if the tree statistics are sampled)
+    const size_t sampleWalks = tree_stats_opts.sampleWalks;
+    tree_stats_opts.sampleWalks = 0;
+    tree_stats_opts.flushNodes = true;
+    auto treeStats = g->dsAdapter->createTreeStats(g->KEY_MIN, g->KEY_MAX);
+    tree_stats_opts.flushNodes = false;
+    tree_stats_opts.sampleWalks = sampleWalks;
+    if (treeStats == NULL) {
+        setbench_error("-cache-mode cold: the data structure has no node handler (createTreeStats), so its nodes cannot be flushed");
+    }
+    delete treeStats;
+    std::cout << "flushed the nodes of the data structure" << std::endl;
+#endif // (main refuses the cold mode without USE_TREE_STATS)
+
+    // every core of the test stage sweeps its own caches and TLBs (and, together, their last level caches)
+    const int numThreads = g->benchParameters->test->getNumThreads();
+    const size_t threadBytes = std::max(g->cacheFlushBytes / numThreads, minThreadSweepBytes());
+    std::cout << "sweeping " << threadBytes << " bytes through the caches of each of the "
+              << numThreads << " threads of the test stage" << std::endl;
+    runOnTestThreads(g, [threadBytes](const int tid) {
+        sweepCaches(threadBytes);
+    });
+
+    if (!dropPageCache()) {
+        std::cerr << "WARNING: could not drop the page cache (writing /proc/sys/vm/drop_caches needs root)" << std::endl;
+    }
+}
+
+void prepareCaches(globals_t *g) {
+    if (g->cacheMode == CacheMode::DEFAULT) {
+        return;
+    }
+    COUTATOMIC(toStringStage("Cache mode: " + cacheModeToString(g->cacheMode)))
+
+    auto start = std::chrono::high_resolution_clock::now();
+    if (g->cacheMode == CacheMode::WARM) {
+        warmCaches(g);
+    } else {
+        coolCaches(g);
+    }
+    GSTATS_CLEAR_ALL;
+#ifdef KEY_DEPTH_LATENCY_STAT
+    key_depth_latency::reset();
+#endif
+    std::cout << "cache_prepare_millis=" << std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::high_resolution_clock::now() - start).count() << std::endl;
+}
+
 void run(globals_t *g) {
     int TOTAL_THREADS = g->benchParameters->getTotalThreads();
 
@@ -320,11 +435,16 @@ void run(globals_t *g) {
 #ifdef KEY_SEARCH_TOTAL_STAT
     key_search_total_iters_cnt__ = 0;
     key_search_total_cnt__ = 0;
+    key_search_total_probe_distance__ = 0;
+    key_search_total_probe_cnt__ = 0;
 #endif
 
     // create the actual data structure
     createDataStructure(g);
 
+    // print object sizes, to help debugging/sanity checking memory layouts
+    g->dsAdapter->printObjectSizes();
+
     INIT_ALL;
 
 #ifdef CALL_DEBUG_GC
@@ -363,6 +483,9 @@ void run(globals_t *g) {
                                                    << std::endl)
             std::cout << "prefill_millis=" << elapsedMillis << std::endl;
             GSTATS_CLEAR_ALL;
+#ifdef KEY_DEPTH_LATENCY_STAT
+            key_depth_latency::reset();
+#endif
 
             // print total prefilling time
             g->dsAdapter->printSummary(); ///////// debug
@@ -398,17 +521,22 @@ void run(globals_t *g) {
                                             << std::endl)
         std::cout << "warm up millis=" << elapsedMillis << std::endl;
         GSTATS_CLEAR_ALL;
+#ifdef KEY_DEPTH_LATENCY_STAT
+        key_depth_latency::reset();
+#endif
     } else {
         COUTATOMIC(toStringStage("Without WarmUp stage"))
     }
 
+    prepareCaches(g);
+
     /**
      * TEST STAGE
      */
 
     std::cout << toStringStage("Test stage");
 
-    execute(g, g->benchParameters->test);
+    execute(g, g->benchParameters->test, true);
 
     COUTATOMIC(std::endl);
     COUTATOMIC(toStringBigStage("END RUNNING"))
@@ -426,7 +554,8 @@ void printExecutionTime(globals_t *g) {
     std::cout << "total_execution_walltime=" << (programExecutionElapsed / 1000.) << "s" << std::endl;
 }
 
-void printOutput(globals_t *g, bool detailStats = true) {
+// (freeDs: delete the data structure even if the key range is large, e.g., because another run follows)
+void printOutput(globals_t *g, bool detailStats = true, bool freeDs = false) {
     std::cout << "PRODUCING OUTPUT" << std::endl;
 
 #ifdef KEY_DEPTH_TOTAL_STAT
@@ -438,6 +567,12 @@ void printOutput(globals_t *g, bool detailStats = true) {
     std::cout << "KEY_DEPTH_TOTAL_STAT END" << std::endl;
 #endif
 
+#ifdef KEY_DEPTH_LATENCY_STAT
+    std::cout << "\nKEY_DEPTH_LATENCY_STAT START" << std::endl;
+    key_depth_latency::print();
+    std::cout << "KEY_DEPTH_LATENCY_STAT END" << std::endl;
+#endif
+
 #ifdef KEY_DEPTH_STAT
     std::cout << "\nKEY_DEPTH_STAT START" << std::endl;
     for (int key = g->KEY_MIN; key <= g->KEY_MAX; ++key) {
@@ -458,6 +593,10 @@ void printOutput(globals_t *g, bool detailStats = true) {
         std::cout << "TOTAL_SEARCH_CNT=" << key_search_total_cnt__ << '\n';
         std::cout << "AVG_SEARCH_ITERS=" << (key_search_total_iters_cnt__ / static_cast<double>(key_search_total_cnt__)) << '\n';
     }
+    if (key_search_total_probe_cnt__ > 0) {
+        // reported by interpolating searches: distance between the interpolated and the final position
+        std::cout << "AVG_PROBE_DISTANCE=" << (key_search_total_probe_distance__ / static_cast<double>(key_search_total_probe_cnt__)) << '\n';
+    }
     std::cout << "KEY_SEARCH_TOTAL_STAT END" << std::endl;
 #endif
 
@@ -498,7 +637,10 @@ void printOutput(globals_t *g, bool detailStats = true) {
 #ifdef USE_TREE_STATS
         std::cout<<"final_keysum="<<dsKeySum<<std::endl;
         std::cout<<"final_size="<<dsSize<<std::endl;
-        if (threadsKeySum == dsKeySum) { // && threadsSize == dsSize) {
+        if (treeStats && treeStats->getSampleWalks() > 0) {
+            std::cout<<"validate_result=skipped"<<std::endl;
+            std::cout<<"**** WARNING: VALIDATION WAS SKIPPED AS THE TREE STATS ARE ESTIMATES (-tree-stats-samples)!"<<std::endl;
+        } else if (threadsKeySum == dsKeySum) { // && threadsSize == dsSize) {
             std::cout<<"validate_result=success"<<std::endl;
             std::cout<<"Validation OK."<<std::endl;
             if (treeStats == NULL) std::cout<<"**** WARNING: VALIDATION WAS ACTUALLY _SKIPPED_ AS THIS DS DOES NOT SUPPORT IT!"<<std::endl;
@@ -543,7 +685,7 @@ void printOutput(globals_t *g, bool detailStats = true) {
     // free ds
 #if !defined NO_CLEANUP_AFTER_WORKLOAD
     std::cout << "begin delete ds..." << std::endl;
-    if (g->benchParameters->range > 10000000) {
+    if (!freeDs && g->benchParameters->range > 10000000) {
         std::cout << "    SKIPPING deletion of data structure to save time! (because key range is so large)"
                   << std::endl;
     } else {
@@ -570,6 +712,25 @@ void printOutput(globals_t *g, bool detailStats = true) {
 }
 
 
+void printComparison(const std::string &title, const std::vector<std::string> &runNames,
+                     const std::vector<Statistic> &statistics) {
+    std::cout << "\n" << title << " START" << std::endl;
+    std::cout << std::left << std::setw(32) << "run" << std::right
+              << std::setw(18) << "total_throughput" << std::setw(18) << "find_throughput"
+              << std::setw(18) << "update_throughput" << std::setw(18) << "rq_throughput"
+              << std::setw(10) << "relative" << std::endl;
+    for (size_t i = 0; i < runNames.size(); ++i) {
+        const Statistic &s = statistics[i];
+        std::cout << std::left << std::setw(32) << runNames[i] << std::right
+                  << std::setw(18) << s.throughputAll << std::setw(18) << s.throughputSearches
+                  << std::setw(18) << s.throughputUpdates << std::setw(18) << s.throughputRQs
+                  << std::setw(10) << std::fixed << std::setprecision(3)
+                  << (s.throughputAll / (double) std::max(1LL, statistics[0].throughputAll))
+                  << std::defaultfloat << std::endl;
+    }
+    std::cout << title << " END" << std::endl;
+}
+
 template<typename T>
 T *parseJsonFile(const std::string &fileName) {
     std::ifstream fin;
@@ -604,12 +765,19 @@ int main(int argc, char **argv) {
     Parameters *warmUp = nullptr;
     Parameters *prefill = nullptr;
     long long range = -1;
+    long long seed = -1;
 
     ParseArgument args = ParseArgument(argc, argv).next();
     bool detailStats = false;
     bool createDefaultPrefill = false;
     bool resultStatisticToFile = false;
     std::string resultStatisticFileName;
+    long long sampleIntervalMillis = 0;
+    long long treeStatsSampleWalks = 0;
+    long long treeStatsCacheLevels = -1;
+    std::vector<std::string> dsNames;
+    std::vector<CacheMode> cacheModes = {CacheMode::DEFAULT};
+    long long cacheFlushBytes = -1;
 
     while (args.hasNext()) {
         if (strcmp(args.getCurrent(), "-json-file") == 0) {
@@ -618,6 +786,18 @@ int main(int argc, char **argv) {
         } else if (strcmp(args.getCurrent(), "-result-file") == 0) {
             resultStatisticToFile = true;
             resultStatisticFileName = args.getNext();
+        } else if (strcmp(args.getCurrent(), "-sample-interval") == 0) {
+            sampleIntervalMillis = atoll(args.getNext());
+        } else if (strcmp(args.getCurrent(), "-tree-stats-samples") == 0) {
+            treeStatsSampleWalks = atoll(args.getNext());
+            if (treeStatsSampleWalks < 0) {
+                setbench_error("-tree-stats-samples must be non-negative");
+            }
+        } else if (strcmp(args.getCurrent(), "-tree-stats-cache-levels") == 0) {
+            treeStatsCacheLevels = atoll(args.getNext());
+            if (treeStatsCacheLevels < 0) {
+                setbench_error("-tree-stats-cache-levels must be non-negative");
+            }
         } else if (strcmp(args.getCurrent(), "-detail-stats") == 0) {
             detailStats = true;
         } else if (strcmp(args.getCurrent(), "-prefill") == 0) {
@@ -628,8 +808,21 @@ int main(int argc, char **argv) {
             test = parseJsonFile<Parameters>(args.getNext());
         } else if (strcmp(args.getCurrent(), "-range") == 0) {
             range = atoll(args.getNext());
+        } else if (strcmp(args.getCurrent(), "-seed") == 0) {
+            seed = atoll(args.getNext());
         } else if (strcmp(args.getCurrent(), "-create-default-prefill") == 0) {
             createDefaultPrefill = true;
+        } else if (strcmp(args.getCurrent(), "-ds-param") == 0) {
+            ds_parameters::setFromString(args.getNext());
+        } else if (strcmp(args.getCurrent(), "-cache-mode") == 0) {
+            cacheModes = parseCacheModes(args.getNext());
+        } else if (strcmp(args.getCurrent(), "-cache-flush-bytes") == 0) {
+            cacheFlushBytes = atoll(args.getNext());
+        } else if (strcmp(args.getCurrent(), "-ds") == 0) {
+            std::stringstream names(args.getNext());
+            for (std::string name; std::getline(names, name, ',');) {
+                dsNames.push_back(name);
+            }
         } else {
             std::cerr << "Unexpected option: " << args.getCurrent() << "\nindex: " << args.pointer <<". Ignoring..."<< std::endl;
         }
@@ -648,6 +841,9 @@ int main(int argc, char **argv) {
     if (range != -1) {
         benchParameters->setRange(range);
     }
+    if (seed != -1) {
+        benchParameters->setSeed(seed);
+    }
     if (createDefaultPrefill) {
         if (prefill == nullptr) {
             benchParameters->createDefaultPrefill();
@@ -656,6 +852,28 @@ int main(int argc, char **argv) {
         }
     }
 
+#ifndef USE_TREE_STATS
+    if (std::find(cacheModes.begin(), cacheModes.end(), CacheMode::COLD) != cacheModes.end()) {
+        setbench_error("-cache-mode cold flushes the nodes through the node handlers of USE_TREE_STATS (make use_tree_stats=1)");
+    }
+#endif
+
+#ifdef DS_REGISTRY
+    if (dsNames.empty()) {
+        if (ds_registry::names.size() > 1) {
+            setbench_error("-ds <name>[,<name>...] is required: this registry build has several data structures");
+        }
+        dsNames = ds_registry::names;
+    }
+    for (auto & name : dsNames) {
+        ds_registry::indexOf(name); // (fails on unknown names before anything runs)
+    }
+#else
+    if (!dsNames.empty()) {
+        setbench_error("-ds is only supported by the registry build (make registry)");
+    }
+#endif
+
     // print used args
     PRINTS(DS_TYPENAME)
     PRINTS(FIND_FUNC)
@@ -668,11 +886,13 @@ int main(int argc, char **argv) {
     PRINTS(POOL)
     PRINTS(MAX_THREADS_POW2)
     PRINTS(CPU_FREQ_GHZ)
+    ds_parameters::print();
 
     std::cout<<"\ninitialization of parameters...\n";
 
     benchParameters->init();
 
+    std::cout << "seed=" << benchParameters->seed << std::endl;
     std::cout << std::endl;
 
     COUTATOMIC(toStringBigStage("BENCH PARAMETERS"))
@@ -686,9 +906,12 @@ int main(int argc, char **argv) {
     globals_t *g = new globals_t(benchParameters);
 
     g->programExecutionStartTime = std::chrono::high_resolution_clock::now();
-
-    // print object sizes, to help debugging/sanity checking memory layouts
-    g->dsAdapter->printObjectSizes();
+    g->sampleIntervalMillis = sampleIntervalMillis;
+    if (cacheFlushBytes > 0) g->cacheFlushBytes = cacheFlushBytes;
+#ifdef USE_TREE_STATS
+    tree_stats_opts.sampleWalks = treeStatsSampleWalks;
+    if (treeStatsCacheLevels >= 0) tree_stats_opts.cacheLevels = treeStatsCacheLevels;
+#endif
 
     /******************************************************************************
         * Perform the actual creation of all GSTATS global statistics trackers that
@@ -707,6 +930,12 @@ int main(int argc, char **argv) {
 #ifdef GSTATS_HANDLE_STATS_BROWN_EXT_IST_LF
     GSTATS_HANDLE_STATS_BROWN_EXT_IST_LF(__CREATE_STAT);
 #endif
+#ifdef GSTATS_HANDLE_STATS_BRONSON_COMBINING
+    GSTATS_HANDLE_STATS_BRONSON_COMBINING(__CREATE_STAT);
+#endif
+#ifdef GSTATS_HANDLE_STATS_SIGOUIN_INT_BST_KCAS
+    GSTATS_HANDLE_STATS_SIGOUIN_INT_BST_KCAS(__CREATE_STAT);
+#endif
 #ifdef GSTATS_HANDLE_STATS_POOL_NUMA
     GSTATS_HANDLE_STATS_POOL_NUMA(__CREATE_STAT);
 #endif
@@ -719,12 +948,78 @@ int main(int argc, char **argv) {
     GSTATS_CREATE_ALL;
     std::cout << std::endl;
 
-    run(g);
-    printOutput(g, detailStats);
+    // every run (each data structure of a registry build, in each cache mode) has the same seed,
+    // so the same keys and operations per thread
+    std::vector<std::string> runNames;
+    std::vector<Statistic> runStatistics;
+#ifdef DS_REGISTRY
+    const size_t numRuns = dsNames.size() * cacheModes.size();
+#else
+    const size_t numRuns = cacheModes.size();
+#endif
+#if defined NO_CLEANUP_AFTER_WORKLOAD
+    if (numRuns > 1) {
+        setbench_error("several runs (of -ds or -cache-mode both) need the data structure of each run to be deleted before the next one, but NO_CLEANUP_AFTER_WORKLOAD is defined");
+    }
+#endif
+    auto runOnce = [&](const std::string &runName) {
+        if (!runStatistics.empty()) {
+            g->reset();
+            GSTATS_CLEAR_ALL;
+#ifdef KEY_DEPTH_LATENCY_STAT
+            key_depth_latency::reset();
+#endif
+        }
+        run(g);
+        // (so that the next run does not share the memory with the data structure of this one)
+        printOutput(g, detailStats, runNames.size() + 1 < numRuns);
+        runNames.push_back(runName);
+        runStatistics.push_back(getStatistic(g->elapsedMillis));
+    };
+    auto runCacheModes = [&](const std::string &dsName) {
+        for (CacheMode cacheMode : cacheModes) {
+            g->cacheMode = cacheMode;
+            std::string modeName = cacheModeToString(cacheMode);
+            if (cacheModes.size() > 1) std::cout << "cache_mode=" << modeName << std::endl;
+            runOnce(dsName.empty() ? modeName : (cacheModes.size() > 1) ? dsName + "/" + modeName : dsName);
+        }
+    };
+#ifdef DS_REGISTRY
+    for (auto & dsName : dsNames) {
+        ds_registry::select(dsName);
+        std::cout << "ds=" << dsName << std::endl;
+        runCacheModes(dsName);
+    }
+    if (runNames.size() > 1) {
+        printComparison("DS COMPARISON", runNames, runStatistics);
+    }
+#else
+    runCacheModes("");
+    if (runNames.size() > 1) {
+        printComparison("CACHE MODE COMPARISON", runNames, runStatistics);
+    }
+#endif
 
     if (resultStatisticToFile) {
         nlohmann::json json;
         GSTATS_JSON(json);
+        json["seed"] = g->benchParameters->seed;
+        // (the GSTATS are those of the last run)
+#ifdef DS_REGISTRY
+        json["ds"] = dsNames.back();
+#endif
+        json["cacheMode"] = cacheModeToString(cacheModes.back());
+        if (runNames.size() > 1) {
+            for (size_t i = 0; i < runNames.size(); ++i) {
+                json["comparison"][runNames[i]] = runStatistics[i];
+            }
+        }
+        if (!g->samples.empty()) {
+            json["samples"] = g->samples;
+        }
+#ifdef KEY_DEPTH_LATENCY_STAT
+        json["keyDepthLatency"] = key_depth_latency::toJson();
+#endif
         writeJsonFile(resultStatisticFileName, json);
     }
 
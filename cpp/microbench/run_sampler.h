@@ -0,0 +1,154 @@
+/**
+ * Periodic samples of throughput, memory footprint and reclamation progress
+ * during the test stage (enabled with -sample-interval <ms>).
+ *
+ * Every sample records
+ *   - the operations completed so far and the throughput since the last sample,
+ *   - the resident set size of the process,
+ *   - the bytes allocated and not yet freed, as reported by the allocator
+ *     (jemalloc's stats.allocated when jemalloc is loaded, e.g. with LD_PRELOAD,
+ *      and glibc's mallinfo2 otherwise; -1 if neither is available),
+ *   - the sums of the GSTATS counters the reclaimer defines in
+ *     GSTATS_HANDLE_STATS_RECLAIMERS_WITH_EPOCHS (if it defines any), and
+ *   - the largest announced epoch and the epoch advance rate since the last
+ *     sample (if the reclaimer has a thread_announced_epoch stat).
+ *
+ * Allocated bytes that keep growing while the size of the data structure is
+ * stable are records that were retired but not yet freed, so comparing the
+ * allocated bytes with the reclaimer counters and the epoch rate over time
+ * shows whether (and when) reclamation falls behind.
+ *
+ * The samples are written to the result file (-result-file) as "samples".
+ */
+
+#ifndef SETBENCH_RUN_SAMPLER_H
+#define SETBENCH_RUN_SAMPLER_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <unistd.h>
+#include "json/single_include/nlohmann/json.hpp"
+
+struct RunSample {
+    long long timeMillis;           // since the start of the stage
+    long long operations;
+    double throughput;              // operations per second since the previous sample
+    long long rssBytes;
+    long long allocatedBytes;       // -1 if the allocator does not report it
+    long long epoch;                // -1 if the reclaimer does not report it
+    double epochsPerSecond;
+    std::vector<std::pair<std::string, long long>> reclaimerStats;
+};
+
+void to_json(nlohmann::json &json, const RunSample &s) {
+    json["time_ms"] = s.timeMillis;
+    json["operations"] = s.operations;
+    json["throughput"] = s.throughput;
+    json["rss_bytes"] = s.rssBytes;
+    json["allocated_bytes"] = s.allocatedBytes;
+    if (s.epoch >= 0) {
+        json["epoch"] = s.epoch;
+        json["epochs_per_second"] = s.epochsPerSecond;
+    }
+    for (auto &stat : s.reclaimerStats) {
+        json["reclaimer"][stat.first] = stat.second;
+    }
+}
+
+long long sampleRssBytes() {
+    long long pages = -1, residentPages = -1;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f == NULL) return -1;
+    if (fscanf(f, "%lld %lld", &pages, &residentPages) != 2) residentPages = -1;
+    fclose(f);
+    return (residentPages < 0) ? -1 : residentPages * sysconf(_SC_PAGESIZE);
+}
+
+long long sampleAllocatedBytes() {
+    // jemalloc is usually loaded with LD_PRELOAD, so look it up at run time
+    typedef int (*mallctl_t)(const char *, void *, size_t *, void *, size_t);
+    static mallctl_t mallctl_ptr = (mallctl_t) dlsym(RTLD_DEFAULT, "mallctl");
+    if (mallctl_ptr) {
+        uint64_t epoch = 1;
+        size_t epochSize = sizeof(epoch);
+        mallctl_ptr("epoch", &epoch, &epochSize, &epoch, epochSize); // refresh the cached stats
+        size_t allocated = 0;
+        size_t allocatedSize = sizeof(allocated);
+        if (mallctl_ptr("stats.allocated", &allocated, &allocatedSize, NULL, 0) == 0) {
+            return (long long) allocated;
+        }
+    }
+#if defined __GLIBC__ && __GLIBC_PREREQ(2, 33)
+    struct mallinfo2 mi = mallinfo2();
+    return (long long) (mi.uordblks + mi.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+#if defined USE_GSTATS && defined GSTATS_HANDLE_STATS_RECLAIMERS_WITH_EPOCHS
+#define __SAMPLE_RECLAIMER_STAT(data_type, stat_name_token, stat_capacity, stats_output_items) \
+    if (data_type == LONG_LONG) { \
+        s.reclaimerStats.push_back({#stat_name_token, GSTATS_OBJECT_NAME.get_sum<long long>(stat_name_token)}); \
+        if (strcmp(#stat_name_token, "thread_announced_epoch") == 0) { \
+            s.epoch = GSTATS_OBJECT_NAME.get_max<long long>(stat_name_token); \
+        } \
+    }
+#endif
+
+RunSample takeRunSample(long long timeMillis) {
+    RunSample s;
+    s.timeMillis = timeMillis;
+    s.operations = 0;
+    s.throughput = 0;
+    s.rssBytes = sampleRssBytes();
+    s.allocatedBytes = sampleAllocatedBytes();
+    s.epoch = -1;
+    s.epochsPerSecond = 0;
+#ifdef USE_GSTATS
+    s.operations = GSTATS_OBJECT_NAME.get_sum<long long>(num_operations);
+#ifdef GSTATS_HANDLE_STATS_RECLAIMERS_WITH_EPOCHS
+    GSTATS_HANDLE_STATS_RECLAIMERS_WITH_EPOCHS(__SAMPLE_RECLAIMER_STAT);
+#endif
+#endif
+    return s;
+}
+
+/**
+ * Samples every intervalMillis (measured from startTime) until running drops
+ * to 0. Called by the main thread between starting and joining the threads.
+ */
+void sampleRun(std::vector<RunSample> &samples, volatile int &running,
+               std::chrono::time_point<std::chrono::high_resolution_clock> startTime, long long intervalMillis) {
+    using namespace std::chrono;
+    const long long stepMillis = (intervalMillis < 10) ? intervalMillis : 10;
+    long long nextMillis = intervalMillis;
+    while (running > 0) {
+        std::this_thread::sleep_for(milliseconds(stepMillis));
+        long long nowMillis = duration_cast<milliseconds>(high_resolution_clock::now() - startTime).count();
+        if (nowMillis < nextMillis) continue;
+        nextMillis = nowMillis + intervalMillis;
+
+        RunSample s = takeRunSample(nowMillis);
+        const long long prevMillis = samples.empty() ? 0 : samples.back().timeMillis;
+        const long long prevOperations = samples.empty() ? 0 : samples.back().operations;
+        const double seconds = (nowMillis - prevMillis) / 1000.;
+        if (seconds > 0) {
+            s.throughput = (s.operations - prevOperations) / seconds;
+            if (s.epoch >= 0 && !samples.empty() && samples.back().epoch >= 0) {
+                s.epochsPerSecond = (s.epoch - samples.back().epoch) / seconds;
+            }
+        }
+        samples.push_back(s);
+    }
+}
+
+#endif //SETBENCH_RUN_SAMPLER_H
@@ -16,6 +16,7 @@ struct Statistic {
 
     long long totalGets;
     long long totalRQs;
+    long long totalRQKeys;
     long long totalQueries;
     long long totalInserts;
     long long totalRemoves;
@@ -34,6 +35,7 @@ struct Statistic {
     double SECONDS_TO_RUN;
     long long throughputSearches;
     long long throughputRQs;
+    long long throughputRQKeys;
     long long throughputQueries;
     long long throughputUpdates;
     long long throughputAll;
@@ -41,6 +43,7 @@ struct Statistic {
     Statistic(double _SECONDS_TO_RUN) {
         totalGets = GSTATS_GET_STAT_METRICS(num_searches, TOTAL)[0].sum;
         totalRQs = GSTATS_GET_STAT_METRICS(num_rq, TOTAL)[0].sum;
+        totalRQKeys = GSTATS_GET_STAT_METRICS(num_rq_keys, TOTAL)[0].sum;
         totalQueries = totalGets + totalRQs;
         totalInserts = GSTATS_GET_STAT_METRICS(num_inserts, TOTAL)[0].sum;
         totalRemoves = GSTATS_GET_STAT_METRICS(num_removes, TOTAL)[0].sum;
@@ -60,6 +63,7 @@ struct Statistic {
         totalAll = totalUpdates + totalQueries;
         throughputSearches = (long long) (totalGets / SECONDS_TO_RUN);
         throughputRQs = (long long) (totalRQs / SECONDS_TO_RUN);
+        throughputRQKeys = (long long) (totalRQKeys / SECONDS_TO_RUN);
         throughputQueries = (long long) (totalQueries / SECONDS_TO_RUN);
         throughputUpdates = (long long) (totalUpdates / SECONDS_TO_RUN);
         throughputAll = (long long) (totalAll / SECONDS_TO_RUN);
@@ -73,6 +77,7 @@ struct Statistic {
             COUTATOMIC("total_fail_gets=" << totalFailGets << std::endl)
         }
         COUTATOMIC("total_rq=" << totalRQs << std::endl)
+        COUTATOMIC("total_rq_keys=" << totalRQKeys << std::endl)
         COUTATOMIC("total_inserts=" << totalInserts << std::endl)
         if (detail) {
             COUTATOMIC("total_successful_inserts=" << totalSuccessfulInserts << std::endl)
@@ -92,6 +97,7 @@ struct Statistic {
         COUTATOMIC("total_ops=" << totalAll << std::endl)
         COUTATOMIC("find_throughput=" << throughputSearches << std::endl)
         COUTATOMIC("rq_throughput=" << throughputRQs << std::endl)
+        COUTATOMIC("rq_key_throughput=" << throughputRQKeys << std::endl)
         COUTATOMIC("update_throughput=" << throughputUpdates << std::endl)
         COUTATOMIC("query_throughput=" << throughputQueries << std::endl)
         COUTATOMIC("total_throughput=" << throughputAll << std::endl)
@@ -106,6 +112,7 @@ struct Statistic {
             COUTATOMIC(indented_title_with_data("total fail gets", totalFailGets, 2, 32))
         }
         COUTATOMIC(indented_title_with_data("total rq", totalRQs, 1, 32))
+        COUTATOMIC(indented_title_with_data("total rq keys", totalRQKeys, 2, 32))
         COUTATOMIC(indented_title_with_data("total inserts", totalInserts, 1, 32))
         if (detail) {
             COUTATOMIC(indented_title_with_data("total successful inserts", totalSuccessfulInserts, 2, 32))
@@ -125,6 +132,7 @@ struct Statistic {
         COUTATOMIC(indented_title_with_data("total ops", totalAll, 1, 32))
         COUTATOMIC(indented_title_with_data("find throughput", throughputSearches, 1, 32))
         COUTATOMIC(indented_title_with_data("rq throughput", throughputRQs, 1, 32))
+        COUTATOMIC(indented_title_with_data("rq key throughput", throughputRQKeys, 2, 32))
         COUTATOMIC(indented_title_with_data("update throughput", throughputUpdates, 1, 32))
         COUTATOMIC(indented_title_with_data("query throughput", throughputQueries, 1, 32))
         COUTATOMIC(indented_title_with_data("total throughput", throughputAll, 1, 32))
@@ -139,6 +147,7 @@ void to_json(nlohmann::json &json, const Statistic &s) {
     json["total_fail_gets"] = s.totalFailGets;
 
     json["total_rq"] = s.totalRQs;
+    json["total_rq_keys"] = s.totalRQKeys;
 
     json["total_inserts"] = s.totalInserts;
     json["total_successful_inserts"] = s.totalSuccessfulInserts;
@@ -156,6 +165,7 @@ void to_json(nlohmann::json &json, const Statistic &s) {
     json["total_ops"] = s.totalAll;
     json["find_throughput"] = s.throughputSearches;
     json["rq_throughput"] = s.throughputRQs;
+    json["rq_key_throughput"] = s.throughputRQKeys;
     json["update_throughput"] = s.throughputUpdates;
     json["query_throughput"] = s.throughputQueries;
     json["total_throughput"] = s.throughputAll;
@@ -167,6 +177,7 @@ void from_json(const nlohmann::json &json, Statistic &s) {
     s.totalFailGets = json["total_fail_gets"];
 
     s.totalRQs = json["total_rq"];
+    s.totalRQKeys = json.contains("total_rq_keys") ? (long long) json["total_rq_keys"] : 0;
 
     s.totalInserts = json["total_inserts"];
     s.totalSuccessfulInserts = json["total_successful_inserts"];
@@ -184,6 +195,7 @@ void from_json(const nlohmann::json &json, Statistic &s) {
     s.totalAll = json["total_ops"];
     s.throughputSearches = json["find_throughput"];
     s.throughputRQs = json["rq_throughput"];
+    s.throughputRQKeys = json.contains("rq_key_throughput") ? (long long) json["rq_key_throughput"] : 0;
     s.throughputUpdates = json["update_throughput"];
     s.throughputQueries = json["query_throughput"];
     s.throughputAll = json["total_throughput"];
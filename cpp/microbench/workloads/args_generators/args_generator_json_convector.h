@@ -14,6 +14,7 @@
 #include "workloads/args_generators/impls/creakers_and_wave_args_generator.h"
 #include "workloads/args_generators/impls/temporary_skewed_args_generator.h"
 #include "workloads/args_generators/impls/leafs_handshake_args_generator.h"
+#include "workloads/args_generators/impls/range_query_args_generator.h"
 #include "errors.h"
 
 ArgsGeneratorBuilder *getArgsGeneratorFromJson(const nlohmann::json &j) {
@@ -33,6 +34,8 @@ ArgsGeneratorBuilder *getArgsGeneratorFromJson(const nlohmann::json &j) {
         argsGeneratorBuilder = new LeafsHandshakeArgsGeneratorBuilder();
     } else if (className == "SkewedInsertArgsGeneratorBuilder") {
         argsGeneratorBuilder = new SkewedInsertArgsGeneratorBuilder();
+    } else if (className == "RangeQueryArgsGeneratorBuilder") {
+        argsGeneratorBuilder = new RangeQueryArgsGeneratorBuilder();
     } else {
         setbench_error("JSON PARSER: Unknown class name ArgsGeneratorBuilder -- " + className)
     }
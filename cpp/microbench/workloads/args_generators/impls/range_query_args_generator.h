@@ -0,0 +1,202 @@
+#ifndef SETBENCH_RANGE_QUERY_ARGS_GENERATOR_H
+#define SETBENCH_RANGE_QUERY_ARGS_GENERATOR_H
+
+#include <cmath>
+#include "workloads/args_generators/args_generator.h"
+#include "workloads/distributions/distribution.h"
+#include "workloads/data_maps/data_map.h"
+#include "random_xoshiro256p.h"
+#include "errors.h"
+
+/**
+ * Range queries with a controlled number of keys.
+ *
+ * The left key of a range comes from the distribution (like the keys of the
+ * other operations), and the range covers the next size-1 keys after it.
+ * The size is Fixed (maxSize), Uniform in [minSize, maxSize] or LogUniform in
+ * [minSize, maxSize] (every order of magnitude is equally likely).
+ *
+ * Sizes count keys of the key space, so with a half-full tree a range of
+ * size s returns about s/2 keys (the num_rq_keys stat has the exact count).
+ */
+enum class RangeSizeDistribution {
+    FIXED, UNIFORM, LOG_UNIFORM
+};
+
+template<typename K>
+class RangeQueryArgsGenerator : public ArgsGenerator<K> {
+private:
+    Random64 &rng;
+    Distribution *distribution;
+    DataMap<K> *data;
+    RangeSizeDistribution sizeDistribution;
+    size_t minSize;
+    size_t maxSize;
+
+    K next() {
+        size_t index = distribution->next();
+        return data->get(index);
+    }
+
+    size_t nextSize() {
+        switch (sizeDistribution) {
+            case RangeSizeDistribution::UNIFORM:
+                return minSize + rng.next(maxSize - minSize + 1);
+            case RangeSizeDistribution::LOG_UNIFORM: {
+                const double logMin = std::log((double) minSize);
+                const double logMax = std::log((double) maxSize + 1);
+                const size_t size = (size_t) std::exp(logMin + rng.nextDouble() * (logMax - logMin));
+                return (size > maxSize) ? maxSize : size;
+            }
+            default:
+                return maxSize;
+        }
+    }
+
+public:
+    RangeQueryArgsGenerator(Random64 &_rng, DataMap<K> *_data, Distribution *_distribution,
+                            RangeSizeDistribution _sizeDistribution, size_t _minSize, size_t _maxSize)
+            : rng(_rng), distribution(_distribution), data(_data),
+              sizeDistribution(_sizeDistribution), minSize(_minSize), maxSize(_maxSize) {}
+
+    K nextGet() override {
+        return next();
+    }
+
+    K nextInsert() override {
+        return next();
+    }
+
+    K nextRemove() override {
+        return next();
+    }
+
+    std::pair<K, K> nextRange() override {
+        K left = next();
+        return {left, left + (K) nextSize() - 1};
+    }
+
+    ~RangeQueryArgsGenerator() override {
+        delete distribution;
+        delete data;
+    }
+};
+
+
+#include "workloads/distributions/distribution_builder.h"
+#include "workloads/data_maps/data_map_builder.h"
+#include "workloads/distributions/builders/uniform_distribution_builder.h"
+#include "workloads/data_maps/builders/id_data_map_builder.h"
+#include "workloads/args_generators/args_generator_builder.h"
+#include "workloads/distributions/distribution_json_convector.h"
+#include "workloads/data_maps/data_map_json_convector.h"
+#include "globals_extern.h"
+
+//template<typename K>
+class RangeQueryArgsGeneratorBuilder : public ArgsGeneratorBuilder {
+private:
+    size_t range;
+public:
+    DistributionBuilder *distributionBuilder = new UniformDistributionBuilder();
+    DataMapBuilder *dataMapBuilder = new IdDataMapBuilder();
+    RangeSizeDistribution sizeDistribution = RangeSizeDistribution::FIXED;
+    size_t minSize = 1;
+    size_t maxSize = 100;
+
+    RangeQueryArgsGeneratorBuilder *setDistributionBuilder(DistributionBuilder *_distributionBuilder) {
+        distributionBuilder = _distributionBuilder;
+        return this;
+    }
+
+    RangeQueryArgsGeneratorBuilder *setDataMapBuilder(DataMapBuilder *_dataMapBuilder) {
+        dataMapBuilder = _dataMapBuilder;
+        return this;
+    }
+
+    RangeQueryArgsGeneratorBuilder *setSizeDistribution(RangeSizeDistribution _sizeDistribution) {
+        sizeDistribution = _sizeDistribution;
+        return this;
+    }
+
+    RangeQueryArgsGeneratorBuilder *setMinSize(size_t _minSize) {
+        minSize = _minSize;
+        return this;
+    }
+
+    RangeQueryArgsGeneratorBuilder *setMaxSize(size_t _maxSize) {
+        maxSize = _maxSize;
+        return this;
+    }
+
+    RangeQueryArgsGeneratorBuilder *init(size_t _range) override {
+        range = _range;
+        if (minSize < 1 || maxSize < minSize) {
+            setbench_error("RangeQueryArgsGeneratorBuilder: need 1 <= minSize <= maxSize")
+        }
+        return this;
+    }
+
+    RangeQueryArgsGenerator<K> *build(Random64 &_rng) override {
+        return new RangeQueryArgsGenerator<K>(_rng, dataMapBuilder->build(),
+                                              distributionBuilder->build(_rng, range),
+                                              sizeDistribution, minSize, maxSize);
+    }
+
+    static std::string sizeDistributionName(RangeSizeDistribution d) {
+        switch (d) {
+            case RangeSizeDistribution::UNIFORM: return "Uniform";
+            case RangeSizeDistribution::LOG_UNIFORM: return "LogUniform";
+            default: return "Fixed";
+        }
+    }
+
+    void toJson(nlohmann::json &j) const override {
+        j["ClassName"] = "RangeQueryArgsGeneratorBuilder";
+        j["distributionBuilder"] = *distributionBuilder;
+        j["dataMapBuilder"] = *dataMapBuilder;
+        j["sizeDistribution"] = sizeDistributionName(sizeDistribution);
+        j["minSize"] = minSize;
+        j["maxSize"] = maxSize;
+    }
+
+    void fromJson(const nlohmann::json &j) override {
+        distributionBuilder = getDistributionFromJson(j["distributionBuilder"]);
+        dataMapBuilder = getDataMapFromJson(j["dataMapBuilder"]);
+        if (j.contains("sizeDistribution")) {
+            std::string name = j["sizeDistribution"];
+            if (name == "Fixed") {
+                sizeDistribution = RangeSizeDistribution::FIXED;
+            } else if (name == "Uniform") {
+                sizeDistribution = RangeSizeDistribution::UNIFORM;
+            } else if (name == "LogUniform") {
+                sizeDistribution = RangeSizeDistribution::LOG_UNIFORM;
+            } else {
+                setbench_error("JSON PARSER: Unknown sizeDistribution of RangeQueryArgsGeneratorBuilder -- " + name)
+            }
+        }
+        if (j.contains("minSize")) {
+            minSize = j["minSize"];
+        }
+        if (j.contains("maxSize")) {
+            maxSize = j["maxSize"];
+        }
+    }
+
+    std::string toString(size_t indents = 1) override {
+        return indented_title_with_str_data("Type", "RANGE_QUERY", indents)
+               + indented_title_with_str_data("Size distribution", sizeDistributionName(sizeDistribution), indents)
+               + indented_title_with_data("Min size", minSize, indents)
+               + indented_title_with_data("Max size", maxSize, indents)
+               + indented_title("Distribution", indents)
+               + distributionBuilder->toString(indents + 1)
+               + indented_title("Data Map", indents)
+               + dataMapBuilder->toString(indents + 1);
+    }
+
+    ~RangeQueryArgsGeneratorBuilder() override {
+        delete distributionBuilder;
+//        delete dataMapBuilder; //TODO may delete twice
+    };
+};
+
+#endif //SETBENCH_RANGE_QUERY_ARGS_GENERATOR_H
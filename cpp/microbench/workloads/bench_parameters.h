@@ -5,13 +5,17 @@
 #ifndef SETBENCH_BENCH_PARAMETERS_H
 #define SETBENCH_BENCH_PARAMETERS_H
 
+#include <random>
 #include "globals_extern.h"
+#include "ds_parameters.h"
 #include "parameters.h"
 #include "workloads/stop_condition/impls/operation_counter.h"
 #include "workloads/thread_loops/impls/default_thread_loop.h"
 
 struct BenchParameters {
     size_t range;
+    // seeds the data maps, the per-thread RNGs of the workloads and rand(); 0 = pick one at init
+    uint64_t seed;
 
     Parameters* test;
     Parameters* prefill;
@@ -19,6 +23,7 @@ struct BenchParameters {
 
     BenchParameters() {
         range = 2048;
+        seed = 0;
         //        test = nullptr;
         //        prefill = nullptr;
         //        warmUp = nullptr;
@@ -48,6 +53,11 @@ struct BenchParameters {
         return *this;
     }
 
+    BenchParameters& setSeed(uint64_t _seed) {
+        seed = _seed;
+        return *this;
+    }
+
     BenchParameters& setTest(Parameters* _test) {
         test = _test;
         return *this;
@@ -82,7 +92,10 @@ struct BenchParameters {
         //        if (warmUp == nullptr) {
         //            warmUp = new Parameters();
         //        }
-        initDataMapBuilders(range);
+        if (seed == 0) {
+            seed = std::random_device()();
+        }
+        initDataMapBuilders(range, seed);
         prefill->init(range);
         warmUp->init(range);
         test->init(range);
@@ -90,6 +103,7 @@ struct BenchParameters {
 
     std::string toString(size_t indents = 1) {
         return indented_title_with_data("Range", range, indents) +
+               indented_title_with_data("Seed", seed, indents) +
                (prefill->getNumThreads() == 0
                     ? toStringStage("without prefill")
                     : toStringStage("prefill parameters") + prefill->toString(indents + 1)) +
@@ -109,16 +123,30 @@ struct BenchParameters {
 
 void to_json(nlohmann::json& json, const BenchParameters& s) {
     json["range"] = s.range;
+    if (s.seed != 0) {
+        json["seed"] = s.seed;
+    }
     json["test"] = *s.test;
     json["prefill"] = *s.prefill;
     json["warmUp"] = *s.warmUp;
+    for (auto &entry: ds_parameters::all()) {
+        json["dsParameters"][entry.first] = entry.second;
+    }
 }
 
 void from_json(const nlohmann::json& json, BenchParameters& s) {
     s.range = json["range"];
+    s.seed = json.contains("seed") ? json["seed"].get<uint64_t>() : 0;
     s.test = new Parameters(json["test"]);
     s.prefill = new Parameters(json["prefill"]);
     s.warmUp = new Parameters(json["warmUp"]);
+    if (json.contains("dsParameters")) {
+        for (auto &entry: json["dsParameters"].items()) {
+            ds_parameters::set(entry.key(), entry.value().is_string()
+                                            ? entry.value().get<std::string>()
+                                            : entry.value().dump());
+        }
+    }
 }
 
 #endif  // SETBENCH_BENCH_PARAMETERS_H
@@ -14,7 +14,7 @@ class ArrayDataMapBuilder : public DataMapBuilder {
     long long* data = nullptr;
 
 public:
-    ArrayDataMapBuilder* init(size_t range) override {
+    ArrayDataMapBuilder* init(size_t range, uint64_t seed) override {
         delete[] data;
 
         data = new long long[range];
@@ -23,7 +23,7 @@ public:
         }
 
         //        std::random_shuffle(data, data + range - 1);
-        std::shuffle(data, data + range, std::mt19937(std::random_device()()));
+        std::shuffle(data, data + range, std::mt19937_64(seed));
         return this;
     }
 
@@ -10,7 +10,7 @@
 #include "globals_extern.h"
 
 struct IdDataMapBuilder : public DataMapBuilder {
-    IdDataMapBuilder* init(size_t range) override {
+    IdDataMapBuilder* init(size_t range, uint64_t seed) override {
         return this;
     };
 
@@ -5,6 +5,7 @@
 #ifndef SETBENCH_DATA_MAP_BUILDER_H
 #define SETBENCH_DATA_MAP_BUILDER_H
 
+#include <cstdint>
 #include <string>
 #include "data_map.h"
 #include "json/single_include/nlohmann/json.hpp"
@@ -17,7 +18,8 @@ struct DataMapBuilder {
 
     const size_t id = id_counter++;
 
-    virtual DataMapBuilder *init(size_t range) = 0;
+    // seed: for the data maps that are randomized (the same seed gives the same map)
+    virtual DataMapBuilder *init(size_t range, uint64_t seed) = 0;
 
     virtual DataMap<K> *build() = 0;
 
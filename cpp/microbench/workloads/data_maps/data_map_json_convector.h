@@ -45,9 +45,10 @@ void deleteDataMapBuilders() {
     }
 }
 
-void initDataMapBuilders(size_t range) {
+void initDataMapBuilders(size_t range, uint64_t seed) {
     for (auto it: dataMapBuilders) {
-        it.second->init(range);
+        // (different maps get different shuffles, as with random seeds)
+        it.second->init(range, seed + it.first);
     }
 }
 
@@ -15,11 +15,78 @@
 #include "workloads/stop_condition/stop_condition_json_convector.h"
 #include "workloads/thread_loops/thread_loop_json_convector.h"
 #include "binding.h"
+#include "errors.h"
 
+RangeQueryMode rangeQueryModeFromJson(const nlohmann::json &j) {
+    if (!j.contains("rqMode")) {
+        return RangeQueryMode::MATERIALIZE;
+    }
+    std::string name = j["rqMode"];
+    if (name == "Materialize") {
+        return RangeQueryMode::MATERIALIZE;
+    } else if (name == "Aggregate") {
+        return RangeQueryMode::AGGREGATE;
+    } else if (name == "Scan") {
+        return RangeQueryMode::SCAN;
+    }
+    setbench_error("JSON PARSER: Unknown rqMode -- " + name)
+}
+
+std::string rangeQueryModeName(const RangeQueryMode mode) {
+    switch (mode) {
+        case RangeQueryMode::AGGREGATE:
+            return "Aggregate";
+        case RangeQueryMode::SCAN:
+            return "Scan";
+        default:
+            return "Materialize";
+    }
+}
+
+BindingPolicy bindingPolicyFromJson(const nlohmann::json &j) {
+    if (!j.contains("pinPolicy")) {
+        return BindingPolicy::NONE;
+    }
+    std::string name = j["pinPolicy"];
+    if (name == "None") {
+        return BindingPolicy::NONE;
+    } else if (name == "Compact") {
+        return BindingPolicy::COMPACT;
+    } else if (name == "Scatter") {
+        return BindingPolicy::SCATTER;
+    } else if (name == "SmtLast") {
+        return BindingPolicy::SMT_LAST;
+    } else if (name == "NumaFill") {
+        return BindingPolicy::NUMA_FILL;
+    }
+    setbench_error("JSON PARSER: Unknown pinPolicy -- " + name)
+}
+
+std::string bindingPolicyName(const BindingPolicy policy) {
+    switch (policy) {
+        case BindingPolicy::COMPACT: return "Compact";
+        case BindingPolicy::SCATTER: return "Scatter";
+        case BindingPolicy::SMT_LAST: return "SmtLast";
+        case BindingPolicy::NUMA_FILL: return "NumaFill";
+        default: return "None";
+    }
+}
+
+/**
+ * The threads of a ThreadLoopSettings are pinned to the logical processors in
+ * pin, or, if pin is not given, by pinPolicy (see binding.h): the i-th thread
+ * of the stage (over all of its ThreadLoopSettings) gets the i-th logical
+ * processor of the policy. With numaPreferred (the default with a pinPolicy),
+ * each thread prefers its own NUMA node for its allocations (ignored without
+ * libnuma).
+ */
 struct ThreadLoopSettings {
     ThreadLoopBuilder *threadLoopBuilder;
     size_t quantity;
     int *pin;
+    RangeQueryMode rqMode = RangeQueryMode::MATERIALIZE;
+    BindingPolicy pinPolicy = BindingPolicy::NONE;
+    bool numaPreferred = false;
 
     ThreadLoopSettings(const nlohmann::json &j) {
         quantity = j["quantity"];
@@ -29,6 +96,9 @@ struct ThreadLoopSettings {
         } else {
             pin = nullptr;
         }
+        rqMode = rangeQueryModeFromJson(j);
+        pinPolicy = bindingPolicyFromJson(j);
+        numaPreferred = j.contains("numaPreferred") ? (bool) j["numaPreferred"] : pinPolicy != BindingPolicy::NONE;
         threadLoopBuilder = getThreadLoopFromJson(j["threadLoopBuilder"]);
     }
 
@@ -47,6 +117,22 @@ struct ThreadLoopSettings {
         return this;
     }
 
+    ThreadLoopSettings *setRqMode(RangeQueryMode _rqMode) {
+        rqMode = _rqMode;
+        return this;
+    }
+
+    ThreadLoopSettings *setPinPolicy(BindingPolicy _pinPolicy) {
+        pinPolicy = _pinPolicy;
+        numaPreferred = pinPolicy != BindingPolicy::NONE;
+        return this;
+    }
+
+    ThreadLoopSettings *setNumaPreferred(bool _numaPreferred) {
+        numaPreferred = _numaPreferred;
+        return this;
+    }
+
     ThreadLoopSettings() {}
 
     ThreadLoopSettings(ThreadLoopBuilder *threadLoopBuilder, size_t quantity = 1, int *pin = nullptr)
@@ -62,6 +148,11 @@ struct ThreadLoopSettings {
 void to_json(nlohmann::json &j, const ThreadLoopSettings &s) {
     j["quantity"] = s.quantity;
     j["threadLoopBuilder"] = *s.threadLoopBuilder;
+    j["rqMode"] = rangeQueryModeName(s.rqMode);
+    if (s.pinPolicy != BindingPolicy::NONE) {
+        j["pinPolicy"] = bindingPolicyName(s.pinPolicy);
+    }
+    j["numaPreferred"] = s.numaPreferred;
     if (s.pin != nullptr) {
         for (size_t i = 0; i < s.quantity; ++i) {
             j["pin"].push_back(s.pin[i]);
@@ -77,6 +168,9 @@ void from_json(const nlohmann::json &j, ThreadLoopSettings &s) {
     } else {
         std::fill(s.pin, s.pin + s.quantity, -1);
     }
+    s.rqMode = rangeQueryModeFromJson(j);
+    s.pinPolicy = bindingPolicyFromJson(j);
+    s.numaPreferred = j.contains("numaPreferred") ? (bool) j["numaPreferred"] : s.pinPolicy != BindingPolicy::NONE;
     s.threadLoopBuilder = getThreadLoopFromJson(j["threadLoopBuilder"]);
 }
 
@@ -118,6 +212,11 @@ public:
             for (size_t i = 0; i < _threadLoopSettings->quantity; ++i) {
                 pin.push_back(_threadLoopSettings->pin[i]);
             }
+        } else if (_threadLoopSettings->pinPolicy != BindingPolicy::NONE) {
+            std::vector<int> order = binding_policyOrder(_threadLoopSettings->pinPolicy);
+            for (size_t i = 0; i < _threadLoopSettings->quantity; ++i) {
+                pin.push_back(order[pin.size() % order.size()]);
+            }
         } else {
             for (size_t i = 0; i < _threadLoopSettings->quantity; ++i) {
                 pin.push_back(-1);
@@ -153,6 +252,8 @@ public:
 
             workload[threadId] = threadLoopBuilders[i]->threadLoopBuilder
                     ->build(_g, _rngs[threadId], threadId, stopCondition);
+            workload[threadId]->rqMode = threadLoopBuilders[i]->rqMode;
+            workload[threadId]->numaPreferred = threadLoopBuilders[i]->numaPreferred;
         }
         return workload;
     }
@@ -193,6 +294,15 @@ public:
 
         for (auto tls: threadLoopBuilders) {
             result += indented_title_with_data("quantity", tls->quantity, indents + 1);
+            if (tls->rqMode != RangeQueryMode::MATERIALIZE) {
+                result += indented_title_with_str_data("rq mode", rangeQueryModeName(tls->rqMode), indents + 1);
+            }
+            if (tls->pinPolicy != BindingPolicy::NONE) {
+                result += indented_title_with_str_data("pin policy", bindingPolicyName(tls->pinPolicy), indents + 1);
+            }
+            if (tls->numaPreferred) {
+                result += indented_title_with_str_data("numa preferred", "true", indents + 1);
+            }
 
             if (tls->pin != nullptr) {
                 pin_string = std::to_string(tls->pin[0]);
@@ -12,6 +12,20 @@
 
 typedef long long K;
 
+/**
+ * MATERIALIZE copies the keys and values of each range query into
+ * rqResultKeys and rqResultValues.
+ * AGGREGATE only computes count, sum, min and max of the keys, inside the data
+ * structure if its adapter supports it (see rq_aggregate.h), so the result
+ * arrays are not allocated.
+ * SCAN computes the same aggregate from a streaming snapshot of the range, if
+ * the adapter supports it (DS_ADAPTER_SUPPORTS_RQ_SNAPSHOT, see rq_dcssp.h),
+ * read in chunks of RQ_SCAN_CHUNK_KEYS keys (otherwise from rangeQuery).
+ */
+enum class RangeQueryMode {
+    MATERIALIZE, AGGREGATE, SCAN
+};
+
 class ThreadLoop {
 protected:
     K garbage = 0;
@@ -21,6 +35,8 @@ protected:
     int rq_cnt;
     size_t RQ_RANGE;
 public:
+    RangeQueryMode rqMode = RangeQueryMode::MATERIALIZE;
+    bool numaPreferred = false; // allocations prefer the NUMA node the thread is bound to
     size_t threadId;
     globals_t *g;
     StopCondition *stopCondition;
@@ -6,15 +6,49 @@
 #define SETBENCH_THREAD_LOOP_IMPL_H
 
 #include "adapter.h"
+#include "rq_aggregate.h"
 #include "globals_t_impl.h"
 #include "globals_extern.h"
 
+#ifdef USE_LIBNUMA
+#   include "numa_tools.h"
+#   define THREAD_SET_NUMA_PREFERRED if (numaPreferred) numa_set_preferred(__numa.get_node_slow());
+#else
+#   define THREAD_SET_NUMA_PREFERRED
+#endif
+
+#ifndef RQ_SCAN_CHUNK_KEYS
+#   define RQ_SCAN_CHUNK_KEYS 256
+#endif
+
+// size (in keys) of the result arrays of the range queries of each mode
+#if defined DS_ADAPTER_SUPPORTS_RQ_AGGREGATE || defined DS_ADAPTER_SUPPORTS_RQ_VISIT
+#   define RQ_AGGREGATE_RESULT_ARRAYS_SIZE 0
+#else
+#   define RQ_AGGREGATE_RESULT_ARRAYS_SIZE (this->RQ_RANGE+MAX_KEYS_PER_NODE)
+#endif
+#ifdef DS_ADAPTER_SUPPORTS_RQ_SNAPSHOT
+#   define RQ_SCAN_RESULT_ARRAYS_SIZE RQ_SCAN_CHUNK_KEYS
+#else
+#   define RQ_SCAN_RESULT_ARRAYS_SIZE (this->RQ_RANGE+MAX_KEYS_PER_NODE)
+#endif
+#define RQ_RESULT_ARRAYS_SIZE(mode) \
+    ((mode) == RangeQueryMode::AGGREGATE ? (size_t) RQ_AGGREGATE_RESULT_ARRAYS_SIZE \
+     : (mode) == RangeQueryMode::SCAN ? (size_t) RQ_SCAN_RESULT_ARRAYS_SIZE \
+     : (size_t) (this->RQ_RANGE+MAX_KEYS_PER_NODE))
+
 #define THREAD_MEASURED_PRE \
     tid = this->threadId; \
     binding_bindThread(tid); \
+    THREAD_SET_NUMA_PREFERRED \
     garbage = 0; \
-    rqResultKeys = new K[this->RQ_RANGE+MAX_KEYS_PER_NODE]; \
-    rqResultValues = new VALUE_TYPE[this->RQ_RANGE+MAX_KEYS_PER_NODE]; \
+    if (RQ_RESULT_ARRAYS_SIZE(rqMode)) { \
+        rqResultKeys = new K[RQ_RESULT_ARRAYS_SIZE(rqMode)]; \
+        rqResultValues = new VALUE_TYPE[RQ_RESULT_ARRAYS_SIZE(rqMode)]; \
+    } else { \
+        rqResultKeys = NULL; \
+        rqResultValues = NULL; \
+    } \
     NO_VALUE = this->g->dsAdapter->getNoValue();                  \
     __RLU_INIT_THREAD; \
     __RCU_INIT_THREAD; \
@@ -128,6 +162,56 @@ bool ThreadLoop::executeContains(const K &key) {
 template<typename K>
 void ThreadLoop::executeRangeQuery(const K &leftKey, const K &rightKey) {
     ++rq_cnt;
+    if (rqMode == RangeQueryMode::AGGREGATE) {
+#if defined DS_ADAPTER_SUPPORTS_RQ_AGGREGATE
+        rq_aggregate<K> aggregate = this->g->dsAdapter->rangeQueryAggregate(this->threadId, leftKey, rightKey);
+#elif defined DS_ADAPTER_SUPPORTS_RQ_VISIT
+        rq_aggregate<K> aggregate;
+        this->g->dsAdapter->rangeQueryVisit(this->threadId, leftKey, rightKey, aggregate);
+#else
+        rq_aggregate<K> aggregate;
+        size_t rqcnt = this->g->dsAdapter->rangeQuery(this->threadId, leftKey, rightKey,
+                                                      rqResultKeys, (VALUE_TYPE*) rqResultValues);
+        for (size_t i = 0; i < rqcnt; ++i) {
+            aggregate.add(rqResultKeys[i]);
+        }
+#endif
+        if (aggregate.count) {
+            garbage += aggregate.sum + aggregate.min + aggregate.max; // prevent the aggregate from being optimized out
+        }
+        GSTATS_ADD(threadId, num_rq, 1);
+        GSTATS_ADD(threadId, num_rq_keys, aggregate.count);
+        GSTATS_ADD(threadId, num_operations, 1);
+        return;
+    }
+    if (rqMode == RangeQueryMode::SCAN) {
+        rq_aggregate<K> aggregate;
+#if defined DS_ADAPTER_SUPPORTS_RQ_SNAPSHOT
+        static thread_local typename DS_ADAPTER_T::SnapshotCursor cursor;
+        this->g->dsAdapter->snapshotBegin(this->threadId, leftKey, rightKey, &cursor);
+        int cnt;
+        while ((cnt = this->g->dsAdapter->snapshotNext(this->threadId, &cursor, rqResultKeys,
+                                                       (VALUE_TYPE*) rqResultValues, RQ_SCAN_CHUNK_KEYS))) {
+            for (int i = 0; i < cnt; ++i) {
+                aggregate.add(rqResultKeys[i]);
+            }
+        }
+        this->g->dsAdapter->snapshotEnd(this->threadId, &cursor);
+#else
+        size_t rqcnt = this->g->dsAdapter->rangeQuery(this->threadId, leftKey, rightKey,
+                                                      rqResultKeys, (VALUE_TYPE*) rqResultValues);
+        for (size_t i = 0; i < rqcnt; ++i) {
+            aggregate.add(rqResultKeys[i]);
+        }
+#endif
+        if (aggregate.count) {
+            garbage += aggregate.sum + aggregate.min + aggregate.max; // prevent the aggregate from being optimized out
+        }
+        GSTATS_ADD(threadId, num_rq, 1);
+        GSTATS_ADD(threadId, num_rq_keys, aggregate.count);
+        GSTATS_ADD(threadId, num_operations, 1);
+        return;
+    }
     size_t rqcnt;
     if ((rqcnt = this->g->dsAdapter->rangeQuery(this->threadId, leftKey, rightKey,
                                                 rqResultKeys, (VALUE_TYPE*) rqResultValues))) {
@@ -135,6 +219,7 @@ void ThreadLoop::executeRangeQuery(const K &leftKey, const K &rightKey) {
                    rqResultKeys[rqcnt - 1]; // prevent rqResultValues and count from being optimized out
     }
     GSTATS_ADD(threadId, num_rq, 1);
+    GSTATS_ADD(threadId, num_rq_keys, rqcnt);
     GSTATS_ADD(threadId, num_operations, 1);
 }
 
@@ -0,0 +1,293 @@
+import argparse
+import csv
+import math
+import os
+import re
+import subprocess
+import sys
+import time
+from pathlib import Path
+
+DEFAULT_OUTPUT_DIR_NAME = "matrix-output"
+DEFAULT_TIMEOUT = 600
+
+RUNS_FILE = "runs.csv"
+SUMMARY_FILE = "summary.csv"
+
+GLIBC = "glibc"
+ISOLATED_CPUS_FILE = "/sys/devices/system/cpu/isolated"
+
+# a cell of the matrix
+CELL_COLUMNS = ["ds", "reclaimer", "allocator", "workload", "key_range"]
+RUN_COLUMNS = CELL_COLUMNS + ["run", "seconds", "total_throughput", "find_throughput",
+                              "update_throughput", "rq_throughput", "status"]
+SUMMARY_COLUMNS = CELL_COLUMNS + ["runs", "mean", "stddev", "ci95_half_width", "ci95_relative",
+                                  "baseline_mean", "baseline_ci95_half_width", "change", "flag"]
+
+STATS = ["total_throughput", "find_throughput", "update_throughput", "rq_throughput"]
+
+# two-sided 95% quantiles of Student's t distribution, by degrees of freedom
+T_975 = [None, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+         2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+         2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+
+def t_975(df):
+    if df < len(T_975):
+        return T_975[df]
+    return 1.960
+
+
+def mean_and_ci(values):
+    """Mean, sample standard deviation and half-width of the 95% confidence interval of the mean."""
+    n = len(values)
+    mean = sum(values) / n
+    if n < 2:
+        return mean, 0.0, math.inf
+    stddev = math.sqrt(sum((v - mean) ** 2 for v in values) / (n - 1))
+    return mean, stddev, t_975(n - 1) * stddev / math.sqrt(n)
+
+
+class Cell:
+    def __init__(self, ds, reclaimer, allocator, workload, key_range):
+        self.ds = ds
+        self.reclaimer = reclaimer
+        self.allocator = allocator
+        self.workload = workload
+        self.key_range = key_range
+        self.values = []
+        self.failures = 0
+
+    def key(self):
+        return (self.ds, self.reclaimer, self.allocator, Path(self.workload).stem, str(self.key_range))
+
+    def name(self):
+        return " ".join(self.key())
+
+    def summary(self):
+        mean, stddev, half_width = mean_and_ci(self.values) if self.values else (0.0, 0.0, math.inf)
+        return mean, stddev, half_width
+
+    def done(self, args):
+        if len(self.values) >= args.max_runs or self.failures >= args.max_failures:
+            return True
+        if len(self.values) < args.min_runs:
+            return False
+        mean, _, half_width = self.summary()
+        return mean > 0 and half_width / mean <= args.ci_target
+
+
+def extract(stat, log):
+    m = re.search(f"^{stat}=([\\d\\.]+)", log, re.MULTILINE)
+    return None if m is None else float(m.group(1))
+
+
+def run_cell(cell, run, args, output_dir):
+    binary = args.setbench_dir / "microbench" / "bin" / f"{cell.ds}.{cell.reclaimer}"
+    result_file = output_dir / "results" / f"{'_'.join(cell.key())}.run{run}.json"
+    command = [str(binary), "-range", str(cell.key_range), "-create-default-prefill",
+               "-test", str(Path(cell.workload).resolve()), "-result-file", str(result_file)]
+    command += args.extra_args.split() if args.extra_args else []
+    if args.cores:
+        command = ["taskset", "-c", args.cores] + command
+
+    env = os.environ.copy()
+    if cell.allocator != GLIBC:
+        env["LD_PRELOAD"] = str(args.setbench_dir / "lib" / f"lib{cell.allocator}.so")
+
+    start = time.time()
+    try:
+        cp = subprocess.run(command, cwd=str(args.setbench_dir / "microbench"), env=env,
+                            timeout=args.timeout, check=True, capture_output=True, text=True)
+        log, status = cp.stdout, "ok"
+    except subprocess.CalledProcessError as exc:
+        log, status = exc.stdout or "", f"exit {exc.returncode}"
+    except subprocess.TimeoutExpired as exc:
+        log, status = "", "timeout"
+    seconds = time.time() - start
+
+    values = {stat: extract(stat, str(log)) for stat in STATS}
+    if status == "ok" and values["total_throughput"] is None:
+        status = "no total_throughput"
+    return seconds, values, status
+
+
+def read_baseline(baseline_file):
+    baseline = {}
+    with open(baseline_file) as inf:
+        for row in csv.DictReader(inf):
+            if not row["mean"] or not row["ci95_half_width"]:
+                continue  # (the cell failed, or had one run)
+            key = tuple(row[column] for column in CELL_COLUMNS)
+            baseline[key] = (float(row["mean"]), float(row["ci95_half_width"]))
+    return baseline
+
+
+def compare(mean, half_width, base_mean, base_half_width, threshold):
+    """A regression is a drop of more than threshold whose confidence interval does not overlap the baseline's."""
+    change = (mean - base_mean) / base_mean if base_mean > 0 else 0.0
+    if change < -threshold and mean + half_width < base_mean - base_half_width:
+        return change, "regression"
+    if change > threshold and mean - half_width > base_mean + base_half_width:
+        return change, "improvement"
+    return change, ""
+
+
+def write_summary(cells, baseline, args, output_dir):
+    """Returns the cells that regressed (with their change) and the cells without a successful run."""
+    regressions, failed = [], []
+    with open(output_dir / SUMMARY_FILE, "w", newline="") as ouf:
+        writer = csv.writer(ouf)
+        writer.writerow(SUMMARY_COLUMNS)
+        for cell in cells:
+            mean, stddev, half_width = cell.summary()
+            base_mean, base_half_width, change, flag = "", "", "", ""
+            if cell.key() in baseline:
+                base_mean, base_half_width = baseline[cell.key()]
+            if not cell.values:
+                flag = "failed"
+                failed.append(cell)
+            elif cell.key() in baseline:
+                change, flag = compare(mean, half_width, base_mean, base_half_width, args.regression_threshold)
+                if flag == "regression":
+                    regressions.append((cell, change))
+            relative = half_width / mean if mean > 0 and not math.isinf(half_width) else ""
+            writer.writerow(list(cell.key()) + [len(cell.values), mean, stddev,
+                                                "" if math.isinf(half_width) else half_width, relative,
+                                                base_mean, base_half_width, change, flag])
+    return regressions, failed
+
+
+def default_cores():
+    try:
+        with open(ISOLATED_CPUS_FILE) as inf:
+            return inf.read().strip() or None
+    except OSError:
+        return None
+
+
+def prepare(args):
+    """Resolves the directories and the cores, and returns the output directory."""
+    args.setbench_dir = args.setbench_dir.resolve()
+    output_dir = args.output_dir.resolve()
+    (output_dir / "results").mkdir(parents=True, exist_ok=True)
+
+    if args.cores is None:
+        args.cores = default_cores()
+    if args.cores is None:
+        print("WARNING: no isolated cores (see isolcpus), so runs are not pinned: use --cores to choose the cores")
+    return output_dir
+
+
+def run_cells(cells, args, output_dir):
+    """Runs the cells until every one of them is done, and writes every run to runs.csv."""
+    with open(output_dir / RUNS_FILE, "w", newline="") as runs_file:
+        writer = csv.writer(runs_file)
+        writer.writerow(RUN_COLUMNS)
+        # one run of every unfinished cell per round, so slow drift of the machine affects all cells alike
+        run = 0
+        while True:
+            pending = [cell for cell in cells if not cell.done(args)]
+            if not pending:
+                break
+            for cell in pending:
+                seconds, values, status = run_cell(cell, run, args, output_dir)
+                if status == "ok":
+                    cell.values.append(values["total_throughput"])
+                else:
+                    cell.failures += 1
+                writer.writerow(list(cell.key()) + [run, round(seconds, 3)]
+                                + ["" if values[stat] is None else values[stat] for stat in STATS] + [status])
+                runs_file.flush()
+                mean, _, half_width = cell.summary()
+                print(f"round {run}: {cell.name()}: {status} total_throughput={values['total_throughput']} "
+                      f"(n={len(cell.values)} mean={mean:.0f} ci95=±{half_width:.0f})")
+            run += 1
+    for cell in cells:
+        if cell.values and cell.summary()[2] > args.ci_target * cell.summary()[0]:
+            print(f"WARNING: {cell.name()}: the 95% CI did not reach ±{args.ci_target:.1%} in {len(cell.values)} runs")
+
+
+def start(args):
+    output_dir = prepare(args)
+
+    cells = [Cell(ds, reclaimer, allocator, workload, key_range)
+             for ds in args.ds
+             for reclaimer in args.reclaimer
+             for allocator in args.allocator
+             for workload in args.workload
+             for key_range in args.key]
+    baseline = read_baseline(args.baseline) if args.baseline else {}
+
+    print("START MATRIX")
+    run_cells(cells, args, output_dir)
+    print("END MATRIX")
+
+    regressions, failed = write_summary(cells, baseline, args, output_dir)
+    for cell in failed:
+        print(f"FAILED: {cell.name()}: no successful runs ({cell.failures} failures)")
+    for cell, change in regressions:
+        print(f"REGRESSION: {cell.name()}: {change:+.1%} vs. baseline")
+    print(f"results: {output_dir / RUNS_FILE}, {output_dir / SUMMARY_FILE}")
+    return regressions
+
+
+def check_args(args):
+    if args.min_runs < 2:
+        raise ValueError("min-runs must be >= 2 (a confidence interval needs two runs)")
+    if args.max_runs < args.min_runs:
+        raise ValueError("max-runs must be >= min-runs")
+    if args.max_failures <= 0:
+        raise ValueError("max-failures must be > 0")
+    if not (0 < args.ci_target < 1):
+        raise ValueError("ci-target must be in (0; 1)")
+    if not (0 <= args.regression_threshold < 1):
+        raise ValueError("regression-threshold must be in [0; 1)")
+    if any(map(lambda k: k <= 0, args.key)):
+        raise ValueError("all keys must be > 0")
+    if args.timeout <= 0:
+        raise ValueError("timeout must be > 0")
+    for workload in args.workload:
+        if not Path(workload).is_file():
+            raise ValueError(f"workload file {workload} does not exist")
+    if args.baseline and not Path(args.baseline).is_file():
+        raise ValueError(f"baseline file {args.baseline} does not exist")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="""
+        Runs every (data structure, reclaimer, allocator, workload, key range) cell of a matrix,
+        one benchmark at a time, and repeats every cell until the 95% confidence interval
+        of its total throughput is within ±ci-target of the mean.
+
+        Writes every run to runs.csv and one row per cell to summary.csv, which can be used
+        as the baseline of a later run: cells that became slower by more than the
+        regression threshold, with confidence intervals that do not overlap, are flagged.
+    """)
+    runner_group = parser.add_argument_group("runner args")
+    runner_group.add_argument("-o", "--output-dir", type=Path, default=Path.cwd() / DEFAULT_OUTPUT_DIR_NAME, help="Directory where results will be stored")
+    runner_group.add_argument("-s", "--setbench-dir", type=Path, default=Path.cwd().parent, help="Directory where setbench is located")
+    runner_group.add_argument("--cores", type=str, default=None, help=f"Cores to run the benchmarks on (taskset -c list). Default: the isolated cores in {ISOLATED_CPUS_FILE}")
+    runner_group.add_argument("--ci-target", type=float, default=0.02, help="Repeat a cell until the 95%% CI half-width is at most this fraction of the mean")
+    runner_group.add_argument("--min-runs", type=int, default=3, help="Minimum number of runs per cell")
+    runner_group.add_argument("--max-runs", type=int, default=20, help="Maximum number of runs per cell")
+    runner_group.add_argument("--max-failures", type=int, default=3, help="Give up on a cell after this many failed runs")
+    runner_group.add_argument("--timeout", type=int, default=DEFAULT_TIMEOUT, help="Timeout in seconds of each run")
+    runner_group.add_argument("--baseline", type=str, default=None, help="summary.csv of an earlier run to compare with")
+    runner_group.add_argument("--regression-threshold", type=float, default=0.05, help="Relative drop of the mean that is a regression")
+    runner_group.add_argument("--fail-on-regression", action="store_true", help="Exit with status 1 if a regression is flagged")
+
+    setbench_group = parser.add_argument_group("setbench args")
+    setbench_group.add_argument("--ds", nargs="+", required=True, action="extend", help="Data structures to benchmark")
+    setbench_group.add_argument("--reclaimer", nargs="+", default=["debra"], help="Reclaimers (binaries are bin/<ds>.<reclaimer>)")
+    setbench_group.add_argument("--allocator", nargs="+", default=[GLIBC], help=f"Allocators (lib/lib<allocator>.so is preloaded, {GLIBC} preloads nothing)")
+    setbench_group.add_argument("--workload", nargs="+", required=True, help="Test stage json files (-test setbench arg)")
+    setbench_group.add_argument("-k", "--key", nargs="+", required=True, type=int, help="Stands for -range setbench arg")
+    setbench_group.add_argument("--extra-args", type=str, default="", help="Other setbench args for every run")
+
+    args = parser.parse_args()
+
+    check_args(args)
+    regressions = start(args)
+    if regressions and args.fail_on_regression:
+        sys.exit(1)
@@ -0,0 +1,137 @@
+import argparse
+import json
+import math
+import os
+import platform
+import sys
+from pathlib import Path
+
+from matrix_runner import Cell, prepare, run_cells
+
+DEFAULT_OUTPUT_DIR_NAME = "regression-output"
+SUITE_FILE = "suite.json"
+BASELINE_FILE = "baseline.json"
+ALLOCATOR = "glibc"
+
+
+def machine_info():
+    model = ""
+    try:
+        with open("/proc/cpuinfo") as inf:
+            for line in inf:
+                if line.startswith("model name"):
+                    model = line.split(":", 1)[1].strip()
+                    break
+    except OSError:
+        pass
+    return {"cpu": model, "cpus": os.cpu_count(), "kernel": platform.release()}
+
+
+def cell_name(cell):
+    return f"{cell.ds}/{Path(cell.workload).stem}"
+
+
+def check(cells, baseline):
+    """Compares every cell with its baseline, and returns the cells that regressed."""
+    default_tolerance = baseline.get("tolerance", 0.1)
+    regressions = []
+    print(f"{'cell':<40} {'mean':>14} {'ci95':>10} {'baseline':>14} {'change':>8}  status")
+    for cell in cells:
+        mean, _, half_width = cell.summary()
+        base = baseline["cells"].get(cell_name(cell))
+        if not cell.values:
+            status, base_mean, change = "FAILED", 0, ""
+            regressions.append(cell)
+        elif base is None:
+            status, base_mean, change = "new (not in the baseline)", 0, ""
+        else:
+            tolerance = base.get("tolerance", default_tolerance)
+            base_mean = base["total_throughput"]
+            change = f"{(mean - base_mean) / base_mean:+.1%}"
+            # the whole confidence interval must be outside the tolerance band
+            if mean + half_width < base_mean * (1 - tolerance):
+                status = f"REGRESSION (more than {tolerance:.0%} slower)"
+                regressions.append(cell)
+            elif mean - half_width > base_mean * (1 + tolerance):
+                status = f"faster by more than {tolerance:.0%} (consider updating the baseline)"
+            else:
+                status = "ok"
+        ci = "" if math.isinf(half_width) else f"±{half_width:.0f}"
+        print(f"{cell_name(cell):<40} {mean:>14.0f} {ci:>10} {base_mean:>14.0f} {change:>8}  {status}")
+    return regressions
+
+
+def update_baseline(cells, baseline, baseline_file):
+    baseline["machine"] = machine_info()
+    for cell in cells:
+        if not cell.values:
+            continue
+        mean, _, half_width = cell.summary()
+        entry = baseline["cells"].get(cell_name(cell), {})
+        entry.update({"total_throughput": round(mean), "ci95_half_width": round(half_width), "runs": len(cell.values)})
+        baseline["cells"][cell_name(cell)] = entry
+    with open(baseline_file, "w") as ouf:
+        json.dump(baseline, ouf, indent=4, sort_keys=True)
+        ouf.write("\n")
+    print(f"updated {baseline_file}")
+
+
+def start(args):
+    suite_dir = args.suite_dir or args.setbench_dir / "microbench" / "regression"
+    with open(suite_dir / SUITE_FILE) as inf:
+        suite = json.load(inf)
+    baseline_file = suite_dir / BASELINE_FILE
+    with open(baseline_file) as inf:
+        baseline = json.load(inf)
+
+    data_structures = {ds: workloads for ds, workloads in suite["dataStructures"].items()
+                       if not args.ds or ds in args.ds}
+    if args.list_binaries:
+        print(" ".join(f"{ds}.{suite['reclaimer']}" for ds in data_structures))
+        return []
+
+    if baseline.get("machine") and baseline["machine"] != machine_info():
+        print(f"WARNING: the baseline was measured on {baseline['machine']}, not on {machine_info()}")
+
+    args.extra_args = " ".join(suite.get("args", []))
+    output_dir = prepare(args)
+    cells = [Cell(ds, suite["reclaimer"], ALLOCATOR, str(suite_dir / f"{workload}.json"), suite["range"])
+             for ds, workloads in data_structures.items()
+             for workload in workloads]
+
+    print("START REGRESSION SUITE")
+    run_cells(cells, args, output_dir)
+    print("END REGRESSION SUITE")
+
+    if args.update_baseline:
+        update_baseline(cells, baseline, baseline_file)
+        return []
+    return check(cells, baseline)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description=f"""
+        Performance regression suite: runs the workloads of {SUITE_FILE} for each of its data structures,
+        with fixed thread counts, until the 95% confidence interval of the total throughput is tight,
+        and compares the means with {BASELINE_FILE}. Exits with status 1 if the confidence interval of
+        a cell is entirely below the tolerance band of its baseline, or if a cell failed.
+    """)
+    parser.add_argument("-s", "--setbench-dir", type=Path, default=Path.cwd().parent, help="Directory where setbench is located")
+    parser.add_argument("--suite-dir", type=Path, default=None, help=f"Directory of {SUITE_FILE}, {BASELINE_FILE} and the workloads (default: microbench/regression)")
+    parser.add_argument("-o", "--output-dir", type=Path, default=Path.cwd() / DEFAULT_OUTPUT_DIR_NAME, help="Directory where results will be stored")
+    parser.add_argument("--ds", nargs="*", default=None, help="Only run these data structures of the suite")
+    parser.add_argument("--cores", type=str, default=None, help="Cores to run the benchmarks on (taskset -c list). Default: the isolated cores")
+    parser.add_argument("--update-baseline", action="store_true", help=f"Store the measured means in {BASELINE_FILE} instead of comparing with it")
+    parser.add_argument("--list-binaries", action="store_true", help="Print the binaries the suite needs and exit")
+    parser.add_argument("--ci-target", type=float, default=0.03, help="Repeat a cell until the 95%% CI half-width is at most this fraction of the mean")
+    parser.add_argument("--min-runs", type=int, default=3, help="Minimum number of runs per cell")
+    parser.add_argument("--max-runs", type=int, default=10, help="Maximum number of runs per cell")
+    parser.add_argument("--max-failures", type=int, default=2, help="Give up on a cell after this many failed runs")
+    parser.add_argument("--timeout", type=int, default=120, help="Timeout in seconds of each run")
+
+    args = parser.parse_args()
+    args.setbench_dir = args.setbench_dir.resolve()
+
+    regressions = start(args)
+    if regressions:
+        sys.exit(1)